@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ThreadPool.hpp"
+#include "simulation/CpuCloth.hpp"
+
+//steps the CPU port of simulateClothKernel over a range of grid sizes, with and without wind and collision, and prints
+//throughput and energy drift as JSON, so a solver change can be compared against the numbers from before it
+//usage: clothbenchmark [frames] [grid sizes...]
+//every run covers the same simulated time, and the substeps the adaptive limit took for it are reported alongside
+
+//the cloth of TestScene
+constexpr float CLOTH_SIZE = 2, UNIT_MASS = 1, SPRING_CONSTANT = 20, DAMPING_CONSTANT = 1;
+constexpr float FRAME_TIME = 1.0f / 60;
+
+//bytes one substep streams through memory per particle, counting every neighbour load as a cache hit: drag reads the
+//positions and velocities of a grid particle's two triangles and writes their forces, force accumulation reads the
+//particle's own state and the forces of the six triangles around it and writes the acceleration, and the motion
+//update reads that and rewrites position and velocity. this is a lower bound on traffic, not a measurement, so the
+//bandwidth derived from it is reported as an estimate
+constexpr double BYTES_PER_PARTICLE_SUBSTEP = 2 * (3 * 24 + 12) + (24 + 6 * 12 + 12) + (12 + 2 * 24);
+
+//sphere in front of the cloth, which the wind blows the cloth onto
+class SphereCollider : public CollisionDelegate {
+    public:
+        SphereCollider(simd::float3 center, float radius) {
+            this->_center = center;
+            this->_radius = radius;
+        }
+
+        bool intersect(simd::float3 origin, simd::float3 direction, float maxDistance, simd::float3, float &distance, simd::float3 &normal) override {
+            simd::float3 offset = origin - this->_center;
+            float b = simd::dot(offset, direction);
+            float c = simd::dot(offset, offset) - this->_radius * this->_radius;
+            float discriminant = b * b - c;
+            if (c < 0 || discriminant < 0) return false;
+            distance = -b - sqrtf(discriminant);
+            if (distance < 0 || distance > maxDistance) return false;
+            normal = simd::normalize(origin + distance * direction - this->_center);
+            return true;
+        }
+    private:
+        simd::float3 _center;
+        float _radius;
+};
+
+struct BenchmarkResult {
+    uint32_t gridSize;
+    bool wind, collision;
+    uint32_t frames;
+    uint64_t substeps, particleSubsteps;
+    double seconds;
+    double initialEnergy, finalEnergy;
+};
+
+//kinetic, gravitational and spring energy; gravity pulls with an acceleration of 1, and each spring pushes both of its
+//particles with half its constant, see applySpring. damping and drag only take energy out, so a windless run that gains
+//energy is integrating unstably; wind does work on the cloth, so its runs drift upward by design
+static double getClothEnergy(CpuCloth &cloth) {
+    const ClothParameters params = cloth.getParameters();
+    const ClothState &state = cloth.getState();
+    const ClothTopology &topology = cloth.getTopology();
+    double energy = 0;
+    for (uint32_t i = 0; i < state.size(); i++) {
+        simd::float3 velocity = state.getVelocity(i);
+        energy += params.particleMass * (0.5 * simd::dot(velocity, velocity) + state.positionY[i]);
+    }
+    for (const DistanceConstraint &spring: topology.springs) {
+        double stretch = simd::length(state.getPosition(spring.particleB) - state.getPosition(spring.particleA)) - spring.restLength;
+        energy += 0.25 * params.springConstant * stretch * stretch;
+    }
+    return energy;
+}
+
+//every block is woken before each frame, so the numbers measure the solver rather than how soon the cloth settles
+static BenchmarkResult runBenchmark(ThreadPool &threadPool, uint32_t gridSize, bool wind, bool collision, uint32_t frames) {
+    CpuCloth cloth(&threadPool, CLOTH_SIZE, gridSize, UNIT_MASS, SPRING_CONSTANT, DAMPING_CONSTANT);
+    SphereCollider sphere(simd::float3{0, 1.25f, -0.45f}, 0.25f);
+    cloth.setSelfCollision(collision);
+    if (collision) cloth.setCollisionDelegate(&sphere);
+
+    BenchmarkResult result = {
+        .gridSize = gridSize, .wind = wind, .collision = collision, .frames = frames, .substeps = 0, .particleSubsteps = 0,
+        .seconds = 0, .initialEnergy = getClothEnergy(cloth), .finalEnergy = 0
+    };
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        cloth.wake();
+        cloth.update(FRAME_TIME, simd::float3{}, wind);
+        result.substeps += cloth.getLastSubsteps();
+    }
+    result.particleSubsteps = cloth.getParticleSubsteps();
+    result.seconds = cloth.getSimulationSeconds();
+    result.finalEnergy = getClothEnergy(cloth);
+    return result;
+}
+
+static void printResult(const BenchmarkResult &result, bool last) {
+    double throughput = result.particleSubsteps / result.seconds;
+    double drift = result.finalEnergy - result.initialEnergy;
+    printf("    {\"gridSize\": %u, \"particles\": %u, \"wind\": %s, \"collision\": %s, ", result.gridSize, result.gridSize * result.gridSize, result.wind ? "true" : "false", result.collision ? "true" : "false");
+    printf("\"frames\": %u, \"substeps\": %llu, \"seconds\": %.6f, ", result.frames, (unsigned long long)result.substeps, result.seconds);
+    printf("\"particleSubstepsPerSecond\": %.6e, \"nsPerParticleSubstep\": %.4f, \"estimatedBandwidthGBs\": %.4f, ", throughput, 1e9 / throughput, throughput * BYTES_PER_PARTICLE_SUBSTEP / 1e9);
+    printf("\"energy\": {\"initial\": %.9g, \"final\": %.9g, \"drift\": %.9g, \"relativeDrift\": %.9g}}%s\n", result.initialEnergy, result.finalEnergy, drift, drift / fabs(result.initialEnergy), last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10;
+    std::vector<uint32_t> gridSizes = {20, 64, 128, 256, 512, 1024};
+    if (argc > 2) {
+        gridSizes.clear();
+        for (int i = 2; i < argc; i++) gridSizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    ThreadPool threadPool;
+
+    printf("{\n  \"threads\": %u, \"frames\": %u, \"estimatedBytesPerParticleSubstep\": %.0f,\n  \"results\": [\n", threadPool.getThreadCount(), frames, BYTES_PER_PARTICLE_SUBSTEP);
+    for (uint32_t size = 0; size < gridSizes.size(); size++) {
+        for (int configuration = 0; configuration < 4; configuration++) {
+            BenchmarkResult result = runBenchmark(threadPool, gridSizes[size], configuration & 1, configuration & 2, frames);
+            printResult(result, size + 1 == gridSizes.size() && configuration == 3);
+            fflush(stdout);
+        }
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
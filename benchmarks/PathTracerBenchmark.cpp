@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "Camera.hpp"
+#include "ThreadPool.hpp"
+#include "pathtracing/Bvh.hpp"
+#include "pathtracing/CpuPathTracer.hpp"
+#include "simulation/CpuCloth.hpp"
+
+//renders TestScene with the CPU port of sampleSceneKernel while the cloth blows in the wind, prints the time of every
+//frame and of the BVH update for it as JSON, and writes the last frame to a PPM image, so frames can be made and timed
+//on hosts without a GPU
+//usage: pathtracerbenchmark [frames] [width] [height] [cloth particles] [image.ppm] [sky.hdr]
+//PATHTRACER_REBUILD=1 rebuilds the BVH every frame instead of refitting it, to compare the two
+
+//TestScene's cloth, wind, floor, materials and camera
+constexpr float CLOTH_SIZE = 2, UNIT_MASS = 1, SPRING_CONSTANT = 20, DAMPING_CONSTANT = 1;
+constexpr float FLOOR_SIZE = 5;
+constexpr float FRAME_TIME = 1.0f / 60;
+//the Renderer's samples and bounces
+constexpr uint32_t SAMPLES = 32, BOUNCES = 8;
+
+const uint32_t floorIndices[6] = {
+    0, 1, 2,
+    2, 1, 3
+};
+
+const Material materials[3] = {
+    Material{.color = {0.5f, 1.0f, 0.5f}, .roughness = .25},
+    Material{.color = {0.5f, 0.5f, 1.0f}, .roughness = 0},
+    Material{.color = {1.0f, 0.5f, 0.5f}, .roughness = 0.05}
+};
+
+struct FrameResult {
+    double simulateSeconds, updateSeconds, renderSeconds;
+    bool rebuilt;
+    uint32_t nodeCount;
+    float sahCost;
+    uint32_t stolenTiles;
+};
+
+static double getSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//8 bits per channel with the sRGB curve the view's BGRA8Unorm_sRGB drawable applies
+static void writeImage(const char *fileName, CpuPathTracer &pathTracer) {
+    FILE *pFile = fopen(fileName, "wb");
+    if (pFile == nullptr) {
+        fprintf(stderr, "could not open %s\n", fileName);
+        return;
+    }
+    fprintf(pFile, "P6\n%u %u\n255\n", pathTracer.getWidth(), pathTracer.getHeight());
+    //the GPU output texture is drawn with y up
+    for (int32_t y = pathTracer.getHeight() - 1; y >= 0; y--) {
+        for (uint32_t x = 0; x < pathTracer.getWidth(); x++) {
+            simd::float4 color = pathTracer.getOutput()[y * pathTracer.getWidth() + x];
+            for (int channel = 0; channel < 3; channel++) {
+                float linear = color[channel];
+                float encoded = linear <= 0.0031308f ? 12.92f * linear : 1.055f * powf(linear, 1 / 2.4f) - 0.055f;
+                fputc((int)(encoded * 255 + 0.5f), pFile);
+            }
+        }
+    }
+    fclose(pFile);
+}
+
+int main(int argc, char **argv) {
+    uint32_t frameCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10;
+    uint32_t width = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 320;
+    uint32_t height = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 180;
+    uint32_t clothParticles = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 20;
+    const char *pImageName = argc > 5 ? argv[5] : "pathtracer.ppm";
+    //a dim night sky when the scene's image is not at hand
+    HdriImage hdri = argc > 6 ? HdriImage(argv[6]) : HdriImage(simd::float3{0.3f, 0.35f, 0.5f});
+    const char *pRebuild = getenv("PATHTRACER_REBUILD");
+    bool rebuild = pRebuild != nullptr && pRebuild[0] != '\0' && pRebuild[0] != '0';
+
+    ThreadPool threadPool;
+    WindField windField(16, 4, simd::float3{0, 0, 2}, 1, 2);
+    CpuCloth cloth(&threadPool, CLOTH_SIZE, clothParticles, UNIT_MASS, SPRING_CONSTANT, DAMPING_CONSTANT);
+    cloth.setWindField(&windField);
+
+    pfloat3 floorVertices[4] = {
+        {-FLOOR_SIZE / 2, 0, -FLOOR_SIZE / 2},
+        {-FLOOR_SIZE / 2, 0,  FLOOR_SIZE / 2},
+        { FLOOR_SIZE / 2, 0, -FLOOR_SIZE / 2},
+        { FLOOR_SIZE / 2, 0,  FLOOR_SIZE / 2}
+    };
+    PrimitiveData floorData[2] = {
+        PrimitiveData{{}, {}, {}, {}, {}, {}, {0, 1, 0}, {0, 1, 0}, {0, 1, 0}},
+        PrimitiveData{{}, {}, {}, {}, {}, {}, {0, 1, 0}, {0, 1, 0}, {0, 1, 0}},
+    };
+
+    TraceScene scene;
+    scene.geometries.push_back(TraceGeometry{cloth.getVertices(), cloth.getIndices(), cloth.getPrimitiveData(), cloth.getTriangleCount()});
+    scene.geometries.push_back(TraceGeometry{floorVertices, floorIndices, floorData, 2});
+    scene.geometryMaterials = {0, 1};
+    scene.materials = std::vector<Material>(std::begin(materials), std::end(materials));
+
+    Camera camera = {0, M_PI / 4, simd::float3{0, 5, -5}};
+    simd::float4x4 pvMat = getProjectionMatrix((float)height / width) * simd_inverse(getCameraMatrix(camera));
+    simd::float4x4 pvMatInv = simd_inverse(pvMat);
+
+    Bvh bvh(&threadPool);
+    CpuPathTracer pathTracer(&threadPool, width, height, SAMPLES, BOUNCES);
+    std::vector<FrameResult> results;
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        FrameResult result;
+        auto start = std::chrono::steady_clock::now();
+        windField.advance(FRAME_TIME);
+        cloth.update(FRAME_TIME, simd::float3{}, true);
+        result.simulateSeconds = getSeconds(start);
+
+        scene.updatePrimitiveMotion(pvMat);
+        if (rebuild) {
+            bvh.build(scene);
+            result.updateSeconds = bvh.getBuildSeconds();
+            result.rebuilt = true;
+        }
+        else {
+            //the first update builds the tree
+            bvh.update(scene);
+            result.updateSeconds = bvh.getUpdateSeconds();
+            result.rebuilt = bvh.getLastUpdateRebuilt();
+        }
+        result.nodeCount = bvh.getNodeCount();
+        result.sahCost = bvh.getSahCost();
+
+        start = std::chrono::steady_clock::now();
+        pathTracer.render(scene, bvh, hdri, camera.position, pvMatInv, pvMat, frame + 1);
+        result.renderSeconds = getSeconds(start);
+        result.stolenTiles = pathTracer.getLastStolenTiles();
+        results.push_back(result);
+    }
+    writeImage(pImageName, pathTracer);
+
+    double renderSeconds = 0, updateSeconds = 0;
+    uint32_t rebuildCount = 0;
+    for (const FrameResult &result: results) {
+        renderSeconds += result.renderSeconds;
+        updateSeconds += result.updateSeconds;
+        rebuildCount += result.rebuilt;
+    }
+    double primarySamples = (double)width * height * SAMPLES * frameCount;
+    printf("{\n  \"threads\": %u, \"width\": %u, \"height\": %u, \"spp\": %u, \"bounces\": %u, \"tiles\": %u, \"triangles\": %u,\n", threadPool.getThreadCount(), width, height, SAMPLES, BOUNCES, pathTracer.getTileCount(), scene.getTriangleCount());
+    printf("  \"msPerFrame\": %.3f, \"primarySamplesPerSecond\": %.6e, \"bvhMsPerFrame\": %.3f, \"bvhRebuilds\": %u,\n  \"frames\": [\n", 1000 * renderSeconds / frameCount, primarySamples / renderSeconds, 1000 * updateSeconds / frameCount, rebuildCount);
+    for (uint32_t i = 0; i < results.size(); i++) {
+        printf("    {\"simulateMs\": %.3f, \"bvhMs\": %.3f, \"bvhRebuilt\": %s, \"bvhNodes\": %u, \"sahCost\": %.4f, \"renderMs\": %.3f, \"stolenTiles\": %u}%s\n", 1000 * results[i].simulateSeconds, 1000 * results[i].updateSeconds, results[i].rebuilt ? "true" : "false", results[i].nodeCount, results[i].sahCost, 1000 * results[i].renderSeconds, results[i].stolenTiles, i + 1 == results.size() ? "" : ",");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
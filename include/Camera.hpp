@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cmath>
+#include "PortableSimd.hpp"
+
+constexpr float FOV = 90.0f * M_PI / 360;
+
+typedef struct Camera {
+    float pitch, yaw;
+    simd::float3 position;
+} Camera;
+
+inline simd::float4x4 getCameraMatrix(const Camera &camera) {
+    float cosPitch = cos(camera.pitch), sinPitch = sin(camera.pitch);
+    float cosYaw = cos(camera.yaw), sinYaw = sin(camera.yaw);
+    return simd::float4x4{
+        simd::float4{cosPitch, 0, -sinPitch, 0},
+        simd::float4{sinPitch * sinYaw, cosYaw, cosPitch * sinYaw, 0},
+        simd::float4{sinPitch * cosYaw, -sinYaw, cosPitch * cosYaw, 0},
+        simd::float4{camera.position[0], camera.position[1], camera.position[2], 1}
+    };
+}
+
+//aspectRatio is height over width
+inline simd::float4x4 getProjectionMatrix(float aspectRatio) {
+    return simd::float4x4{
+        simd::float4{1 / tanf(FOV), 0, 0, 0},
+        simd::float4{0, 1 / (aspectRatio * tanf(FOV)), 0, 0},
+        simd::float4{0, 0, 1, -1},
+        simd::float4{0, 0, -2, 0}
+    };
+}
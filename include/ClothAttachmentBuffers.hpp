@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Metal.hpp"
+#include "Utils.hpp"
+#include "simulation/ClothAttachments.hpp"
+
+//GPU copy of a ClothAttachments for Cloth and ClothBatch: the attachments and the hard particle mask in buffers
+//rewritten only when the attachments change, and the handle transforms in a buffer rewritten every frame, so animating
+//handles never touches the cloth
+class ClothAttachmentBuffers {
+    public:
+        //pFunction is the attachment kernel run after every substep; particleCount covers every particle it can name
+        ClothAttachmentBuffers(MTL::Device *pDevice, MTL::Function *pFunction, uint32_t particleCount);
+        ~ClothAttachmentBuffers();
+
+        void setAttachments(const std::vector<Attachment> &attachments);
+        void setHandleTransform(uint32_t handle, simd::float4x4 transform);
+        const ClothAttachments& getAttachments();
+        //carries handle 0 by moveDirection over the frame, writes the handles, and binds the attachments to buffer 27,
+        //the handles to 29 and the hard particle mask to 30
+        void bind(MTL::ComputeCommandEncoder *pCEnc, float dt, simd::float3 moveDirection);
+        //runs the attachment kernel for the substep that ends fraction of the way through the frame
+        void dispatch(MTL::ComputeCommandEncoder *pCEnc, float fraction);
+        //called once the frame is encoded, so the next one starts from where the handles ended
+        void endFrame();
+    private:
+        MTL::Device *_pDevice;
+        MTL::ComputePipelineState *_pPipelineState;
+        ClothAttachments _attachments;
+        MTL::Buffer *_pAttachmentBuffer = nullptr;
+        MTL::Buffer *_pHardParticleBuffer;
+        MTL::Buffer *_pHandleBuffer = nullptr;
+};
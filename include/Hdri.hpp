@@ -1,20 +1,20 @@
 #pragma once
 
-#include <fstream>
-#include <simd/simd.h>
+#include "HdriImage.hpp"
 #include "Metal.hpp"
 
+//an HdriImage together with a managed buffer of its texels, which the Renderer blits into the hdri texture
 class Hdri {
     public:
         Hdri(MTL::Device *pDevice, const char *fileName);
         ~Hdri();
         MTL::Buffer* getBuffer();
+        const HdriImage& getImage();
         bool getFlipX();
         bool getFlipY();
         uint32_t getSizeX();
         uint32_t getSizeY();
     private:
-        bool _flipX, _flipY;
-        uint32_t _sizeX, _sizeY;
+        HdriImage _image;
         MTL::Buffer *_pDataBuffer;
-};
\ No newline at end of file
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include "PortableSimd.hpp"
+
+//decoded Radiance HDR image in host memory, top row first, which Hdri uploads and the CPU path tracer samples directly
+class HdriImage {
+    public:
+        HdriImage(const char *fileName);
+        //a 1x1 sky of one colour, for hosts that do not have the scene's image
+        HdriImage(simd::float3 color);
+
+        bool getFlipX() const;
+        bool getFlipY() const;
+        uint32_t getSizeX() const;
+        uint32_t getSizeY() const;
+        const simd::float4* getData() const;
+        //the lookup of sampleHdri: equirectangular around Y, read through a linear clamp-to-edge sampler
+        simd::float3 sample(simd::float3 direction) const;
+    private:
+        bool _flipX = false, _flipY = false;
+        uint32_t _sizeX, _sizeY;
+        std::vector<simd::float4> _data;
+
+        simd::float4 getTexel(int32_t x, int32_t y) const;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdio>
+#include "SharedTypes.h"
+
+//input recordings hold everything Renderer::draw takes from the clock and the user for each frame, so replaying one
+//steps the simulation and renders the same frames every run, whatever the machine's frame rate
+//a frame is packed into 32 bytes: the wall-clock frame time it was recorded at, which replays replace with
+//REPLAY_FRAME_TIME, the camera the frame is rendered from, the cloth move direction as
+//one signed byte per axis, the wind toggle and the path tracer's random seed
+
+typedef struct InputHeader {
+    char magic[4];
+    uint32_t version;
+} InputHeader;
+
+typedef struct InputFrame {
+    float dt;
+    float pitch, yaw;
+    simd::float3 position;
+    simd::float3 clothDirection;
+    bool wind;
+    uint32_t seed;
+} InputFrame;
+
+constexpr uint32_t INPUT_VERSION = 1;
+
+class InputWriter {
+    public:
+        InputWriter(const char *fileName);
+        ~InputWriter();
+
+        void addFrame(const InputFrame &frame);
+        uint32_t getFrameCount();
+    private:
+        FILE *_pFile;
+        uint32_t _frameCount = 0;
+};
+
+//reads the frames of a recording in order
+class InputReader {
+    public:
+        InputReader(const char *fileName);
+        ~InputReader();
+
+        uint32_t getFrameCount();
+        //false once every frame has been read
+        bool readFrame(InputFrame &frame);
+    private:
+        FILE *_pFile;
+        uint32_t _frameCount = 0;
+        uint32_t _readFrames = 0;
+};
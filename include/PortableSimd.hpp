@@ -0,0 +1,335 @@
+#pragma once
+
+//the subset of Apple's <simd/simd.h> the host code uses, for compilers without it; Apple builds keep the real header
+//unless PORTABLE_SIMD is defined, so both can be checked against each other on a Mac
+//float3 and float4 are four float lanes in an SSE or NEON register, or a plain array elsewhere, 16 bytes long and
+//16-byte aligned like Metal's, so the structs of SharedTypes.h keep the layout the shaders read; the fourth lane of a
+//float3 is padding that no reduction or comparison looks at
+#if defined(__APPLE__) && !defined(PORTABLE_SIMD)
+#include <simd/simd.h>
+#else
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define PORTABLE_SIMD_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PORTABLE_SIMD_NEON 1
+#endif
+
+namespace simd {
+    namespace detail {
+        //one 4-lane register and the handful of operations every vector type is built from
+#if defined(PORTABLE_SIMD_SSE)
+        typedef __m128 Lanes;
+        inline Lanes splat(float s) {return _mm_set1_ps(s);}
+        inline Lanes make(float x, float y, float z, float w) {return _mm_setr_ps(x, y, z, w);}
+        inline Lanes add(Lanes a, Lanes b) {return _mm_add_ps(a, b);}
+        inline Lanes sub(Lanes a, Lanes b) {return _mm_sub_ps(a, b);}
+        inline Lanes mul(Lanes a, Lanes b) {return _mm_mul_ps(a, b);}
+        inline Lanes div(Lanes a, Lanes b) {return _mm_div_ps(a, b);}
+        inline Lanes min(Lanes a, Lanes b) {return _mm_min_ps(a, b);}
+        inline Lanes max(Lanes a, Lanes b) {return _mm_max_ps(a, b);}
+        inline Lanes sqrt(Lanes a) {return _mm_sqrt_ps(a);}
+        inline Lanes abs(Lanes a) {return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);}
+        //bit i set where lane i of a == b or a < b
+        inline int equal(Lanes a, Lanes b) {return _mm_movemask_ps(_mm_cmpeq_ps(a, b));}
+        inline int less(Lanes a, Lanes b) {return _mm_movemask_ps(_mm_cmplt_ps(a, b));}
+        template <int X, int Y, int Z, int W>
+        inline Lanes shuffle(Lanes a) {return _mm_shuffle_ps(a, a, _MM_SHUFFLE(W, Z, Y, X));}
+        inline Lanes floor(Lanes a) {
+#if defined(__SSE4_1__)
+            return _mm_floor_ps(a);
+#else
+            //truncation rounds negative fractions up, so step those back by one
+            Lanes truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1)));
+#endif
+        }
+        inline float sum3(Lanes a) {
+            Lanes sum = _mm_add_ss(_mm_add_ss(a, shuffle<1, 1, 1, 1>(a)), shuffle<2, 2, 2, 2>(a));
+            return _mm_cvtss_f32(sum);
+        }
+        inline float sum4(Lanes a) {
+            Lanes pairs = _mm_add_ps(a, shuffle<2, 3, 0, 1>(a));
+            return _mm_cvtss_f32(_mm_add_ss(pairs, shuffle<1, 0, 3, 2>(pairs)));
+        }
+#elif defined(PORTABLE_SIMD_NEON)
+        typedef float32x4_t Lanes;
+        inline Lanes splat(float s) {return vdupq_n_f32(s);}
+        inline Lanes make(float x, float y, float z, float w) {return float32x4_t{x, y, z, w};}
+        inline Lanes add(Lanes a, Lanes b) {return vaddq_f32(a, b);}
+        inline Lanes sub(Lanes a, Lanes b) {return vsubq_f32(a, b);}
+        inline Lanes mul(Lanes a, Lanes b) {return vmulq_f32(a, b);}
+        inline Lanes div(Lanes a, Lanes b) {return vdivq_f32(a, b);}
+        inline Lanes min(Lanes a, Lanes b) {return vminnmq_f32(a, b);}
+        inline Lanes max(Lanes a, Lanes b) {return vmaxnmq_f32(a, b);}
+        inline Lanes sqrt(Lanes a) {return vsqrtq_f32(a);}
+        inline Lanes abs(Lanes a) {return vabsq_f32(a);}
+        inline Lanes floor(Lanes a) {return vrndmq_f32(a);}
+        inline int toBits(uint32x4_t mask) {
+            const uint32x4_t bits = {1, 2, 4, 8};
+            return vaddvq_u32(vandq_u32(mask, bits));
+        }
+        inline int equal(Lanes a, Lanes b) {return toBits(vceqq_f32(a, b));}
+        inline int less(Lanes a, Lanes b) {return toBits(vcltq_f32(a, b));}
+        template <int X, int Y, int Z, int W>
+        inline Lanes shuffle(Lanes a) {return __builtin_shufflevector(a, a, X, Y, Z, W);}
+        inline float sum3(Lanes a) {return vgetq_lane_f32(a, 0) + vgetq_lane_f32(a, 1) + vgetq_lane_f32(a, 2);}
+        inline float sum4(Lanes a) {return vaddvq_f32(a);}
+#else
+        struct alignas(16) Lanes {float f[4];};
+        inline Lanes splat(float s) {return Lanes{{s, s, s, s}};}
+        inline Lanes make(float x, float y, float z, float w) {return Lanes{{x, y, z, w}};}
+        template <typename Operation>
+        inline Lanes map(Lanes a, Lanes b, Operation operation) {
+            return Lanes{{operation(a.f[0], b.f[0]), operation(a.f[1], b.f[1]), operation(a.f[2], b.f[2]), operation(a.f[3], b.f[3])}};
+        }
+        inline Lanes add(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return x + y;});}
+        inline Lanes sub(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return x - y;});}
+        inline Lanes mul(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return x * y;});}
+        inline Lanes div(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return x / y;});}
+        inline Lanes min(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return std::fmin(x, y);});}
+        inline Lanes max(Lanes a, Lanes b) {return map(a, b, [](float x, float y) {return std::fmax(x, y);});}
+        inline Lanes sqrt(Lanes a) {return map(a, a, [](float x, float) {return std::sqrt(x);});}
+        inline Lanes abs(Lanes a) {return map(a, a, [](float x, float) {return std::fabs(x);});}
+        inline Lanes floor(Lanes a) {return map(a, a, [](float x, float) {return std::floor(x);});}
+        inline int equal(Lanes a, Lanes b) {
+            return (a.f[0] == b.f[0]) | (a.f[1] == b.f[1]) << 1 | (a.f[2] == b.f[2]) << 2 | (a.f[3] == b.f[3]) << 3;
+        }
+        inline int less(Lanes a, Lanes b) {
+            return (a.f[0] < b.f[0]) | (a.f[1] < b.f[1]) << 1 | (a.f[2] < b.f[2]) << 2 | (a.f[3] < b.f[3]) << 3;
+        }
+        template <int X, int Y, int Z, int W>
+        inline Lanes shuffle(Lanes a) {return Lanes{{a.f[X], a.f[Y], a.f[Z], a.f[W]}};}
+        inline float sum3(Lanes a) {return a.f[0] + a.f[1] + a.f[2];}
+        inline float sum4(Lanes a) {return a.f[0] + a.f[1] + a.f[2] + a.f[3];}
+#endif
+    }
+
+    struct float2 {
+        float x, y;
+
+        inline float& operator[](int i) {return (&this->x)[i];}
+        inline float operator[](int i) const {return (&this->x)[i];}
+    };
+
+    struct uint2 {
+        uint32_t x, y;
+
+        inline uint32_t& operator[](int i) {return (&this->x)[i];}
+        inline uint32_t operator[](int i) const {return (&this->x)[i];}
+    };
+
+    //lane masks of a comparison, -1 where it holds, which simd::all and simd::any reduce
+    struct int3 {
+        int32_t x, y, z;
+    };
+
+    struct int4 {
+        int32_t x, y, z, w;
+    };
+
+    struct float3 {
+        union {
+            detail::Lanes lanes;
+            struct {float x, y, z;};
+            float elements[4];
+        };
+
+        inline float3() : lanes(detail::splat(0)) {}
+        inline float3(float x, float y, float z) : lanes(detail::make(x, y, z, 0)) {}
+        inline explicit float3(detail::Lanes lanes) : lanes(lanes) {}
+
+        inline float& operator[](int i) {return this->elements[i];}
+        inline float operator[](int i) const {return this->elements[i];}
+        inline float3 operator-() const {return float3(detail::sub(detail::splat(0), this->lanes));}
+        inline float3& operator+=(float3 o) {this->lanes = detail::add(this->lanes, o.lanes); return *this;}
+        inline float3& operator-=(float3 o) {this->lanes = detail::sub(this->lanes, o.lanes); return *this;}
+        inline float3& operator*=(float3 o) {this->lanes = detail::mul(this->lanes, o.lanes); return *this;}
+        inline float3& operator/=(float3 o) {this->lanes = detail::div(this->lanes, o.lanes); return *this;}
+        inline float3& operator*=(float s) {this->lanes = detail::mul(this->lanes, detail::splat(s)); return *this;}
+        inline float3& operator/=(float s) {this->lanes = detail::div(this->lanes, detail::splat(s)); return *this;}
+    };
+
+    struct float4 {
+        union {
+            detail::Lanes lanes;
+            struct {float x, y, z, w;};
+            float elements[4];
+        };
+
+        inline float4() : lanes(detail::splat(0)) {}
+        inline float4(float x, float y, float z, float w) : lanes(detail::make(x, y, z, w)) {}
+        inline explicit float4(detail::Lanes lanes) : lanes(lanes) {}
+
+        inline float& operator[](int i) {return this->elements[i];}
+        inline float operator[](int i) const {return this->elements[i];}
+        inline float4 operator-() const {return float4(detail::sub(detail::splat(0), this->lanes));}
+        inline float4& operator+=(float4 o) {this->lanes = detail::add(this->lanes, o.lanes); return *this;}
+        inline float4& operator-=(float4 o) {this->lanes = detail::sub(this->lanes, o.lanes); return *this;}
+        inline float4& operator*=(float4 o) {this->lanes = detail::mul(this->lanes, o.lanes); return *this;}
+        inline float4& operator/=(float4 o) {this->lanes = detail::div(this->lanes, o.lanes); return *this;}
+        inline float4& operator*=(float s) {this->lanes = detail::mul(this->lanes, detail::splat(s)); return *this;}
+        inline float4& operator/=(float s) {this->lanes = detail::div(this->lanes, detail::splat(s)); return *this;}
+    };
+
+    //column major, like Metal's
+    struct float4x4 {
+        float4 columns[4];
+    };
+
+    static_assert(sizeof(float2) == 8 && sizeof(uint2) == 8, "simd::float2 and simd::uint2 must match Metal's 8 bytes");
+    static_assert(sizeof(float3) == 16 && alignof(float3) == 16, "simd::float3 must match Metal's 16-byte float3");
+    static_assert(sizeof(float4) == 16 && alignof(float4) == 16, "simd::float4 must match Metal's 16-byte float4");
+    static_assert(sizeof(float4x4) == 64, "simd::float4x4 must match Metal's float4x4");
+
+    namespace detail {
+        template <typename V>
+        constexpr bool isVector = std::is_same_v<V, float3> || std::is_same_v<V, float4>;
+
+        inline int3 toMask(int bits, float3) {return int3{-(bits & 1), -(bits >> 1 & 1), -(bits >> 2 & 1)};}
+        inline int4 toMask(int bits, float4) {return int4{-(bits & 1), -(bits >> 1 & 1), -(bits >> 2 & 1), -(bits >> 3 & 1)};}
+    }
+
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator+(V a, V b) {return V(detail::add(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator-(V a, V b) {return V(detail::sub(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator*(V a, V b) {return V(detail::mul(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator/(V a, V b) {return V(detail::div(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator+(V a, float s) {return V(detail::add(a.lanes, detail::splat(s)));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator-(V a, float s) {return V(detail::sub(a.lanes, detail::splat(s)));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator*(V a, float s) {return V(detail::mul(a.lanes, detail::splat(s)));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator/(V a, float s) {return V(detail::div(a.lanes, detail::splat(s)));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator+(float s, V a) {return V(detail::add(detail::splat(s), a.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator-(float s, V a) {return V(detail::sub(detail::splat(s), a.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator*(float s, V a) {return V(detail::mul(detail::splat(s), a.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V operator/(float s, V a) {return V(detail::div(detail::splat(s), a.lanes));}
+
+    inline int3 operator==(float3 a, float3 b) {return detail::toMask(detail::equal(a.lanes, b.lanes), a);}
+    inline int3 operator!=(float3 a, float3 b) {return detail::toMask(~detail::equal(a.lanes, b.lanes), a);}
+    inline int3 operator<(float3 a, float3 b) {return detail::toMask(detail::less(a.lanes, b.lanes), a);}
+    inline int3 operator>(float3 a, float3 b) {return detail::toMask(detail::less(b.lanes, a.lanes), a);}
+    inline int4 operator==(float4 a, float4 b) {return detail::toMask(detail::equal(a.lanes, b.lanes), a);}
+    inline int4 operator!=(float4 a, float4 b) {return detail::toMask(~detail::equal(a.lanes, b.lanes), a);}
+    inline int4 operator<(float4 a, float4 b) {return detail::toMask(detail::less(a.lanes, b.lanes), a);}
+    inline int4 operator>(float4 a, float4 b) {return detail::toMask(detail::less(b.lanes, a.lanes), a);}
+    inline bool all(int3 m) {return m.x && m.y && m.z;}
+    inline bool all(int4 m) {return m.x && m.y && m.z && m.w;}
+    inline bool any(int3 m) {return m.x || m.y || m.z;}
+    inline bool any(int4 m) {return m.x || m.y || m.z || m.w;}
+
+    inline float dot(float3 a, float3 b) {return detail::sum3(detail::mul(a.lanes, b.lanes));}
+    inline float dot(float4 a, float4 b) {return detail::sum4(detail::mul(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline float length_squared(V a) {return dot(a, a);}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline float length(V a) {return std::sqrt(dot(a, a));}
+    //a zero vector comes out as NaNs, as it does from Apple's
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V normalize(V a) {return V(detail::div(a.lanes, detail::sqrt(detail::splat(dot(a, a)))));}
+    inline float3 cross(float3 a, float3 b) {
+        detail::Lanes product = detail::sub(
+            detail::mul(a.lanes, detail::shuffle<1, 2, 0, 3>(b.lanes)),
+            detail::mul(detail::shuffle<1, 2, 0, 3>(a.lanes), b.lanes)
+        );
+        return float3(detail::shuffle<1, 2, 0, 3>(product));
+    }
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V min(V a, V b) {return V(detail::min(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V max(V a, V b) {return V(detail::max(a.lanes, b.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V clamp(V a, V lower, V upper) {return min(max(a, lower), upper);}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V abs(V a) {return V(detail::abs(a.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V floor(V a) {return V(detail::floor(a.lanes));}
+    template <typename V, typename = std::enable_if_t<detail::isVector<V>>>
+    inline V mix(V a, V b, float t) {return a + (b - a) * t;}
+    inline float reduce_add(float3 a) {return detail::sum3(a.lanes);}
+    inline float reduce_add(float4 a) {return detail::sum4(a.lanes);}
+    inline float reduce_min(float3 a) {return std::fmin(a.x, std::fmin(a.y, a.z));}
+    inline float reduce_max(float3 a) {return std::fmax(a.x, std::fmax(a.y, a.z));}
+
+    inline float4 operator*(const float4x4 &m, float4 v) {
+        float4 result = m.columns[0] * v.x;
+        result += m.columns[1] * v.y;
+        result += m.columns[2] * v.z;
+        result += m.columns[3] * v.w;
+        return result;
+    }
+
+    inline float4x4 operator*(const float4x4 &a, const float4x4 &b) {
+        return float4x4{{a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3]}};
+    }
+
+    inline float4x4 transpose(const float4x4 &m) {
+        float4x4 result;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) result.columns[row][column] = m.columns[column][row];
+        }
+        return result;
+    }
+
+    //Lengyel's inverse from cross products of the columns' xyz, which keeps the whole computation in float3 lanes; the
+    //w row of the columns is x, y, z, w below. a singular matrix comes out as infinities and NaNs, as it does from Apple's
+    inline float4x4 inverse(const float4x4 &m) {
+        const float3 a(m.columns[0].lanes), b(m.columns[1].lanes), c(m.columns[2].lanes), d(m.columns[3].lanes);
+        const float x = m.columns[0].w, y = m.columns[1].w, z = m.columns[2].w, w = m.columns[3].w;
+        float3 s = cross(a, b), t = cross(c, d);
+        float3 u = a * y - b * x, v = c * w - d * z;
+        float inverseDeterminant = 1 / (dot(s, v) + dot(t, u));
+        s *= inverseDeterminant;
+        t *= inverseDeterminant;
+        u *= inverseDeterminant;
+        v *= inverseDeterminant;
+
+        //rows of the inverse
+        float3 r0 = cross(b, v) + t * y, r1 = cross(v, a) - t * x, r2 = cross(d, u) + s * w, r3 = cross(u, c) - s * z;
+        float4x4 rows = {{
+            float4(r0.x, r0.y, r0.z, -dot(b, t)),
+            float4(r1.x, r1.y, r1.z, dot(a, t)),
+            float4(r2.x, r2.y, r2.z, -dot(d, s)),
+            float4(r3.x, r3.y, r3.z, dot(c, s))
+        }};
+        return transpose(rows);
+    }
+}
+
+typedef simd::float2 simd_float2;
+typedef simd::float3 simd_float3;
+typedef simd::float4 simd_float4;
+typedef simd::float4x4 simd_float4x4;
+typedef simd::uint2 simd_uint2;
+
+inline simd::float3 simd_make_float3(float x, float y, float z) {return simd::float3(x, y, z);}
+inline simd::float3 simd_make_float3(simd::float4 v) {return simd::float3(v.lanes);}
+inline simd::float4 simd_make_float4(float x, float y, float z, float w) {return simd::float4(x, y, z, w);}
+inline simd::float4 simd_make_float4(simd::float3 v, float w) {return simd::float4(v.x, v.y, v.z, w);}
+inline simd::float4 simd_make_float4(simd::float3 v) {return simd::float4(v.x, v.y, v.z, 0);}
+inline simd::float4 simd_mul(const simd::float4x4 &m, simd::float4 v) {return m * v;}
+inline simd::float4x4 simd_mul(const simd::float4x4 &a, const simd::float4x4 &b) {return a * b;}
+inline simd::float4x4 simd_inverse(const simd::float4x4 &m) {return simd::inverse(m);}
+inline simd::float4x4 simd_transpose(const simd::float4x4 &m) {return simd::transpose(m);}
+
+const simd::float4x4 matrix_identity_float4x4 = {{
+    simd::float4(1, 0, 0, 0), simd::float4(0, 1, 0, 0), simd::float4(0, 0, 1, 0), simd::float4(0, 0, 0, 1)
+}};
+
+#endif
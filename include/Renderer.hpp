@@ -2,13 +2,24 @@
 
 #include "EventDelegate.h"
 #include "EventView.h"
+#include "InputRecording.hpp"
 #include "Metal.hpp"
 #include "SVGFDenoiser.h"
 #include "scenes/TestScene.hpp"
 
 constexpr uint32_t BOUNCES = 8;
 constexpr uint32_t SPP = 32;
-constexpr float FOV = 90.0f * M_PI / 360;
+//the dynamic objects' acceleration structures are refit to their moved geometry every frame, and rebuilt when their
+//bounds have grown past REBUILD_AREA_RATIO or after MAX_REFITS refits, as a tree can also degrade inside its bounds;
+//both only depend on the frames' input, so a replay rebuilds on the same frames
+constexpr uint32_t MAX_REFITS = 600;
+
+//METALCLOTH_RECORD=file records the input of every frame to file, and METALCLOTH_REPLAY=file draws the frames of a
+//recording instead of following the clock and the keys, then quits and prints how long they took. a replay steps
+//every frame by REPLAY_FRAME_TIME rather than the recorded wall-clock dt, so the simulation work and the result are
+//the same whatever frame rate the recording was made at; the camera, cloth direction, wind and seed still come from
+//the recording
+constexpr float REPLAY_FRAME_TIME = 1.0f / 60;
 
 class Renderer: public EventDelegate {
     public:
@@ -32,16 +43,23 @@ class Renderer: public EventDelegate {
         MTL::Texture *_pDepthNormalTextures[2];
         MTL::Texture *_pMotionTexture;
         MTL::Texture *_pOutputTexture;
-        MTL::Buffer *_pGeometryMaterialBuffer;
+        MTL::Buffer *_pInstanceDataBuffer;
         MTL::Buffer *_pMaterialBuffer;
-        MTL::Buffer *_pScratchBuffer;
-        MTL::AccelerationStructure *_pAccelerationStructure;
+        SceneAccelerationStructure *_pAccelerationStructure;
+        uint32_t _refitCount = 0;
         simd::float4x4 _projectionMatrix;
+        //the last frame's, which static instances are reprojected with for their motion vectors
+        simd::float4x4 _prevPvMat;
         bool _wind = false;
         simd::float3 _clothDirection = {0, 0, 0};
         simd::float3 _moveDirection = {0, 0, 0};
         Camera _camera;
         Scene *_pScene = nullptr;
+        InputWriter *_pInputWriter = nullptr;
+        InputReader *_pInputReader = nullptr;
         
         std::chrono::system_clock::time_point _lastFrame = std::chrono::system_clock::now();
+        std::chrono::steady_clock::time_point _replayStart;
+
+        bool getFrameInput(InputFrame &input);
 };
\ No newline at end of file
@@ -1,33 +1,47 @@
 #pragma once
 
+#include "Camera.hpp"
 #include "Hdri.hpp"
 #include "Metal.hpp"
+#include "SceneAccelerationStructure.hpp"
 #include "SceneObject.hpp"
 #include "SharedTypes.h"
-
-typedef struct Camera {
-    float pitch, yaw;
-    simd::float3 position;
-} Camera;
+#include "pathtracing/TraceScene.hpp"
+#include "simulation/WindField.hpp"
 
 class Scene {
     public:
         virtual ~Scene();
 
-        inline MTL::AccelerationStructureDescriptor* getDescriptor() {return this->_pDescriptor;};
+        inline const std::vector<SceneObject*>& getSceneObjects() {return this->_sceneObjects;};
+        //in the order they were placed, which is their instance id
+        inline const std::vector<SceneInstance>& getInstances() {return this->_instances;};
+        std::vector<InstanceData> getInstanceData();
         virtual Camera getInitialCamera() = 0;
-        virtual std::vector<uint16_t> getGeometryMaterials() = 0;
         virtual std::vector<Material> getMaterials() = 0;
         Hdri* getHdri();
-        void update(MTL::CommandBuffer *pCmd, MTL::AccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable);
+        //every instance's triangles for the CPU tracer as a geometry of their own, pointing into the contents of their
+        //object's descriptor's buffers in instance id order and placed by the instance's transform; an instance whose
+        //buffers live in private storage keeps its id with no triangles
+        TraceScene getTraceScene();
+        //encodes the blits that make the GPU's writes to the objects' managed vertex and PrimitiveData buffers visible
+        //to getTraceScene once pCmd completes
+        void synchronizeGeometry(MTL::CommandBuffer *pCmd);
+        void update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable);
         void updateGeometry();
         void updatePrimitiveMotion(MTL::ComputePipelineState *pComputeMotionPipelineState, MTL::CommandBuffer *pCmd, simd::float4x4 vpMat);
     protected:
-        MTL::PrimitiveAccelerationStructureDescriptor *_pDescriptor;
-
-        void addObject(SceneObject *pSceneObject);
+        //adds an object without placing it, and returns its index for addInstance
+        uint32_t addObject(SceneObject *pSceneObject);
+        //places the object's triangles, moved by transform from where its vertices put them; a dynamic object's motion
+        //data is for its vertices where they are, so its instances should keep the identity
+        void addInstance(uint32_t object, uint16_t material, simd::float4x4 transform = matrix_identity_float4x4);
         void loadHdri(MTL::Device *pDevice, const char *fileName);
+        //the scene owns the field and advances it before every update; cloths that should feel it are given it too
+        void setWindField(WindField *pWindField);
     private:
         Hdri *_pHdri;
-        std::vector<SceneObject*> _sceneObjects; 
+        WindField *_pWindField = nullptr;
+        std::vector<SceneObject*> _sceneObjects;
+        std::vector<SceneInstance> _instances;
 };
\ No newline at end of file
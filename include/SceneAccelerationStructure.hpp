@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "Metal.hpp"
+#include "SceneObject.hpp"
+
+//a dynamic object's structure is rebuilt instead of refit once its vertices' bounds have REBUILD_AREA_RATIO times the
+//surface area they had when it was last built; triangles that were close when built drift apart as a cloth spreads
+//out, like Bvh::update's cost, and the bounds are reduced on the GPU so the choice is the same on every run
+constexpr float REBUILD_AREA_RATIO = 1.25f;
+
+//two levels of acceleration structure over a scene's objects: each object's triangles get a primitive structure of
+//their own, and an instance structure places those in the scene once per SceneInstance, so every placement of an
+//object shares its structure and buffers and only costs an instance descriptor
+//static objects' structures are built once, when the scene is loaded. each frame only the dynamic objects' structures
+//are refit, or rebuilt when asked to, when their triangle count changed or when their bounds grew past
+//REBUILD_AREA_RATIO, and the instance structure over them, with one leaf per instance, is rebuilt; a scene with
+//nothing dynamic is left as it is
+class SceneAccelerationStructure {
+    public:
+        //encodes the builds of the static objects' structures into pCmd
+        SceneAccelerationStructure(MTL::Device *pDevice, MTL::CommandBuffer *pCmd, const std::vector<SceneObject*> &sceneObjects, const std::vector<SceneInstance> &instances);
+        ~SceneAccelerationStructure();
+
+        //encodes the reduction of the dynamic objects' vertex bounds into pCmd after the simulation that moves them,
+        //for the next encodeUpdate to read once pCmd completes; a baked cloth's vertices are swapped in after it, so its
+        //bounds lag a frame
+        void encodeBounds(MTL::CommandBuffer *pCmd);
+        //encodes the frame's builds and refits into pCmd once the objects' geometry is updated; true if a dynamic
+        //object's structure was rebuilt rather than refit, as always happens the first time
+        bool encodeUpdate(MTL::CommandBuffer *pCmd, bool rebuild);
+        //binds the instance structure and makes the primitive structures it instances resident, which every encoder
+        //that intersects it has to do
+        void bind(MTL::ComputeCommandEncoder *pCEnc, NS::UInteger index);
+        //the id of the first instance placing pSceneObject, which a cloth's collision rays ignore their own hits on;
+        //UINT32_MAX for an object the scene does not place
+        uint32_t getInstanceId(SceneObject *pSceneObject);
+    private:
+        MTL::Device *_pDevice;
+        std::vector<SceneObject*> _sceneObjects;
+        std::vector<MTL::PrimitiveAccelerationStructureDescriptor*> _pPrimitiveDescriptors;
+        std::vector<MTL::AccelerationStructure*> _pPrimitiveAccelerationStructures;
+        //the dynamic objects' scratch space, kept for their refits and rebuilds
+        std::vector<MTL::Buffer*> _pScratchBuffers;
+        //the triangle count each object's structure was sized for
+        std::vector<NS::UInteger> _triangleCounts;
+        //each object's first instance, see getInstanceId
+        std::vector<uint32_t> _instanceIds;
+        MTL::ComputePipelineState *_pBoundsPipelineState;
+        //six words per object, see reduceVertexBoundsKernel
+        MTL::Buffer *_pBoundsBuffer;
+        //the surface area of each object's bounds when its structure was last built
+        std::vector<float> _builtAreas;
+        MTL::InstanceAccelerationStructureDescriptor *_pInstanceDescriptor;
+        MTL::Buffer *_pInstanceBuffer;
+        MTL::AccelerationStructure *_pInstanceAccelerationStructure;
+        MTL::Buffer *_pInstanceScratchBuffer;
+        bool _built = false;
+
+        void allocatePrimitiveAccelerationStructure(uint32_t object);
+        void setInstancedAccelerationStructures();
+        float getBoundsArea(uint32_t object);
+};
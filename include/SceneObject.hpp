@@ -3,14 +3,26 @@
 #include "Metal.hpp"
 #include "SharedTypes.h"
 
+class SceneAccelerationStructure;
+
+//one placement of a scene object, which shares the object's vertex, index and PrimitiveData buffers with every other
+//placement of it
+typedef struct SceneInstance {
+    uint32_t object;
+    uint16_t material;
+    simd::float4x4 transform;
+} SceneInstance;
+
 class SceneObject {
     public:
         SceneObject();
         virtual ~SceneObject();
 
         inline MTL::AccelerationStructureTriangleGeometryDescriptor* getDescriptor() {return this->_pDescriptor;};
-        virtual void update(MTL::CommandBuffer *pCmd, MTL::AccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {};
+        virtual void update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {};
         virtual void updateGeometry() {};
+        //true for objects whose vertices move from frame to frame, whose acceleration structures are refit every frame
+        virtual bool isDynamic() {return false;};
     private:
         MTL::AccelerationStructureTriangleGeometryDescriptor *_pDescriptor;
 };
\ No newline at end of file
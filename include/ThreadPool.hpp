@@ -0,0 +1,30 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//fixed set of worker threads that split index ranges into one contiguous chunk per thread
+//chunk boundaries only depend on the range size and thread count, so work assignment is reproducible
+class ThreadPool {
+    public:
+        ThreadPool(unsigned int threadCount = 0);
+        ~ThreadPool();
+
+        unsigned int getThreadCount();
+        void parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)> &task);
+    private:
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _startCondition, _doneCondition;
+        const std::function<void(uint32_t, uint32_t)> *_pTask = nullptr;
+        uint32_t _count = 0;
+        uint64_t _generation = 0;
+        unsigned int _pending = 0;
+        bool _stopping = false;
+
+        void runChunk(unsigned int chunk);
+        void work(unsigned int chunk);
+};
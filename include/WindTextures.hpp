@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Metal.hpp"
+#include "simulation/WindField.hpp"
+
+//GPU copy of a WindField: its two keyframes as 3D textures and the WindParameters the drag kernels blend them with
+//without a field it holds 1^3 textures of the constant breeze, so the kernels never branch on whether one is set
+class WindTextures {
+    public:
+        WindTextures(MTL::Device *pDevice);
+        ~WindTextures();
+
+        //nullptr goes back to the breeze; the field must outlive its use here
+        void setWindField(const WindField *pWindField);
+        //uploads the keyframes if the field rotated them since the last bind, then binds textures 0 and 1 and buffer 26
+        void bind(MTL::ComputeCommandEncoder *pCEnc);
+    private:
+        MTL::Device *_pDevice;
+        const WindField *_pWindField = nullptr;
+        uint64_t _generation = 0;
+        MTL::Texture *_pTextures[2] = {};
+
+        void createTextures(uint32_t resolution);
+        void upload(uint32_t keyframe);
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "ThreadPool.hpp"
+
+//runs a task for every index below a count on all threads of a ThreadPool, for items whose cost varies too much for
+//parallelFor's fixed chunks, such as path tracing tiles
+//each thread starts on its own contiguous share and takes from its front; a thread that runs dry steals the back half
+//of another thread's share. a share is one atomic begin/end pair, so the owner and thieves only ever race on a CAS
+class WorkStealingScheduler {
+    public:
+        WorkStealingScheduler(ThreadPool *pThreadPool);
+
+        unsigned int getThreadCount();
+        //thread is below getThreadCount, so tasks can keep per-thread scratch
+        void run(uint32_t count, const std::function<void(uint32_t index, unsigned int thread)> &task);
+        //indices the last run moved between threads
+        uint32_t getLastStolen();
+    private:
+        //begin in the low and end in the high 32 bits, on its own cache line
+        struct alignas(64) WorkRange {
+            std::atomic<uint64_t> range;
+        };
+
+        ThreadPool *_pThreadPool;
+        std::vector<WorkRange> _ranges;
+        std::atomic<uint32_t> _stolen;
+
+        bool pop(unsigned int thread, uint32_t &index);
+        bool steal(unsigned int thread);
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include "WorkStealingScheduler.hpp"
+#include "pathtracing/Intersector.hpp"
+
+//split planes tried per axis when splitting a node
+constexpr uint32_t BVH_BINS = 16;
+//an update rebuilds the tree once refitting has raised its surface area heuristic cost this far above the last build's
+constexpr float BVH_REBUILD_COST_RATIO = 1.25f;
+
+//32 bytes, two to a cache line: an interior node's children are the pair of nodes from offset, and a leaf holds the
+//count triangles from offset in leaf order
+typedef struct BvhNode {
+    pfloat3 lower;
+    uint32_t offset;
+    pfloat3 upper;
+    uint32_t count;
+} BvhNode;
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+//triangle the builder sorts: its bounds, the centroid it is binned by, and where it came from in the scene
+typedef struct BvhPrimitive {
+    simd::float3 lower, upper, centroid;
+    uint32_t geometryId, primitiveId;
+} BvhPrimitive;
+
+typedef struct BvhTriangle {
+    simd::float3 v0, v1, v2;
+} BvhTriangle;
+
+//bounding volume hierarchy over every triangle of a TraceScene, the CPU tracer's stand-in for MTL::AccelerationStructure
+//nodes split at the cheapest of BVH_BINS planes per axis under the surface area heuristic. the top levels are split
+//one node at a time, binning each across the ThreadPool, until the ranges left are small enough to be tasks; those
+//subtrees are then built whole by a WorkStealingScheduler into their own arrays and appended after the top nodes
+//triangles are copied into leaf order, so a leaf's tests walk memory forwards
+//update refits the tree to moved vertices instead, gathering the triangles again and growing every node's bounds from
+//its children's, the subtrees in parallel and then the top nodes; nodes that were close when built drift apart as the
+//cloth moves, so it rebuilds once the cost has grown past BVH_REBUILD_COST_RATIO
+class Bvh : public Intersector {
+    public:
+        Bvh(ThreadPool *pThreadPool);
+
+        virtual void build(const TraceScene &scene) override;
+        virtual void update(const TraceScene &scene) override;
+        virtual bool intersect(const TraceRay &ray, TraceHit &hit) const override;
+        //refits the tree to the scene's vertices without checking its cost; the scene must have the triangles it was
+        //built with
+        void refit(const TraceScene &scene);
+        uint32_t getNodeCount();
+        //the surface area heuristic of the whole tree: every node's area relative to the root's, weighted by the cost of
+        //visiting it or of testing its triangles
+        float getSahCost();
+        double getBuildSeconds();
+        //the time of the last update, refit and any rebuild included, and whether it rebuilt
+        double getUpdateSeconds();
+        bool getLastUpdateRebuilt();
+    private:
+        struct BuildTask {
+            uint32_t node, begin, end, depth;
+        };
+        //the nodes from begin to end were built as one task, below a root among the top nodes
+        struct Subtree {
+            uint32_t begin, end;
+        };
+
+        ThreadPool *_pThreadPool;
+        WorkStealingScheduler _scheduler;
+        std::vector<BvhNode> _nodes;
+        std::vector<BvhTriangle> _triangles;
+        //the geometry and primitive of each triangle in leaf order
+        std::vector<simd::uint2> _triangleIds;
+        std::vector<BvhPrimitive> _primitives;
+        std::vector<uint32_t> _order;
+        std::vector<Subtree> _subtrees;
+        uint32_t _topNodeCount = 0;
+        //the triangles of each geometry the tree was built for, which a refit must find again
+        std::vector<uint32_t> _geometryTriangleCounts;
+        float _builtSahCost = 0;
+        double _buildSeconds = 0, _updateSeconds = 0;
+        bool _lastUpdateRebuilt = false;
+
+        bool splitNode(BvhNode &node, uint32_t begin, uint32_t end, uint32_t depth, bool parallel, uint32_t &middle);
+        void buildSubtree(std::vector<BvhNode> &nodes, uint32_t node, uint32_t begin, uint32_t end, uint32_t depth);
+        void gatherTriangles(const TraceScene &scene);
+        void refitNode(uint32_t index);
+        bool canRefit(const TraceScene &scene);
+};
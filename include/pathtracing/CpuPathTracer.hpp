@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include "HdriImage.hpp"
+#include "WorkStealingScheduler.hpp"
+#include "pathtracing/Intersector.hpp"
+
+//side of the square tiles a frame is split into; each is one work item of the scheduler
+constexpr uint32_t TILE_SIZE = 16;
+
+//CPU port of sampleSceneKernel, for hosts without a Metal device and as a reference for the GPU frames
+//fills the same three images as the kernel's textures, RGBA float texels in rows from the top: depth and normal, the
+//screen motion since the last frame, and the tonemapped colour. tiles are handed out by a WorkStealingScheduler, and
+//spp and bounces pick a tile kernel built for them, as the function constants do for the Metal kernel
+class CpuPathTracer {
+    public:
+        CpuPathTracer(ThreadPool *pThreadPool, uint32_t width, uint32_t height, uint32_t spp, uint32_t bounces);
+
+        //rand seeds the frame's samples like the kernel's rand buffer; motion needs the scene's primitive motion updated
+        //with the frame's projection first, and static geometries' motion the last frame's projection in prevPvMat
+        void render(const TraceScene &scene, const Intersector &intersector, const HdriImage &hdri, simd::float3 origin, simd::float4x4 pvMatInv, simd::float4x4 prevPvMat, uint32_t rand);
+        uint32_t getWidth();
+        uint32_t getHeight();
+        const std::vector<simd::float4>& getDepthNormal();
+        const std::vector<simd::float4>& getMotion();
+        const std::vector<simd::float4>& getOutput();
+        uint32_t getTileCount();
+        //tiles the last render moved between threads
+        uint32_t getLastStolenTiles();
+    private:
+        WorkStealingScheduler _scheduler;
+        uint32_t _width, _height, _spp, _bounces;
+        std::vector<simd::float4> _depthNormal, _motion, _output;
+        std::vector<simd::float4x4> _normalTransforms;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "pathtracing/TraceScene.hpp"
+
+typedef struct TraceRay {
+    simd::float3 origin, direction;
+    float minDistance, maxDistance;
+} TraceRay;
+
+//barycentricCoord weighs the triangle's second and third vertices, like triangle_barycentric_coord
+typedef struct TraceHit {
+    float distance;
+    simd::float2 barycentricCoord;
+    uint32_t geometryId, primitiveId;
+} TraceHit;
+
+//Moller-Trumbore, two-sided like the Metal intersector; a hit must lie strictly inside the ray's distance range
+inline bool intersectTriangle(const TraceRay &ray, simd::float3 v0, simd::float3 v1, simd::float3 v2, float &distance, simd::float2 &barycentricCoord) {
+    simd::float3 edge1 = v1 - v0, edge2 = v2 - v0;
+    simd::float3 p = simd::cross(ray.direction, edge2);
+    float determinant = simd::dot(edge1, p);
+    if (fabsf(determinant) < 1e-12f) return false;
+    float inverseDeterminant = 1 / determinant;
+    simd::float3 offset = ray.origin - v0;
+    float u = simd::dot(offset, p) * inverseDeterminant;
+    if (u < 0 || u > 1) return false;
+    simd::float3 q = simd::cross(offset, edge1);
+    float v = simd::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0 || u + v > 1) return false;
+    float t = simd::dot(edge2, q) * inverseDeterminant;
+    if (t <= ray.minDistance || t >= ray.maxDistance) return false;
+    distance = t;
+    barycentricCoord = simd::float2{u, v};
+    return true;
+}
+
+//slab test against the box from lower to upper, with the reciprocal of the ray direction precomputed by the caller;
+//the distance the ray enters the box at, or infinity if it misses it before maxDistance
+inline float getBoundsDistance(const TraceRay &ray, simd::float3 inverseDirection, simd::float3 lower, simd::float3 upper, float maxDistance) {
+    simd::float3 t0 = (lower - ray.origin) * inverseDirection;
+    simd::float3 t1 = (upper - ray.origin) * inverseDirection;
+    float near = simd::reduce_max(simd::min(t0, t1));
+    float far = simd::reduce_min(simd::max(t0, t1));
+    return near <= far && far >= ray.minDistance && near <= maxDistance ? near : INFINITY;
+}
+
+inline bool intersectBounds(const TraceRay &ray, simd::float3 inverseDirection, simd::float3 lower, simd::float3 upper, float maxDistance) {
+    return getBoundsDistance(ray, inverseDirection, lower, upper, maxDistance) != INFINITY;
+}
+
+//closest-hit queries against a TraceScene's triangles, the part of the acceleration structure and intersector that
+//sampleSceneKernel uses
+class Intersector {
+    public:
+        virtual ~Intersector() = default;
+
+        //called after the scene's vertices move, before the next intersect
+        virtual void build(const TraceScene &scene) = 0;
+        //called instead of build when only the scene's vertices have moved since the last build or update, so the
+        //structure may be refit to them rather than built again
+        virtual void update(const TraceScene &scene) {this->build(scene);};
+        virtual bool intersect(const TraceRay &ray, TraceHit &hit) const = 0;
+};
+
+//tests every triangle of each geometry whose bounds the ray crosses; slow, but with nothing to go stale
+class TriangleListIntersector : public Intersector {
+    public:
+        virtual void build(const TraceScene &scene) override;
+        virtual bool intersect(const TraceRay &ray, TraceHit &hit) const override;
+    private:
+        std::vector<TraceGeometry> _geometries;
+        std::vector<simd::float3> _lowerBounds, _upperBounds;
+};
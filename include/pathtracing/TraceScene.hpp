@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+
+//one triangle geometry of a TraceScene, the CPU counterpart of an AccelerationStructureTriangleGeometryDescriptor: it
+//points at vertex, index and PrimitiveData arrays owned elsewhere, such as by a CpuCloth, instead of copying them
+typedef struct TraceGeometry {
+    const pfloat3 *vertices;
+    const uint32_t *indices;
+    PrimitiveData *primitiveData;
+    uint32_t triangleCount;
+    //places the vertices in the scene, like the transform of the instance the geometry is for
+    simd::float4x4 transform = matrix_identity_float4x4;
+    //whether primitiveData's screen coordinates are the geometry's own, as a dynamic instance's are; every placement of
+    //a static object shares its PrimitiveData, so the hit point on one is reprojected with the last frame's matrix
+    bool dynamic = true;
+
+    inline simd::float3 getVertex(uint32_t index) const {
+        pfloat3 vertex = this->vertices[index];
+        simd::float4 placed = this->transform * simd::float4{vertex.x, vertex.y, vertex.z, 1};
+        return simd::float3{placed.x, placed.y, placed.z};
+    };
+} TraceGeometry;
+
+//what sampleSceneKernel reads from a Scene, without Metal: the geometries in geometry id order, the material of each
+//geometry and the materials themselves
+struct TraceScene {
+    std::vector<TraceGeometry> geometries;
+    std::vector<uint16_t> geometryMaterials;
+    std::vector<Material> materials;
+
+    inline uint32_t getTriangleCount() const {
+        uint32_t triangleCount = 0;
+        for (const TraceGeometry &geometry: this->geometries) triangleCount += geometry.triangleCount;
+        return triangleCount;
+    };
+    //the work of motionVectorKernel: moves every dynamic geometry's triangles' screen coordinates to the previous
+    //frame's slots and projects their vertices with vpMat into the current ones
+    void updatePrimitiveMotion(simd::float4x4 vpMat);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ComputePipelineState.hpp"
+#include "SceneObject.hpp"
+#include "simulation/BakeCache.hpp"
+
+//plays a cloth back from a bake written through Cloth::setBakeWriter instead of simulating it, one baked frame per
+//update and looping at the end; frames decode straight from the mapped file into whichever of two vertex buffers the
+//last rendered frame is not using
+class BakedCloth: public SceneObject {
+    public:
+        BakedCloth(MTL::Device *pDevice, const char *fileName);
+        ~BakedCloth();
+
+        virtual void update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) override;
+        virtual void updateGeometry() override;
+        virtual bool isDynamic() override {return true;};
+    private:
+        BakeReader _reader;
+        uint32_t _frame = 0;
+        ComputePipelineState *_pNormalsPipelineState;
+        MTL::Buffer *_pVertexBuffer;
+        MTL::Buffer *_pNextVertexBuffer;
+        MTL::Buffer *_pIndexBuffer;
+        MTL::Buffer *_pDataBuffer;
+};
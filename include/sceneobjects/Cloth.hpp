@@ -1,22 +1,92 @@
 #pragma once
 
+#include <vector>
+#include "ClothAttachmentBuffers.hpp"
+#include "ComputePipelineState.hpp"
 #include "SceneObject.hpp"
+#include "WindTextures.hpp"
+#include "simulation/BakeCache.hpp"
+#include "simulation/ClothModel.hpp"
 
 class Cloth: public SceneObject {
     public:
-        Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant);
+        //deterministic double-buffers the particles so repeated runs of the same input produce identical results
+        //INTEGRATOR_XPBD is deterministic on its own; INTEGRATOR_IMPLICIT only exists on the CPU backend and falls back to explicit
+        Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant, bool deterministic = false, ClothIntegrator integrator = INTEGRATOR_EXPLICIT);
         ~Cloth();
 
-        virtual void update(MTL::CommandBuffer *pCmd, MTL::AccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) override;
+        //moveDirection carries handle 0, which the top row starts attached to, as a velocity over the frame
+        virtual void update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) override;
         virtual void updateGeometry() override;
+        virtual bool isDynamic() override {return true;};
+        //replaces the attachments, which particles are indexed row by row like generateClothParticles
+        void setAttachments(const std::vector<Attachment> &attachments);
+        //the transform a handle reaches at the end of the next update; its attachments move there over the frame
+        void setHandleTransform(uint32_t handle, simd::float4x4 transform);
+        //cloth-cloth contact before every substep, on by default
+        void setSelfCollision(bool enable);
+        //appends every simulated frame's vertices to pBakeWriter, which must hold particleCount^2 vertices; nullptr stops
+        void setBakeWriter(BakeWriter *pBakeWriter);
+        //wind the cloth feels when wind is enabled, instead of the constant breeze; the caller owns and advances the
+        //field, and nullptr goes back to the breeze
+        void setWindField(const WindField *pWindField);
+
+        //every grid of the same resolution on a device shares one index buffer; acquire hands out a retained reference,
+        //generating the buffer only for the first cloth, and the last release frees it
+        static MTL::Buffer *acquireIndexBuffer(MTL::Device *pDevice, uint32_t particleCount);
+        static void releaseIndexBuffer(MTL::Buffer *pIndexBuffer);
     private:
         float _springConstant;
         float _size;
         uint32_t _particleCount;
+        bool _deterministic;
+        ClothIntegrator _integrator;
         MTL::Size _clothTPG, _clothTPT;
         MTL::ComputePipelineState *_pComputeClothPipelineState;
         MTL::IntersectionFunctionTable *_pIntersectionFunctionTable;
         MTL::Buffer *_pVertexBuffer;
+        MTL::Buffer *_pIndexBuffer;
         MTL::Buffer *_pDataBuffer;
         MTL::Buffer *_pParticleBuffer;
+        MTL::Buffer *_pNextParticleBuffer = nullptr;
+        ComputePipelineState *_pNormalsPipelineState = nullptr;
+        ComputePipelineState *_pPredictPipelineState = nullptr;
+        MTL::ComputePipelineState *_pProjectPipelineState = nullptr;
+        MTL::Buffer *_pPredictedPositionBuffer = nullptr;
+        MTL::Buffer *_pConstraintBuffer = nullptr;
+        std::vector<uint32_t> _colorStarts;
+        ComputePipelineState *_pSubstepLimitPipelineState = nullptr;
+        MTL::Buffer *_pSubstepLimitBuffer = nullptr;
+        bool _hasSubstepLimit = false;
+        simd::float3 _substepLimitMoveDirection;
+        bool _substepLimitWind;
+        bool _selfCollision = true;
+        BakeWriter *_pBakeWriter = nullptr;
+        ComputePipelineState *_pTriangleDragPipelineState;
+        MTL::Buffer *_pTriangleDragBuffer;
+        WindTextures *_pWindTextures;
+        ClothAttachmentBuffers *_pAttachmentBuffers;
+        ComputePipelineState *_pCountTrianglesPipelineState;
+        ComputePipelineState *_pScanBucketsPipelineState;
+        ComputePipelineState *_pScatterTrianglesPipelineState;
+        ComputePipelineState *_pCollideSelfPipelineState;
+        ComputePipelineState *_pApplySelfCollisionPipelineState;
+        MTL::Buffer *_pTriangleBoundsBuffer;
+        MTL::Buffer *_pTriangleNormalsBuffer;
+        MTL::Buffer *_pBucketCountBuffer;
+        MTL::Buffer *_pBucketStartBuffer;
+        MTL::Buffer *_pBucketCursorBuffer;
+        MTL::Buffer *_pBucketEntryBuffer;
+        //the most entries a scan of the last update needed, read back to grow the entry buffer
+        MTL::Buffer *_pRequiredEntryBuffer;
+        uint32_t _entryCapacity;
+        MTL::Buffer *_pSelfCollisionCorrectionBuffer;
+
+        unsigned int getSubsteps(float dt, simd::float3 moveDirection, bool enable);
+        void encodeSelfCollision(MTL::ComputeCommandEncoder *pCEnc);
+        void growSelfCollisionEntries();
+        void encodeTriangleDrag(MTL::ComputeCommandEncoder *pCEnc);
+        void synchronizeBakedVertices(MTL::CommandBuffer *pCmd);
+
+        void updateXpbd(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable);
 };
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include "ClothAttachmentBuffers.hpp"
+#include "ComputePipelineState.hpp"
+#include "SceneObject.hpp"
+#include "WindTextures.hpp"
+#include "simulation/ClothModel.hpp"
+
+//one cloth of a ClothBatch; offset moves it away from where generateClothParticles places a lone cloth
+typedef struct ClothDescription {
+    float size;
+    uint32_t particleCount;
+    float unitMass, springConstant, dampingConstant;
+    simd::float3 offset;
+} ClothDescription;
+
+//steps many cloths, of any resolution, with one pipeline and one dispatch per substep
+//particles, vertices, indices and primitive data of every cloth are packed into shared arenas, and a ClothInstance
+//table tells each thread which cloth it belongs to
+class ClothBatch: public SceneObject {
+    public:
+        ClothBatch(MTL::Device *pDevice, const std::vector<ClothDescription> &descriptions);
+        ~ClothBatch();
+
+        //moveDirection carries handle 0, which the top row of every cloth starts attached to, as a velocity over the frame
+        virtual void update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) override;
+        virtual void updateGeometry() override;
+        virtual bool isDynamic() override {return true;};
+        //replaces the attachments of every cloth; particles are indexed in the shared arena, each cloth's after the last
+        void setAttachments(const std::vector<Attachment> &attachments);
+        //the transform a handle reaches at the end of the next update; its attachments move there over the frame
+        void setHandleTransform(uint32_t handle, simd::float4x4 transform);
+        //wind every cloth of the batch feels when wind is enabled; the caller owns and advances the field
+        void setWindField(const WindField *pWindField);
+    private:
+        std::vector<ClothDescription> _descriptions;
+        uint32_t _instanceCount;
+        uint32_t _triangleCount;
+        MTL::Size _clothTPG, _clothTPT;
+        MTL::ComputePipelineState *_pComputeClothPipelineState;
+        ComputePipelineState *_pNormalsPipelineState;
+        ComputePipelineState *_pTriangleDragPipelineState;
+        MTL::IntersectionFunctionTable *_pIntersectionFunctionTable;
+        MTL::Buffer *_pInstanceBuffer;
+        MTL::Buffer *_pVertexBuffer;
+        MTL::Buffer *_pIndexBuffer;
+        MTL::Buffer *_pDataBuffer;
+        MTL::Buffer *_pParticleBuffer;
+        MTL::Buffer *_pNextParticleBuffer;
+        MTL::Buffer *_pTriangleDragBuffer;
+        WindTextures *_pWindTextures;
+        ClothAttachmentBuffers *_pAttachmentBuffers;
+};
@@ -10,6 +10,5 @@ class TestScene: public Scene {
         TestScene(MTL::Device *pDevice);
 
         virtual Camera getInitialCamera() override;
-        virtual std::vector<uint16_t> getGeometryMaterials() override;
         virtual std::vector<Material> getMaterials() override;
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+#include "SharedTypes.h"
+
+//bake files hold the vertex positions of one cloth for every simulated frame, grouped into chunks that decode on their own
+//a chunk quantizes its frames to 16 bits inside the chunk's bounding box; its first frame is stored as is and every later
+//one as the zigzag varint residual against the previous frame moved on by the last frame's motion, which is a byte or
+//two per component for smooth cloth instead of the four a float takes
+
+typedef struct BakeHeader {
+    char magic[4];
+    uint32_t version, vertexCount, chunkFrames;
+} BakeHeader;
+
+//followed by vertexCount quantized keyframe positions and then byteCount bytes of residuals
+typedef struct BakeChunkHeader {
+    uint32_t frameCount, byteCount;
+    pfloat3 origin, scale;
+} BakeChunkHeader;
+
+constexpr uint32_t BAKE_VERSION = 1;
+
+//buffers frames until a chunk is full, then writes it; frames left over are written when the writer is destroyed
+class BakeWriter {
+    public:
+        BakeWriter(const char *fileName, uint32_t vertexCount, uint32_t chunkFrames = 32);
+        ~BakeWriter();
+
+        void addFrame(const pfloat3 *vertices);
+        uint32_t getFrameCount();
+        uint64_t getByteCount();
+    private:
+        FILE *_pFile;
+        uint32_t _vertexCount, _chunkFrames;
+        uint32_t _frameCount = 0;
+        uint64_t _byteCount = 0;
+        std::vector<pfloat3> _frames;
+        std::vector<uint8_t> _residuals;
+        std::vector<uint16_t> _keyframe;
+        std::vector<int32_t> _previous, _beforePrevious;
+
+        void flush();
+};
+
+//memory-maps a bake and decodes frames in order; asking for an earlier frame, or one in a later chunk, restarts from
+//that chunk's keyframe. a header that does not match the file throws from the constructor, and residuals running
+//past their chunk throw from readFrame
+class BakeReader {
+    public:
+        BakeReader(const char *fileName);
+        ~BakeReader();
+
+        uint32_t getVertexCount();
+        uint32_t getFrameCount();
+        void readFrame(uint32_t frame, pfloat3 *vertices);
+    private:
+        void *_pMapping;
+        size_t _mappingSize;
+        uint32_t _vertexCount, _chunkFrames;
+        std::vector<const uint8_t*> _chunks;
+        uint32_t _frameCount = 0;
+        uint32_t _decodedFrame = UINT32_MAX;
+        const uint8_t *_pCursor = nullptr, *_pChunkEnd = nullptr;
+        std::vector<int32_t> _previous, _beforePrevious;
+
+        void decodeNextFrame();
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+
+//dense 3x3 block, one per pair of coupled particles
+struct Block3 {
+    simd::float3 rows[3];
+
+    static inline Block3 zero() {return Block3{};};
+    static inline Block3 identity() {return Block3{{simd::float3{1, 0, 0}, simd::float3{0, 1, 0}, simd::float3{0, 0, 1}}};};
+    static inline Block3 outer(simd::float3 a, simd::float3 b) {return Block3{{a.x * b, a.y * b, a.z * b}};};
+
+    inline simd::float3 operator*(simd::float3 v) const {return simd::float3{simd::dot(this->rows[0], v), simd::dot(this->rows[1], v), simd::dot(this->rows[2], v)};};
+    inline Block3 operator*(float s) const {return Block3{{this->rows[0] * s, this->rows[1] * s, this->rows[2] * s}};};
+    inline Block3 operator+(const Block3 &b) const {return Block3{{this->rows[0] + b.rows[0], this->rows[1] + b.rows[1], this->rows[2] + b.rows[2]}};};
+    inline Block3 operator-(const Block3 &b) const {return Block3{{this->rows[0] - b.rows[0], this->rows[1] - b.rows[1], this->rows[2] - b.rows[2]}};};
+    inline Block3& operator+=(const Block3 &b) {*this = *this + b; return *this;};
+    inline Block3& operator-=(const Block3 &b) {*this = *this - b; return *this;};
+
+    Block3 inverse() const;
+};
+
+//square matrix of 3x3 blocks in compressed sparse row form; the pattern is fixed once and the blocks are refilled every step
+class BlockSparseMatrix {
+    public:
+        //columns of each row must be sorted and include the diagonal
+        void setPattern(std::vector<uint32_t> rowStarts, std::vector<uint32_t> columns);
+
+        uint32_t getRowCount() const;
+        uint32_t getRowStart(uint32_t row) const;
+        uint32_t getRowEnd(uint32_t row) const;
+        uint32_t getColumn(uint32_t block) const;
+        uint32_t getDiagonal(uint32_t row) const;
+        Block3& getBlock(uint32_t block);
+        const Block3& getBlock(uint32_t block) const;
+
+        //y = Ax for rows [begin, end)
+        void multiply(const simd::float3 *x, simd::float3 *y, uint32_t begin, uint32_t end) const;
+    private:
+        std::vector<uint32_t> _rowStarts;
+        std::vector<uint32_t> _columns;
+        std::vector<uint32_t> _diagonals;
+        std::vector<Block3> _blocks;
+};
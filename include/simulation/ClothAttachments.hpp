@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+
+//the attachments of one cloth and the handles they hang from, as flat arrays the solvers walk directly
+//handles are transforms the host moves every frame without touching the attachments; each keeps the transform it had
+//when the frame began, so substeps can carry attached particles along the way instead of jumping at the end
+//handle 0 is the one the pinned particles of a new cloth hang from, and follows the moveDirection cloths are updated with
+class ClothAttachments {
+    public:
+        ClothAttachments(uint32_t particleCount);
+
+        //replaces every attachment; a particle may appear in at most one, and handles are added as referenced
+        //attachments are kept sorted by particle, so those of a range of particles are a range too
+        void setAttachments(const std::vector<Attachment> &attachments);
+        inline const std::vector<Attachment>& getAttachments() const {return this->_attachments;};
+        inline uint32_t getAttachmentCount() const {return this->_attachments.size();};
+        //index of the first attachment on a particle at or after the given one
+        uint32_t findAttachment(uint32_t particle) const;
+        //whether the particle is held by an ATTACHMENT_HARD attachment, so solvers can give it infinite mass
+        inline bool isHard(uint32_t particle) const {return this->_hard[particle];};
+        inline const std::vector<uint8_t>& getHardParticles() const {return this->_hard;};
+        //grows the hard mask over particles added since, which start unattached
+        void setParticleCount(uint32_t particleCount);
+
+        uint32_t getHandleCount() const;
+        void setHandleTransform(uint32_t handle, simd::float4x4 transform);
+        simd::float4x4 getHandleTransform(uint32_t handle) const;
+        void translateHandle(uint32_t handle, simd::float3 offset);
+        //whether the handle moves during the frame being simulated
+        bool isHandleMoving(uint32_t handle) const;
+        //the transforms at the start and end of the frame of every handle, interleaved, as the Metal kernels read them
+        inline const std::vector<simd::float4x4>& getHandleTransforms() const {return this->_transforms;};
+        //where an attachment's particle belongs a fraction of the way through the frame
+        simd::float3 getTarget(const Attachment &attachment, float fraction) const;
+        //once a frame has been simulated, its end transforms become the start of the next
+        void endFrame();
+    private:
+        std::vector<Attachment> _attachments;
+        std::vector<uint8_t> _hard;
+        std::vector<simd::float4x4> _transforms;
+
+        void addHandles(uint32_t handleCount);
+};
+
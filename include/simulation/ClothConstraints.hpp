@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+#include "simulation/ClothModel.hpp"
+
+//longest substep the XPBD solvers take; the count only follows the frame time, never the stiffness
+constexpr float XPBD_SUBSTEP = 1.0f / 480;
+
+uint32_t getXpbdSubsteps(float dt);
+
+//the distance 1 and 2 springs of applyClothSpringDampers as one constraint per particle pair
+std::vector<DistanceConstraint> buildClothConstraints(const ClothParameters &params);
+
+//greedily reorders constraints into batches that share no particle and returns where each batch starts,
+//followed by the total constraint count
+std::vector<uint32_t> colorConstraints(std::vector<DistanceConstraint> &constraints, uint32_t particleCount);
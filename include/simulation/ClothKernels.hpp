@@ -0,0 +1,48 @@
+#pragma once
+
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothModel.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+#include "simulation/CollisionDelegate.hpp"
+#include "simulation/WindField.hpp"
+
+//CPU counterparts of the stages in simulateClothKernel, each covering a range the caller hands to one thread
+//force accumulation only writes the accelerations of its own row, so rows can run in parallel against a fixed state
+
+//drag is two passes: computeClothTriangleDrag finds the force on each triangle in [begin, end) once, and the force
+//accumulation below gives every particle a third of the triangles around it, so it must run first on the same state
+//with wind enabled each triangle feels pWindField at its centroid, or the constant breeze of (0, 0, 2) without a field
+void computeClothTriangleDrag(const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end, bool enableWind, const WindField *pWindField);
+void accumulateClothForces(const ClothParameters &params, ClothState &state, uint32_t y);
+//gravity and drag only, for solvers that handle the springs as constraints
+void accumulateClothExternalForces(const ClothParameters &params, ClothState &state, uint32_t y);
+void simulateClothMotion(ClothState &state, uint32_t begin, uint32_t end, float dt);
+//pulls the particles of attachments [begin, end) toward their targets a fraction of the way through the frame, see
+//getAttachmentCorrection in Simulation.metal; runs after the motion it corrects
+void applyClothAttachments(const ClothParameters &params, const ClothAttachments &attachments, ClothState &state, uint32_t begin, uint32_t end, float dt, float fraction);
+void constrainClothCollision(CollisionDelegate *pCollisionDelegate, ClothState &state, const pfloat3 *previousPositions, uint32_t begin, uint32_t end);
+//smallest substep limit over a row, see getSubstepLimit in Simulation.metal
+float getClothSubstepLimit(const ClothParameters &params, const ClothState &state, uint32_t y, bool enableWind, const WindField *pWindField);
+void recalculateClothNormals(const ClothParameters &params, const ClothState &state, uint32_t y, PrimitiveData *primitiveData);
+
+//the four grid kernels above compiled for one side length, which unrolls the row loops and folds the border tests the
+//way the particleCount function constant does for simulateClothKernel; particleCount is 0 for the generic set
+typedef struct ClothGridKernels {
+    uint32_t particleCount;
+    void (*accumulateForces)(const ClothParameters &params, ClothState &state, uint32_t y);
+    void (*accumulateExternalForces)(const ClothParameters &params, ClothState &state, uint32_t y);
+    float (*getSubstepLimit)(const ClothParameters &params, const ClothState &state, uint32_t y, bool enableWind, const WindField *pWindField);
+    void (*recalculateNormals)(const ClothParameters &params, const ClothState &state, uint32_t y, PrimitiveData *primitiveData);
+} ClothGridKernels;
+
+//the prebuilt set for a grid of particleCount x particleCount particles, or the generic one reading the side length from
+//the parameters when none was built for it
+ClothGridKernels getClothGridKernels(uint32_t particleCount);
+
+//the same stages over a ClothTopology for particles [begin, end): springs come from the particle's row and drag from
+//the triangles around it, so they work for any mesh; each particle still only writes its own outputs
+void accumulateClothForces(const ClothParameters &params, const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end);
+void accumulateClothExternalForces(const ClothParameters &params, const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end);
+float getClothSubstepLimit(const ClothParameters &params, const ClothTopology &topology, const ClothState &state, uint32_t begin, uint32_t end, bool enableWind, const WindField *pWindField);
+void recalculateClothNormals(const ClothTopology &topology, const ClothState &state, uint32_t begin, uint32_t end, PrimitiveData *primitiveData);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+
+//sizing of the self-collision spatial hash, shared by the CPU and Metal versions
+typedef struct SelfCollisionParameters {
+    uint32_t tableSize, capacity;
+    float thickness, cellSize;
+} SelfCollisionParameters;
+
+//how the CPU backend advances the cloth between frames
+enum ClothIntegrator {
+    INTEGRATOR_EXPLICIT,    //substeps of simulateClothKernel, length chosen by getClothSubstepLimit
+    INTEGRATOR_IMPLICIT,    //one backward Euler step per frame
+    INTEGRATOR_XPBD         //fixed-length substeps projecting the springs as compliant distance constraints
+};
+
+ClothParameters makeClothParameters(float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant);
+
+//thickness defaults to half a side spring; the capacity only sizes the Metal entry buffer to start with, and both the
+//Metal and the CPU entries grow as needed
+SelfCollisionParameters makeSelfCollisionParameters(const ClothParameters &params, uint32_t triangleCount, float thickness);
+
+//cap on the adaptive substep count, so a cloth that has already blown up cannot stall the frame
+constexpr uint32_t MAX_CLOTH_SUBSTEPS = 1000;
+
+//generate timestep based on stiffness, particle density, and delta time
+uint32_t getClothSubsteps(float springConstant, float size, uint32_t particleCount, float dt);
+//substeps needed to cover dt without exceeding the reduced per-particle substep limit
+uint32_t getAdaptiveClothSubsteps(float substepLimit, float dt);
+
+void generateClothIndices(uint32_t particleCount, uint32_t *indices);
+void generateClothParticles(float size, uint32_t particleCount, Particle *particles);
+//only the quad rows [firstRow, lastRow) of generateClothIndices and the particle rows of generateClothParticles, written at
+//their place in the full arrays so separate threads can fill one buffer in chunks
+void generateClothIndices(uint32_t particleCount, uint32_t *indices, uint32_t firstRow, uint32_t lastRow);
+void generateClothParticles(float size, uint32_t particleCount, Particle *particles, uint32_t firstRow, uint32_t lastRow);
+//the top row of generateClothParticles held hard on handle 0 where it was generated
+std::vector<Attachment> generateClothAttachments(uint32_t particleCount, const Particle *particles);
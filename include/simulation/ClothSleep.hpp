@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include "ThreadPool.hpp"
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+
+//sleep tracking for the explicit CPU integrator over blocks of blockSize consecutive particles, whole rows on a grid
+//so the row kernels keep working
+//a block whose particles stay below SLEEP_ENERGY kinetic energy per unit mass and whose springs stretch slower than
+//SLEEP_STRAIN_RATE for SLEEP_SUBSTEPS substeps in a row has its velocities zeroed and is skipped; a block that is
+//still moving wakes the sleeping blocks it shares springs with, so disturbances spread one block per substep
+class ClothSleep {
+    public:
+        //the topology must outlive the tracker; blocks cover particleCapacity particles when the topology can grow by
+        //tearing, and the blocks past its last particle stay empty until it does
+        ClothSleep(const ClothTopology &topology, uint32_t blockSize, uint32_t particleCapacity = 0);
+
+        inline uint32_t getBlockCount() const {return this->_awake.size();};
+        inline uint32_t getBlock(uint32_t particle) const {return particle / this->_blockSize;};
+        inline uint32_t getBlockStart(uint32_t block) const {return block * this->_blockSize;};
+        uint32_t getBlockEnd(uint32_t block) const;
+        inline bool isAwake(uint32_t block) const {return this->_awake[block];};
+        //awake blocks in ascending order, so work over them splits the same way for any thread count
+        inline const std::vector<uint32_t>& getAwakeBlocks() const {return this->_awakeBlocks;};
+        inline bool isAllAwake() const {return this->_awakeBlocks.size() == this->_awake.size();};
+        //drag on a triangle is needed while any of its corners is awake
+        bool isTriangleAwake(uint32_t triangle) const;
+        //whether the block was awake at any point since the last beginFrame, or, with neighbours, whether it or a
+        //block it shares springs with was, which is what normals depend on
+        bool wasActive(uint32_t block, bool neighbours) const;
+
+        void beginFrame();
+        void wakeAll();
+        //wakes the blocks holding particles attached to a handle that moves this frame
+        void wakeAttachments(const ClothAttachments &attachments);
+        //measures the awake blocks after a substep, putting quiet ones to sleep and waking the neighbours of moving ones
+        void update(ThreadPool *pThreadPool, ClothState &state);
+        //after tearing changed the springs of the given particles: gathers the block neighbours again from the spring
+        //list and wakes the particles' blocks
+        void updateTopology(const std::vector<uint32_t> &particles);
+    private:
+        const ClothTopology *_pTopology;
+        uint32_t _blockSize;
+        std::vector<uint8_t> _awake, _active, _quiet;
+        std::vector<uint32_t> _quietSubsteps;
+        std::vector<uint32_t> _awakeBlocks;
+        //blocks sharing a spring with each block, in compressed sparse row form
+        std::vector<uint32_t> _neighbourStarts, _neighbours;
+
+        void wake(uint32_t block);
+        void collectAwakeBlocks();
+        void collectNeighbours();
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+
+//structure-of-arrays particle storage for the CPU solvers
+//every component lives in its own array so a spring pass loads FloatBatch::width neighbours with one instruction
+struct ClothState {
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> accelerationX, accelerationY, accelerationZ;
+    //force on each triangle from computeClothTriangleDrag, sized by whoever owns the triangles
+    std::vector<simd::float3> triangleDrag;
+
+    void resize(uint32_t count);
+    //room for particles added later without moving the arrays, like those tearing splits off
+    void reserve(uint32_t count);
+    uint32_t size() const;
+    void importParticles(const Particle *particles, uint32_t count);
+    void exportParticles(Particle *particles) const;
+
+    inline simd::float3 getPosition(uint32_t i) const {return simd::float3{this->positionX[i], this->positionY[i], this->positionZ[i]};};
+    inline simd::float3 getVelocity(uint32_t i) const {return simd::float3{this->velocityX[i], this->velocityY[i], this->velocityZ[i]};};
+    inline simd::float3 getAcceleration(uint32_t i) const {return simd::float3{this->accelerationX[i], this->accelerationY[i], this->accelerationZ[i]};};
+    inline void setPosition(uint32_t i, simd::float3 v) {this->positionX[i] = v.x; this->positionY[i] = v.y; this->positionZ[i] = v.z;};
+    inline void setVelocity(uint32_t i, simd::float3 v) {this->velocityX[i] = v.x; this->velocityY[i] = v.y; this->velocityZ[i] = v.z;};
+    inline void setAcceleration(uint32_t i, simd::float3 v) {this->accelerationX[i] = v.x; this->accelerationY[i] = v.y; this->accelerationZ[i] = v.z;};
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include "ThreadPool.hpp"
+#include "simulation/ClothSleep.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+
+//tearing for the CPU solvers: springs stretched past a strain break, and a particle whose triangles are no longer joined
+//by unbroken edges is split into one particle per piece; the triangles of the new pieces point at spare particle
+//slots appended after the last particle, so the index array is patched in place and nothing is reallocated
+//breaking an edge also breaks the bending spring across it, which would otherwise hold the two sides together
+class ClothTearing {
+    public:
+        //reserves the topology's rows for particleCapacity particles; the topology must outlive the tearing
+        ClothTearing(ClothTopology &topology, float strain, uint32_t particleCapacity);
+
+        //breaks the springs of awake blocks stretched past the strain and splits the particles they cut apart, serially,
+        //so the result does not depend on the thread count; returns whether anything tore
+        //split particles take the position and velocity of the one they split from, and stop splitting once every
+        //spare slot is used
+        bool apply(ThreadPool *pThreadPool, ClothState &state, const ClothSleep &sleep);
+        inline uint32_t getParticleCapacity() const {return this->_particleCapacity;};
+        //particles whose springs or triangles changed in the last apply, ascending, including the new ones
+        inline const std::vector<uint32_t>& getTornParticles() const {return this->_tornParticles;};
+    private:
+        ClothTopology *_pTopology;
+        float _strain;
+        uint32_t _particleCapacity;
+        std::vector<std::vector<uint64_t>> _candidates;
+        std::vector<uint32_t> _tornParticles;
+
+        void breakSpring(uint32_t a, uint32_t b);
+        void split(ClothState &state, uint32_t particle);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+#include "simulation/ClothModel.hpp"
+
+//triangle mesh a cloth can be built from instead of the square grid
+typedef struct ClothMesh {
+    std::vector<simd::float3> positions;
+    std::vector<uint32_t> indices;
+    //particles held hard on handle 0, like the top row of a grid cloth
+    std::vector<uint8_t> pinned;
+} ClothMesh;
+
+//springs and triangles of a cloth as flat arrays, so the CPU solvers can treat grids and arbitrary meshes alike
+//springs are stored once as DistanceConstraints and again per particle in compressed sparse row form, with each row
+//sorted by neighbour so a particle's gathers walk memory in one direction; the vertex to triangle rows list the triangles
+//around each particle together with the corner the particle sits at
+//rows end where springEnds and triangleEnds say rather than where the next one starts, so tearing can shrink a row in
+//place and append the rows of split particles after the last one, see ClothTearing
+struct ClothTopology {
+    //side length of the grid the topology was built from, 0 for meshes
+    uint32_t gridSize = 0;
+    uint32_t particleCount = 0, triangleCount = 0;
+    //most springs on any particle, which bounds the spring rates in getClothSubstepLimit
+    uint32_t maxSprings = 0;
+    std::vector<uint32_t> indices;
+    std::vector<DistanceConstraint> springs;
+    //springStarts and triangleStarts hold one more entry than there are particles, the end of their arrays
+    std::vector<uint32_t> springStarts, springEnds, springNeighbours;
+    std::vector<float> springRestLengths;
+    std::vector<uint32_t> triangleStarts, triangleEnds, triangleCorners;
+    //the original particle each one was split from by tearing, empty until the cloth first tears
+    std::vector<uint32_t> origins;
+
+    inline uint32_t getSpringStart(uint32_t particle) const {return this->springStarts[particle];};
+    inline uint32_t getSpringEnd(uint32_t particle) const {return this->springEnds[particle];};
+    inline uint32_t getTriangleStart(uint32_t particle) const {return this->triangleStarts[particle];};
+    inline uint32_t getTriangleEnd(uint32_t particle) const {return this->triangleEnds[particle];};
+    //triangleCorners packs the triangle index above the corner in the low two bits
+    static inline uint32_t getTriangle(uint32_t corner) {return corner >> 2;};
+    static inline uint32_t getCorner(uint32_t corner) {return corner & 3;};
+};
+
+//a mesh has no grid spacing, so the side spring length is the leg of a right triangle with the mesh's mean area and
+//the particle mass spreads the mesh area's mass evenly; particleCount is left at 0
+ClothParameters makeMeshClothParameters(const ClothMesh &mesh, float unitMass, float springConstant, float dampingConstant);
+
+//the distance 1 and 2 springs of applyClothSpringDampers and the triangles of generateClothIndices
+ClothTopology buildGridClothTopology(const ClothParameters &params);
+//one spring per mesh edge and one bending spring across every edge two triangles share, rest lengths taken from the
+//mesh as given
+ClothTopology buildMeshClothTopology(const ClothMesh &mesh);
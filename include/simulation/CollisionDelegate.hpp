@@ -0,0 +1,12 @@
+#pragma once
+
+#include "PortableSimd.hpp"
+
+//scene geometry the CPU cloth backend casts particle motion against, in place of the acceleration structure
+class CollisionDelegate {
+    public:
+        virtual ~CollisionDelegate() = default;
+
+        //on a hit, distance is measured along direction and normal is the interpolated surface normal facing the ray origin
+        virtual bool intersect(simd::float3 origin, simd::float3 direction, float maxDistance, simd::float3 particlePosition, float &distance, simd::float3 &normal) {return false;};
+};
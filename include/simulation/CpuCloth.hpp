@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include "SharedTypes.h"
+#include "ThreadPool.hpp"
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothKernels.hpp"
+#include "simulation/ClothModel.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+#include "simulation/CollisionDelegate.hpp"
+#include "simulation/WindField.hpp"
+
+class ImplicitSolver;
+class XpbdSolver;
+class SelfCollision;
+class ClothSleep;
+class ClothTearing;
+
+//CPU port of simulateClothKernel for machines without a Metal device, over the square grid or any triangle mesh
+//owns the same PrimitiveData, vertex and index arrays that back Cloth's buffers; particles are kept as a
+//ClothState and converted to the Particle layout on request
+//forces are always gathered from the previous substep, like Cloth's deterministic mode, so results do not
+//depend on the thread count; the explicit integrator skips blocks of particles that have come to rest, see ClothSleep
+class CpuCloth {
+    public:
+        CpuCloth(ThreadPool *pThreadPool, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant);
+        //cloth over an arbitrary triangle mesh; getParameters then reports a particleCount of 0
+        CpuCloth(ThreadPool *pThreadPool, const ClothMesh &mesh, float unitMass, float springConstant, float dampingConstant);
+        ~CpuCloth();
+
+        //moveDirection carries handle 0 for the frame, as a velocity
+        void update(float dt, simd::float3 moveDirection, bool enable);
+        //grid cloths start with their top row hard on handle 0, meshes with their pinned particles
+        void setAttachments(const std::vector<Attachment> &attachments);
+        //the transform a handle reaches at the end of the next update; its attachments move there over the frame
+        void setHandleTransform(uint32_t handle, simd::float4x4 transform);
+        const ClothAttachments& getAttachments();
+        void setCollisionDelegate(CollisionDelegate *pCollisionDelegate);
+        //cloth-cloth contact after every substep, on by default
+        void setSelfCollision(bool enable);
+        //springs stretched past 1 + strain times their rest length break at the end of every explicit frame, splitting
+        //the particles they cut apart into spare particles appended after the last one; spareParticles slots are
+        //reserved here, so getVertices and the state never move while the cloth tears. a grid cloth keeps its grid
+        //kernels until the first spring breaks, then moves to the mesh kernels for good, since only those read the
+        //springs from the topology; they cost about a quarter more per particle substep. 0 spare particles turns
+        //tearing off again
+        void setTearing(float strain, uint32_t spareParticles);
+        //wakes every block, for callers that change the state or what the cloth collides with
+        void wake();
+        void setIntegrator(ClothIntegrator integrator);
+        //wind the cloth feels when wind is enabled, instead of the constant breeze; the caller owns and advances the
+        //field, and nullptr goes back to the breeze
+        void setWindField(const WindField *pWindField);
+        ClothParameters getParameters();
+        uint32_t getTriangleCount();
+        const ClothTopology& getTopology();
+        ClothState& getState();
+        void exportParticles(Particle *particles);
+        PrimitiveData* getPrimitiveData();
+        pfloat3* getVertices();
+        const uint32_t* getIndices();
+        uint64_t getParticleSubsteps();
+        double getSimulationSeconds();
+        //conjugate gradient iterations of the last implicit step
+        unsigned int getSolverIterations();
+        //substeps the last update took
+        uint32_t getLastSubsteps();
+    private:
+        ClothParameters _parameters;
+        float _size = 0;
+        ThreadPool *_pThreadPool;
+        CollisionDelegate *_pCollisionDelegate = nullptr;
+        const WindField *_pWindField = nullptr;
+        ClothIntegrator _integrator = INTEGRATOR_EXPLICIT;
+        ImplicitSolver *_pImplicitSolver = nullptr;
+        XpbdSolver *_pXpbdSolver = nullptr;
+        SelfCollision *_pSelfCollision;
+        bool _selfCollision = true;
+        ClothSleep *_pSleep;
+        ClothAttachments *_pAttachments;
+        ClothTearing *_pTearing = nullptr;
+        bool _sleepWind = false;
+        unsigned int _solverIterations = 0;
+        ClothTopology _topology;
+        //the grid kernels built for this cloth's side length, unused on meshes
+        ClothGridKernels _gridKernels;
+        ClothState _state;
+        std::vector<PrimitiveData> _primitiveData;
+        std::vector<pfloat3> _vertices;
+        std::vector<float> _substepLimits;
+        uint32_t _lastSubsteps = 0;
+        uint64_t _particleSubsteps = 0;
+        double _simulationSeconds = 0;
+
+        void initialize(ClothTopology topology, const std::vector<Particle> &particles, const std::vector<Attachment> &attachments);
+        uint32_t getSubsteps(float dt, bool enableWind);
+        void simulate(float dt, float fraction, bool enableWind);
+        void collideSelf(float dt);
+        void tear();
+        void layOutForTearing();
+        void finalize();
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+//one float lane per particle; the widest vector unit the build targets decides how many particles share an instruction
+#if defined(__AVX512F__)
+
+struct FloatBatch {
+    static constexpr unsigned int width = 16;
+    __m512 v;
+
+    static inline FloatBatch load(const float *p) {return {_mm512_loadu_ps(p)};};
+    static inline FloatBatch broadcast(float f) {return {_mm512_set1_ps(f)};};
+    inline void store(float *p) const {_mm512_storeu_ps(p, this->v);};
+
+    friend inline FloatBatch operator+(FloatBatch a, FloatBatch b) {return {_mm512_add_ps(a.v, b.v)};};
+    friend inline FloatBatch operator-(FloatBatch a, FloatBatch b) {return {_mm512_sub_ps(a.v, b.v)};};
+    friend inline FloatBatch operator*(FloatBatch a, FloatBatch b) {return {_mm512_mul_ps(a.v, b.v)};};
+    friend inline FloatBatch operator/(FloatBatch a, FloatBatch b) {return {_mm512_div_ps(a.v, b.v)};};
+    friend inline FloatBatch multiplyAdd(FloatBatch a, FloatBatch b, FloatBatch c) {return {_mm512_fmadd_ps(a.v, b.v, c.v)};};
+    friend inline FloatBatch sqrt(FloatBatch a) {return {_mm512_sqrt_ps(a.v)};};
+    //lanes where a > b take value, the rest are zeroed
+    friend inline FloatBatch ifGreater(FloatBatch a, FloatBatch b, FloatBatch value) {return {_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ), value.v)};};
+};
+
+#elif defined(__AVX2__)
+
+struct FloatBatch {
+    static constexpr unsigned int width = 8;
+    __m256 v;
+
+    static inline FloatBatch load(const float *p) {return {_mm256_loadu_ps(p)};};
+    static inline FloatBatch broadcast(float f) {return {_mm256_set1_ps(f)};};
+    inline void store(float *p) const {_mm256_storeu_ps(p, this->v);};
+
+    friend inline FloatBatch operator+(FloatBatch a, FloatBatch b) {return {_mm256_add_ps(a.v, b.v)};};
+    friend inline FloatBatch operator-(FloatBatch a, FloatBatch b) {return {_mm256_sub_ps(a.v, b.v)};};
+    friend inline FloatBatch operator*(FloatBatch a, FloatBatch b) {return {_mm256_mul_ps(a.v, b.v)};};
+    friend inline FloatBatch operator/(FloatBatch a, FloatBatch b) {return {_mm256_div_ps(a.v, b.v)};};
+#if defined(__FMA__)
+    friend inline FloatBatch multiplyAdd(FloatBatch a, FloatBatch b, FloatBatch c) {return {_mm256_fmadd_ps(a.v, b.v, c.v)};};
+#else
+    friend inline FloatBatch multiplyAdd(FloatBatch a, FloatBatch b, FloatBatch c) {return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)};};
+#endif
+    friend inline FloatBatch sqrt(FloatBatch a) {return {_mm256_sqrt_ps(a.v)};};
+    //lanes where a > b take value, the rest are zeroed
+    friend inline FloatBatch ifGreater(FloatBatch a, FloatBatch b, FloatBatch value) {return {_mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ), value.v)};};
+};
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+//NEON registers hold four floats, so a batch is a pair of them to keep eight particles per step
+struct FloatBatch {
+    static constexpr unsigned int width = 8;
+    float32x4_t lo, hi;
+
+    static inline FloatBatch load(const float *p) {return {vld1q_f32(p), vld1q_f32(p + 4)};};
+    static inline FloatBatch broadcast(float f) {return {vdupq_n_f32(f), vdupq_n_f32(f)};};
+    inline void store(float *p) const {vst1q_f32(p, this->lo); vst1q_f32(p + 4, this->hi);};
+
+    friend inline FloatBatch operator+(FloatBatch a, FloatBatch b) {return {vaddq_f32(a.lo, b.lo), vaddq_f32(a.hi, b.hi)};};
+    friend inline FloatBatch operator-(FloatBatch a, FloatBatch b) {return {vsubq_f32(a.lo, b.lo), vsubq_f32(a.hi, b.hi)};};
+    friend inline FloatBatch operator*(FloatBatch a, FloatBatch b) {return {vmulq_f32(a.lo, b.lo), vmulq_f32(a.hi, b.hi)};};
+    friend inline FloatBatch operator/(FloatBatch a, FloatBatch b) {return {vdivq_f32(a.lo, b.lo), vdivq_f32(a.hi, b.hi)};};
+    friend inline FloatBatch multiplyAdd(FloatBatch a, FloatBatch b, FloatBatch c) {return {vfmaq_f32(c.lo, a.lo, b.lo), vfmaq_f32(c.hi, a.hi, b.hi)};};
+    friend inline FloatBatch sqrt(FloatBatch a) {return {vsqrtq_f32(a.lo), vsqrtq_f32(a.hi)};};
+    //lanes where a > b take value, the rest are zeroed
+    friend inline FloatBatch ifGreater(FloatBatch a, FloatBatch b, FloatBatch value) {
+        return {
+            vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(a.lo, b.lo), vreinterpretq_u32_f32(value.lo))),
+            vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(a.hi, b.hi), vreinterpretq_u32_f32(value.hi)))
+        };
+    };
+};
+
+#else
+
+#include <cmath>
+
+//scalar fallback, written lane by lane so the compiler can still vectorize it for whatever unit it targets
+struct FloatBatch {
+    static constexpr unsigned int width = 8;
+    float v[width];
+
+    static inline FloatBatch load(const float *p) {FloatBatch r; for (unsigned int i = 0; i < width; i++) r.v[i] = p[i]; return r;};
+    static inline FloatBatch broadcast(float f) {FloatBatch r; for (unsigned int i = 0; i < width; i++) r.v[i] = f; return r;};
+    inline void store(float *p) const {for (unsigned int i = 0; i < width; i++) p[i] = this->v[i];};
+
+    friend inline FloatBatch operator+(FloatBatch a, FloatBatch b) {for (unsigned int i = 0; i < width; i++) a.v[i] += b.v[i]; return a;};
+    friend inline FloatBatch operator-(FloatBatch a, FloatBatch b) {for (unsigned int i = 0; i < width; i++) a.v[i] -= b.v[i]; return a;};
+    friend inline FloatBatch operator*(FloatBatch a, FloatBatch b) {for (unsigned int i = 0; i < width; i++) a.v[i] *= b.v[i]; return a;};
+    friend inline FloatBatch operator/(FloatBatch a, FloatBatch b) {for (unsigned int i = 0; i < width; i++) a.v[i] /= b.v[i]; return a;};
+    friend inline FloatBatch multiplyAdd(FloatBatch a, FloatBatch b, FloatBatch c) {for (unsigned int i = 0; i < width; i++) c.v[i] += a.v[i] * b.v[i]; return c;};
+    friend inline FloatBatch sqrt(FloatBatch a) {for (unsigned int i = 0; i < width; i++) a.v[i] = std::sqrt(a.v[i]); return a;};
+    //lanes where a > b take value, the rest are zeroed
+    friend inline FloatBatch ifGreater(FloatBatch a, FloatBatch b, FloatBatch value) {for (unsigned int i = 0; i < width; i++) value.v[i] = a.v[i] > b.v[i] ? value.v[i] : 0; return value;};
+};
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+#include "simulation/BlockSparseMatrix.hpp"
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothModel.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+#include "simulation/WindField.hpp"
+
+//backward Euler step of the spring-damper-drag model in Simulation.metal over the springs of a ClothTopology, solved
+//with block-Jacobi preconditioned conjugate gradient; springs and dampers are linearised around the current state,
+//drag and gravity stay explicit
+class ImplicitSolver {
+    public:
+        //the topology must outlive the solver
+        ImplicitSolver(const ClothParameters &params, const ClothTopology &topology);
+
+        //returns the number of conjugate gradient iterations the step took
+        //particles on hard attachments are given the velocity that lands them on their targets and held there as
+        //fixed values of the system; soft attachments pull their particles once the step has moved them
+        unsigned int step(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt, bool enableWind, const WindField *pWindField);
+        void setTolerance(float tolerance);
+        void setMaxIterations(unsigned int maxIterations);
+    private:
+        ClothParameters _parameters;
+        const ClothTopology *_pTopology;
+        float _tolerance = 1e-4f;
+        unsigned int _maxIterations = 200;
+        BlockSparseMatrix _matrix;
+        std::vector<float> _restLengths;
+        std::vector<Block3> _preconditioner;
+        std::vector<simd::float3> _rhs, _dv, _residual, _preconditioned, _direction, _product;
+        std::vector<float> _partialSums[2];
+
+        void assemble(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt);
+        unsigned int solve(ThreadPool *pThreadPool);
+};
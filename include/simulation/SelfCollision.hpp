@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "ThreadPool.hpp"
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothModel.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+
+//cloth-cloth contact for the CPU backend
+//triangles are entered into every cell of a uniform spatial hash that their bounding box, grown by the thickness,
+//overlaps; the hash is rebuilt every substep with a parallel counting sort, and each particle only looks through its
+//own cell for triangles outside its 1-ring that are closer than the thickness, then is pushed back to the side it
+//came from
+class SelfCollision {
+    public:
+        //the topology must outlive the collision
+        SelfCollision(const ClothParameters &params, const ClothTopology &topology);
+
+        //dt is the substep that was just taken, which tells which side of a triangle a particle came from; particles on
+        //hard attachments stay where their handle put them
+        void apply(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt);
+        void setThickness(float thickness);
+    private:
+        ClothParameters _parameters;
+        SelfCollisionParameters _hash;
+        const ClothTopology *_pTopology;
+        uint32_t _triangleCount;
+        std::vector<std::atomic<uint32_t>> _counts;
+        std::vector<uint32_t> _bucketStarts, _blockSums, _entries;
+        std::vector<simd::float3> _lowerBounds, _upperBounds, _normals;
+        std::vector<float> _areas;
+        std::vector<simd::float3> _positionCorrections, _velocityCorrections;
+
+        void build(ThreadPool *pThreadPool, const ClothState &state);
+        void respond(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt);
+};
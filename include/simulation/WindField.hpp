@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SharedTypes.h"
+
+//turbulent wind made of a mean wind plus the curl of a periodic noise potential, which has no divergence, so gusts
+//swirl past the cloth instead of piling up against it
+//the field is stored as keyframe volumes of resolution^3 samples that tile space every tileSize, independent of any
+//cloth's resolution; sample blends the trilinear samples of two keyframes over each period while a background thread
+//builds the next keyframe a slice at a time
+//advance, sample and the accessors belong to the simulating thread and may be called from its thread pool between
+//advances; only the build runs beside them
+class WindField {
+    public:
+        WindField(uint32_t resolution, float tileSize, simd::float3 meanWind, float turbulence, float period);
+        ~WindField();
+
+        //moves the blend on by dt; at the end of a period the keyframes rotate, first waiting for the build of the next
+        //to finish if it has not, so the wind only depends on the dts
+        void advance(float dt);
+        simd::float3 sample(simd::float3 position) const;
+        WindParameters getParameters() const;
+        uint32_t getResolution() const;
+        //changes every time the keyframes rotate, so copies of the volumes know when to upload again
+        uint64_t getGeneration() const;
+        //keyframe 0 is blended from and 1 towards, resolution^3 samples with x fastest
+        const simd::float4* getVolume(uint32_t keyframe) const;
+    private:
+        uint32_t _resolution;
+        float _tileSize;
+        simd::float3 _meanWind;
+        float _turbulence, _period;
+        float _time = 0;
+        uint64_t _generation = 0;
+        //the keyframe blended from, the one blended towards and the one being built, as rotated by _current; w is
+        //padding so the samples copy straight into RGBA textures
+        std::vector<simd::float4> _volumes[3];
+        //largest distance of any sample from the mean wind, per volume
+        float _gustSpeeds[3] = {};
+        uint32_t _current = 0;
+        uint32_t _nextKeyframe = 2;
+        std::vector<simd::float3> _potential;
+        std::thread _builder;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _building = true;
+        std::atomic<bool> _stopping{false};
+
+        bool buildKeyframe(uint32_t keyframe, uint32_t volume);
+        void build();
+};
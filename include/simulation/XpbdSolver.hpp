@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+#include "simulation/ClothAttachments.hpp"
+#include "simulation/ClothConstraints.hpp"
+#include "simulation/ClothModel.hpp"
+#include "simulation/ClothState.hpp"
+#include "simulation/ClothTopology.hpp"
+#include "simulation/WindField.hpp"
+
+//small-step XPBD: every substep predicts positions from gravity and drag, projects each distance constraint once,
+//then derives velocities from the displacement; the spring constant only sets the compliance, so the work per
+//frame does not grow with stiffness
+//constraints are projected one color at a time, and a color never touches a particle twice, so a batch runs in
+//parallel without write conflicts and gives the same result for any thread count
+class XpbdSolver {
+    public:
+        //projects the topology's springs; the topology must outlive the solver
+        XpbdSolver(const ClothParameters &params, const ClothTopology &topology);
+
+        //fraction is how far through the frame the substep ends, which is where the attachments pull their particles
+        //before the constraints are projected; hard attachments give their particles infinite mass
+        void step(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt, float fraction, bool enableWind, const WindField *pWindField);
+        uint32_t getColorCount();
+    private:
+        ClothParameters _parameters;
+        const ClothTopology *_pTopology;
+        std::vector<DistanceConstraint> _constraints;
+        std::vector<uint32_t> _colorStarts;
+        std::vector<float> _previousX, _previousY, _previousZ;
+};
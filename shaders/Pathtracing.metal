@@ -99,6 +99,12 @@ float2 samplePrevUv(PrimitiveData data, float2 uv) {
     return (1 - barycentricCoords.x - barycentricCoords.y) * data.v0PrevUV + barycentricCoords.x * data.v1PrevUV + barycentricCoords.y * data.v2PrevUV;
 }
 
+//where a point of a static instance, which stays put, was on screen in the frame pvMat was taken for
+float2 worldToUv(float4x4 pvMat, float3 position) {
+    float4 clipCoord = pvMat * float4(position, 1);
+    return (clipCoord.xy / -clipCoord.w + 1) / 2;
+}
+
 raytracing::ray generatePrimaryRay(float4x4 pvMatInv, float3 origin, float2 uv) {
     float2 normalizedCoords = 2 * uv - 1;
     float3 direction = normalize((pvMatInv * float4(normalizedCoords, 1, -1)).xyz);
@@ -108,11 +114,12 @@ raytracing::ray generatePrimaryRay(float4x4 pvMatInv, float3 origin, float2 uv)
 kernel void sampleSceneKernel(
     uint2 position                                                      [[thread_position_in_grid]],
     constant uint32_t &rand                                             [[buffer(0)]],
-    raytracing::primitive_acceleration_structure accelerationStructure  [[buffer(1)]],
-    constant uint16_t *geometryMaterials                                [[buffer(2)]],
+    raytracing::instance_acceleration_structure accelerationStructure   [[buffer(1)]],
+    constant InstanceData *instances                                    [[buffer(2)]],
     constant Material *materials                                        [[buffer(3)]],
     constant float3 &origin                                             [[buffer(4)]],
     constant float4x4 &pvMatInv                                         [[buffer(5)]],
+    constant float4x4 &prevPvMat                                        [[buffer(6)]],
     texture2d<float, access::write> depthNormal                         [[texture(0)]],
     texture2d<float, access::read_write> motion                         [[texture(1)]],
     texture2d<float, access::read_write> output                         [[texture(2)]],
@@ -120,8 +127,8 @@ kernel void sampleSceneKernel(
 ) {
     if (position.x >= width || position.y >= height) return;
 
-    raytracing::intersector<raytracing::triangle_data> primitiveIntersector;
-    raytracing::intersection_result<raytracing::triangle_data> intersection;
+    raytracing::intersector<raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data> primitiveIntersector;
+    raytracing::intersection_result<raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data> intersection;
     float3 accumulatedColor = float3();
 
     for (uint i = 0; i < spp; i++) {
@@ -134,11 +141,16 @@ kernel void sampleSceneKernel(
             intersection = primitiveIntersector.intersect(ray, accelerationStructure);
 
             bool hit = intersection.type != raytracing::intersection_type::none;
-            constant Material &mat = materials[geometryMaterials[intersection.geometry_id]];
+            constant InstanceData &instance = instances[intersection.instance_id];
+            constant Material &mat = materials[instance.material];
             PrimitiveData data = *(const device PrimitiveData*)intersection.primitive_data;
             float3 barycentricCoords = float3(1 - intersection.triangle_barycentric_coord.x - intersection.triangle_barycentric_coord.y, intersection.triangle_barycentric_coord);
-            float2 dUv = uv - samplePrevUv(data, uv);
-            float3 surfaceNormal = normalize(barycentricCoords.x * data.v0Normal + barycentricCoords.y * data.v1Normal + barycentricCoords.z * data.v2Normal);
+            float3 hitPosition = ray.origin + intersection.distance * ray.direction;
+            float2 dUv = uv - (instance.dynamic ? samplePrevUv(data, uv) : worldToUv(prevPvMat, hitPosition));
+            //the object's normals, taken to world space by the transpose of the instance's inverse transform
+            float4x3 worldToObject = intersection.world_to_object_transform;
+            float3 objectNormal = barycentricCoords.x * data.v0Normal + barycentricCoords.y * data.v1Normal + barycentricCoords.z * data.v2Normal;
+            float3 surfaceNormal = normalize(objectNormal * float3x3(worldToObject[0], worldToObject[1], worldToObject[2]));
             surfaceNormal = faceforward(surfaceNormal, ray.direction, surfaceNormal);
 
             float4 ggxSample = importanceSampleGgxVndf(position, rand * (i + 1) * (j + 1), surfaceNormal, ray.direction, mat.roughness);
@@ -162,6 +174,32 @@ kernel void sampleSceneKernel(
     output.write(float4(acesTonemap(accumulatedColor), 1), position);
 }
 
+//float bits with the sign bit flipped, or all bits for negatives, so they order like the floats as unsigned integers
+uint getOrderedBits(float value) {
+    uint bits = as_type<uint>(value);
+    return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+}
+
+//min- and max-reduces an object's vertices into its bounds, lower xyz then upper xyz as getOrderedBits; integer
+//atomics give the same bounds whatever order the threads run in
+kernel void reduceVertexBoundsKernel(
+    uint vertex                             [[thread_position_in_grid]],
+    const device packed_float3 *vertices    [[buffer(0)]],
+    constant uint &vertexCount              [[buffer(1)]],
+    device atomic_uint *bounds              [[buffer(2)]]
+) {
+    bool inside = vertex < vertexCount;
+    float3 position = inside ? float3(vertices[vertex]) : float3(0);
+    float3 lower = simd_min(inside ? position : float3(INFINITY));
+    float3 upper = simd_max(inside ? position : float3(-INFINITY));
+    if (simd_is_first()) {
+        for (int axis = 0; axis < 3; axis++) {
+            atomic_fetch_min_explicit(&bounds[axis], getOrderedBits(lower[axis]), memory_order_relaxed);
+            atomic_fetch_max_explicit(&bounds[3 + axis], getOrderedBits(upper[axis]), memory_order_relaxed);
+        }
+    }
+}
+
 vertex VertexShaderOut vertexMain(
     unsigned short vertexId [[vertex_id]]
 ) {
@@ -1,8 +1,16 @@
 #pragma once
 
+//Metal and Apple hosts get <simd/simd.h>, every other host the same types from PortableSimd.hpp
+#ifdef __METAL_VERSION__
 #include <simd/simd.h>
+#else
+#include "PortableSimd.hpp"
+#endif
 
 #define EPSILON 0.0001f
+//fraction of the explicit stability bound a substep may use, and the largest strain a side spring may gain per substep
+#define SUBSTEP_SAFETY 0.9f
+#define STRAIN_CFL 0.05f
 
 enum RayState {
     RAY_DEAD,
@@ -20,11 +28,60 @@ typedef struct Material {
 } Material;
 
 typedef struct Particle {
-    bool alive;
     simd::float3 normal, position, velocity, acceleration;
 } Particle;
 
+//stiffness of an attachment that holds its particle exactly on the target; the largest float rather than infinity, so
+//the correction stays exact under fast math
+#define ATTACHMENT_HARD FLT_MAX
+
+//ties a particle to the point localPosition of a handle, a transform the host moves between frames; stiffness is that of
+//a zero-length spring in N/m, or ATTACHMENT_HARD
+typedef struct Attachment {
+    simd::float3 localPosition;
+    uint32_t particle, handle;
+    float stiffness;
+} Attachment;
+
+//how many attachments an attachment pass covers, and how far through the frame its substep ends
+typedef struct AttachmentStep {
+    uint32_t attachmentCount;
+    float fraction;
+} AttachmentStep;
+
+//constants baked into simulateClothKernel through function constants 0-5
+typedef struct ClothParameters {
+    uint32_t particleCount;
+    float particleMass, springConstant, dampingConstant, sideSpringLength, diagonalSpringLength;
+} ClothParameters;
+
+//one cloth of a ClothBatch: where its particles and triangles start in the shared arenas, and its own constants
+typedef struct ClothInstance {
+    uint32_t particleOffset, triangleOffset;
+    ClothParameters parameters;
+} ClothInstance;
+
+//how the drag kernels read a WindField's two keyframe volumes, bound as 3D textures 0 and 1 that tile space every
+//1 / inverseTileSize; meanWind and gustSpeed bound the wind anywhere in the field for the substep limit
+typedef struct WindParameters {
+    simd::float3 meanWind;
+    float blend, inverseTileSize, gustSpeed;
+} WindParameters;
+
+typedef struct DistanceConstraint {
+    uint32_t particleA, particleB;
+    float restLength;
+} DistanceConstraint;
+
 typedef struct PrimitiveData {
     simd::float2 v0PrevUV, v1PrevUV, v2PrevUV, v0CurrUV, v1CurrUV, v2CurrUV;
     simd::float3 v0Normal, v1Normal, v2Normal;
-} PrimitiveData;
\ No newline at end of file
+} PrimitiveData;
+
+//what sampleSceneKernel reads of an instance by its instance id, its transform being in the acceleration structure;
+//a dynamic instance's motion comes from its object's PrimitiveData, which every instance of a static object shares, so
+//those are reprojected from the hit point with the last frame's matrix instead
+typedef struct InstanceData {
+    uint16_t material;
+    bool dynamic;
+} InstanceData;
\ No newline at end of file
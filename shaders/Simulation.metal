@@ -4,6 +4,10 @@
 
 using namespace metal;
 
+//the scene's instance structure over every object's own primitive structure, see SceneAccelerationStructure
+typedef raytracing::instance_acceleration_structure SceneAccelerationStructure;
+typedef raytracing::intersection_function_table<raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data> SceneIntersectionFunctionTable;
+
 constant uint32_t particleCount [[function_constant(0)]];
 constant float particleMass [[function_constant(1)]];
 constant float springConstant [[function_constant(2)]];
@@ -11,94 +15,127 @@ constant float dampingConstant [[function_constant(3)]];
 constant float sideSpringLength [[function_constant(4)]];
 constant float diagonalSpringLength [[function_constant(5)]];
 
-void applyGravity(device Particle &particle) {
-    particle.acceleration += float3(0, -1, 0);
+ClothParameters getClothParameters() {
+    return ClothParameters{particleCount, particleMass, springConstant, dampingConstant, sideSpringLength, diagonalSpringLength};
+}
+
+void applyGravity(thread float3 &acceleration) {
+    acceleration += float3(0, -1, 0);
 }
 
-void applySpring(device Particle &particleA, float3 direction, float distance, float springLength) {
-    float3 da = -springConstant * (springLength - distance) * direction / particleMass;
-    particleA.acceleration += da / 2;
+void applySpring(ClothParameters cloth, thread float3 &acceleration, float3 direction, float distance, float springLength) {
+    float3 da = -cloth.springConstant * (springLength - distance) * direction / cloth.particleMass;
+    acceleration += da / 2;
 }
 
-void applyDamper(device Particle &particleA, float3 direction, float3 closingVelocity) {
-    float3 da = -dampingConstant * dot(closingVelocity, direction) * direction / particleMass;
-    particleA.acceleration += da / 2;
+void applyDamper(ClothParameters cloth, thread float3 &acceleration, float3 direction, float3 closingVelocity) {
+    float3 da = -cloth.dampingConstant * dot(closingVelocity, direction) * direction / cloth.particleMass;
+    acceleration += da / 2;
 }
 
-void applySpringDamper(device Particle &particleA, device Particle &particleB, float springLength) {
+void applySpringDamper(ClothParameters cloth, thread float3 &acceleration, const device Particle &particleA, const device Particle &particleB, float springLength) {
     float3 displacement = particleB.position - particleA.position;
     float distance = length(displacement);
     float3 direction = normalize(displacement);
     direction = all(isfinite(direction)) ? direction : float3();
     float3 closingVelocity = particleA.velocity - particleB.velocity;
-    applySpring(particleA, direction, distance, springLength);
-    applyDamper(particleA, direction, closingVelocity);
+    applySpring(cloth, acceleration, direction, distance, springLength);
+    applyDamper(cloth, acceleration, direction, closingVelocity);
 }
 
-void applyClothSpringDampers(uint2 position, device Particle *particles, uint index, uint distance) {
-    device Particle &particle = particles[index];
-    if (position.x >= distance) applySpringDamper(particle, particles[index - distance], distance * sideSpringLength);
-    if (position.y >= distance) applySpringDamper(particle, particles[index - distance * particleCount], distance * sideSpringLength);
-    if (position.x < particleCount - distance) applySpringDamper(particle, particles[index + distance], distance * sideSpringLength);
-    if (position.y < particleCount - distance) applySpringDamper(particle, particles[index + distance * particleCount], distance * sideSpringLength);
-    if (position.x >= distance && position.y >= distance) applySpringDamper(particle, particles[index - distance * particleCount - distance], distance * diagonalSpringLength);
-    if (position.x >= distance && position.y < particleCount - distance) applySpringDamper(particle, particles[index + distance * particleCount - distance], distance * diagonalSpringLength);
-    if (position.x < particleCount - distance && position.y >= distance) applySpringDamper(particle, particles[index - distance * particleCount + distance], distance * diagonalSpringLength);
-    if (position.x < particleCount - distance && position.y < particleCount - distance) applySpringDamper(particle, particles[index + distance * particleCount + distance], distance * diagonalSpringLength);
+void applyClothSpringDampers(ClothParameters cloth, thread float3 &acceleration, uint2 position, const device Particle *particles, uint index, uint distance) {
+    const device Particle &particle = particles[index];
+    if (position.x >= distance) applySpringDamper(cloth, acceleration, particle, particles[index - distance], distance * cloth.sideSpringLength);
+    if (position.y >= distance) applySpringDamper(cloth, acceleration, particle, particles[index - distance * cloth.particleCount], distance * cloth.sideSpringLength);
+    if (position.x < cloth.particleCount - distance) applySpringDamper(cloth, acceleration, particle, particles[index + distance], distance * cloth.sideSpringLength);
+    if (position.y < cloth.particleCount - distance) applySpringDamper(cloth, acceleration, particle, particles[index + distance * cloth.particleCount], distance * cloth.sideSpringLength);
+    if (position.x >= distance && position.y >= distance) applySpringDamper(cloth, acceleration, particle, particles[index - distance * cloth.particleCount - distance], distance * cloth.diagonalSpringLength);
+    if (position.x >= distance && position.y < cloth.particleCount - distance) applySpringDamper(cloth, acceleration, particle, particles[index + distance * cloth.particleCount - distance], distance * cloth.diagonalSpringLength);
+    if (position.x < cloth.particleCount - distance && position.y >= distance) applySpringDamper(cloth, acceleration, particle, particles[index - distance * cloth.particleCount + distance], distance * cloth.diagonalSpringLength);
+    if (position.x < cloth.particleCount - distance && position.y < cloth.particleCount - distance) applySpringDamper(cloth, acceleration, particle, particles[index + distance * cloth.particleCount + distance], distance * cloth.diagonalSpringLength);
 }
 
-void applyDrag(device Particle &particleA, device Particle &particleB, device Particle &particleC, bool enableWind) {
-    float3 surfaceVelocity = (particleA.velocity + particleB.velocity + particleC.velocity) / 3;
-    float3 longNormal = cross(particleB.position - particleA.position, particleC.position - particleA.position);
+//the wind field at position, blended between the keyframe textures the host bound; the volume repeats every tile
+float3 getWind(bool enableWind, constant WindParameters &wind, texture3d<float, access::sample> windFrom, texture3d<float, access::sample> windTo, float3 position) {
+    if (!enableWind) return 0;
+    constexpr sampler sam(coord::normalized, address::repeat, filter::linear);
+    float3 coordinate = position * wind.inverseTileSize;
+    return mix(windFrom.sample(sam, coordinate).xyz, windTo.sample(sam, coordinate).xyz, wind.blend);
+}
+
+//bounds the speed of the air relative to a particle moving at velocity anywhere in the field
+float getRelativeWindSpeed(bool enableWind, constant WindParameters &wind, float3 velocity) {
+    return enableWind ? length(velocity - wind.meanWind) + wind.gustSpeed : length(velocity);
+}
+
+//aerodynamic force on one triangle moving at surfaceVelocity through air blowing at wind
+float3 getTriangleDrag(float3 positionA, float3 positionB, float3 positionC, float3 surfaceVelocity, float3 wind) {
+    float3 longNormal = cross(positionB - positionA, positionC - positionA);
     float3 normal = normalize(longNormal);
-    float3 dv = surfaceVelocity - (enableWind ? float3(0, 0, 2) : float3());
-    if (length(dv) < EPSILON) return;
+    float3 dv = surfaceVelocity - wind;
+    if (length(dv) < EPSILON) return 0;
     float crossArea = length(longNormal) / 2 * dot(normalize(dv), normal);
-    float3 da = -1.225 * length_squared(dv) * 1.28 * crossArea * normal / 2 / particleMass;
-    particleA.acceleration += da / 2;
+    return -1.225 * length_squared(dv) * 1.28 * crossArea * normal / 2;
 }
 
-void applyClothDrag(uint2 position, device Particle *particles, bool enableWind) {
-    uint index = position.y * particleCount + position.x;
-    device Particle &particle = particles[index];
+//every corner takes a third of the drag on each triangle around it, as computeClothTriangleDragKernel left it
+void applyClothDrag(ClothParameters cloth, thread float3 &acceleration, uint2 position, const device float3 *triangleDrag) {
+    uint triangleIndex = position.y * (cloth.particleCount - 1) + position.x;
+    float3 drag = 0;
     if (position.x > 0 && position.y > 0) {
-        applyDrag(particle, particles[index - 1], particles[index - particleCount], enableWind);
+        drag += triangleDrag[2 * (triangleIndex - (cloth.particleCount - 1) - 1) + 1];
     }
-    if (position.x < particleCount - 1 && position.y > 0) {
-        applyDrag(particle, particles[index - particleCount], particles[index - particleCount + 1], enableWind);
-        applyDrag(particle, particles[index - particleCount + 1], particles[index + 1], enableWind);
+    if (position.x < cloth.particleCount - 1 && position.y > 0) {
+        drag += triangleDrag[2 * (triangleIndex - (cloth.particleCount - 1))];
+        drag += triangleDrag[2 * (triangleIndex - (cloth.particleCount - 1)) + 1];
     }
-    if (position.x < particleCount - 1 && position.y < particleCount - 1) {
-        applyDrag(particle, particles[index + 1], particles[index + particleCount], enableWind);
+    if (position.x < cloth.particleCount - 1 && position.y < cloth.particleCount - 1) {
+        drag += triangleDrag[2 * triangleIndex];
     }
-    if (position.x > 0 && position.y < particleCount - 1) {
-        applyDrag(particle, particles[index + particleCount], particles[index + particleCount - 1], enableWind);
-        applyDrag(particle, particles[index + particleCount - 1], particles[index - 1], enableWind);
+    if (position.x > 0 && position.y < cloth.particleCount - 1) {
+        drag += triangleDrag[2 * (triangleIndex - 1) + 1];
+        drag += triangleDrag[2 * (triangleIndex - 1)];
     }
+    acceleration += drag / 3 / cloth.particleMass;
 }
 
-void simulateMotion(device Particle &particle, float dt, float3 moveDirection) {
-    if (particle.alive) {
-        particle.velocity += dt * particle.acceleration;
-        particle.position += dt * particle.velocity;
-    }
-    else {
-        particle.position += moveDirection * dt;
-    }
-    particle.acceleration = 0;
+void simulateMotion(device Particle &particle, float3 acceleration, float dt) {
+    particle.velocity += dt * acceleration;
+    particle.position += dt * particle.velocity;
+}
+
+//the correction that pulls an attached particle toward its handle's transform of localPosition, blended a fraction of
+//the way through the frame; the attachment acts as an implicit zero-length spring, so the share of the gap closed in a
+//substep tends to 1 as the stiffness grows and is exactly 1 for ATTACHMENT_HARD, with no branch on which it is
+float3 getAttachmentCorrection(Attachment attachment, const device float4x4 *handles, float3 position, float mass, float dt, float fraction) {
+    float4 localPosition = float4(attachment.localPosition, 1);
+    float3 start = (handles[2 * attachment.handle] * localPosition).xyz;
+    float3 end = (handles[2 * attachment.handle + 1] * localPosition).xyz;
+    float share = 1 / (1 + mass / (attachment.stiffness * dt * dt));
+    return share * (mix(start, end, fraction) - position);
 }
 
-void constrainCollision(device Particle &particle, raytracing::primitive_acceleration_structure accelerationStructure, raytracing::intersection_function_table<raytracing::triangle_data> intersectionFunctionTable, float3 previousPosition) {
+//what a particle's collision ray carries into intersectIgnoreClothTriangles: where the particle was, and the scene
+//instance of the cloth it belongs to, whose triangles there are the particle's own
+struct ClothRayPayload {
+    float3 position;
+    uint instanceId;
+};
+
+void constrainCollision(device Particle &particle, SceneAccelerationStructure accelerationStructure, SceneIntersectionFunctionTable intersectionFunctionTable, uint sceneInstanceId, float3 previousPosition) {
     float3 displacement = particle.position - previousPosition;
     float3 direction = normalize(displacement);
     raytracing::ray ray{previousPosition - EPSILON * direction, direction, 0, length(displacement) + EPSILON};
-    raytracing::intersector<raytracing::triangle_data> intersector;
-    raytracing::intersection_result<raytracing::triangle_data> intersection = intersector.intersect(ray, accelerationStructure, intersectionFunctionTable, previousPosition);
+    ClothRayPayload payload{previousPosition, sceneInstanceId};
+    raytracing::intersector<raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data> intersector;
+    raytracing::intersection_result<raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data> intersection = intersector.intersect(ray, accelerationStructure, intersectionFunctionTable, payload);
     
     if (intersection.type != raytracing::intersection_type::none) {
         PrimitiveData data = *(const device PrimitiveData*)intersection.primitive_data;
         float2 bCoords = intersection.triangle_barycentric_coord;
-        float3 surfaceNormal = normalize(bCoords.x * data.v0Normal + bCoords.y * data.v1Normal + (1 - bCoords.x - bCoords.y) * data.v2Normal);
+        float4x3 worldToObject = intersection.world_to_object_transform;
+        float3 objectNormal = bCoords.x * data.v0Normal + bCoords.y * data.v1Normal + (1 - bCoords.x - bCoords.y) * data.v2Normal;
+        float3 surfaceNormal = normalize(objectNormal * float3x3(worldToObject[0], worldToObject[1], worldToObject[2]));
         surfaceNormal = intersection.triangle_front_facing ? surfaceNormal : -surfaceNormal;
 
         particle.velocity += dot(surfaceNormal, -particle.velocity) * surfaceNormal;
@@ -106,56 +143,84 @@ void constrainCollision(device Particle &particle, raytracing::primitive_acceler
     }
 }
 
-float3 getTriangleNormal(device Particle &particleA, device Particle &particleB, device Particle &particleC) {
+float3 getTriangleNormal(const device Particle &particleA, const device Particle &particleB, const device Particle &particleC) {
     return normalize(cross(particleB.position - particleA.position, particleC.position - particleA.position));
 }
 
-void recalculateClothNormals(uint2 position, device Particle *particles, device PrimitiveData *primitiveData) {
-    uint index = position.y * particleCount + position.x;
-    uint triangleIndex = position.y * (particleCount - 1) + position.x;
-    device Particle &particle = particles[index];
+float3 getTriangleNormal(const device packed_float3 &vertexA, const device packed_float3 &vertexB, const device packed_float3 &vertexC) {
+    return normalize(cross(float3(vertexB) - float3(vertexA), float3(vertexC) - float3(vertexA)));
+}
+
+//Point is Particle while simulating, or packed_float3 when only the vertices are known, as in bake playback
+template <typename Point>
+void recalculateClothNormals(ClothParameters cloth, uint2 position, const device Point *particles, device PrimitiveData *primitiveData) {
+    uint index = position.y * cloth.particleCount + position.x;
+    uint triangleIndex = position.y * (cloth.particleCount - 1) + position.x;
+    const device Point &particle = particles[index];
     float3 averageNormal = float3();
     if (position.x > 0 && position.y > 0) {
-        averageNormal += getTriangleNormal(particle, particles[index - 1], particles[index - particleCount]);
+        averageNormal += getTriangleNormal(particle, particles[index - 1], particles[index - cloth.particleCount]);
     }
-    if (position.x < particleCount - 1 && position.y > 0) {
-        averageNormal += getTriangleNormal(particle, particles[index - particleCount], particles[index - particleCount + 1]);
-        averageNormal += getTriangleNormal(particle, particles[index - particleCount + 1], particles[index + 1]);
+    if (position.x < cloth.particleCount - 1 && position.y > 0) {
+        averageNormal += getTriangleNormal(particle, particles[index - cloth.particleCount], particles[index - cloth.particleCount + 1]);
+        averageNormal += getTriangleNormal(particle, particles[index - cloth.particleCount + 1], particles[index + 1]);
     }
-    if (position.x < particleCount - 1 && position.y < particleCount - 1) {
-        averageNormal += getTriangleNormal(particle, particles[index + 1], particles[index + particleCount]);
+    if (position.x < cloth.particleCount - 1 && position.y < cloth.particleCount - 1) {
+        averageNormal += getTriangleNormal(particle, particles[index + 1], particles[index + cloth.particleCount]);
     }
-    if (position.x > 0 && position.y < particleCount - 1) {
-        averageNormal += getTriangleNormal(particle, particles[index + particleCount], particles[index + particleCount - 1]);
-        averageNormal += getTriangleNormal(particle, particles[index + particleCount - 1], particles[index - 1]);
+    if (position.x > 0 && position.y < cloth.particleCount - 1) {
+        averageNormal += getTriangleNormal(particle, particles[index + cloth.particleCount], particles[index + cloth.particleCount - 1]);
+        averageNormal += getTriangleNormal(particle, particles[index + cloth.particleCount - 1], particles[index - 1]);
     }
     
     averageNormal = normalize(averageNormal);
     if (position.x > 0 && position.y > 0) {
-        primitiveData[2 * (triangleIndex - (particleCount - 1) - 1) + 1].v1Normal = averageNormal;
+        primitiveData[2 * (triangleIndex - (cloth.particleCount - 1) - 1) + 1].v1Normal = averageNormal;
     }
-    if (position.x < particleCount - 1 && position.y > 0) {
-        primitiveData[2 * (triangleIndex - (particleCount - 1))].v2Normal = averageNormal;
-        primitiveData[2 * (triangleIndex - (particleCount - 1)) + 1].v2Normal = averageNormal;
+    if (position.x < cloth.particleCount - 1 && position.y > 0) {
+        primitiveData[2 * (triangleIndex - (cloth.particleCount - 1))].v2Normal = averageNormal;
+        primitiveData[2 * (triangleIndex - (cloth.particleCount - 1)) + 1].v2Normal = averageNormal;
     }
-    if (position.x < particleCount - 1 && position.y < particleCount - 1) {
+    if (position.x < cloth.particleCount - 1 && position.y < cloth.particleCount - 1) {
         primitiveData[2 * triangleIndex + 0].v0Normal = averageNormal;
     }
-    if (position.x > 0 && position.y < particleCount - 1) {
+    if (position.x > 0 && position.y < cloth.particleCount - 1) {
         primitiveData[2 * (triangleIndex - 1) + 1].v0Normal = averageNormal;
         primitiveData[2 * (triangleIndex - 1)].v1Normal = averageNormal;
     }
 }
 
-[[intersection(triangle, raytracing::triangle_data)]]
+//largest substep the explicit integrator can take from this particle's state: a Gershgorin bound on the spring,
+//damper and drag rates keeps it stable, and STRAIN_CFL limits how far any side spring may stretch per substep
+float getSubstepLimit(ClothParameters cloth, uint2 position, const device Particle *particles, bool enableWind, constant WindParameters &wind) {
+    uint index = position.y * cloth.particleCount + position.x;
+    //no particle has more than 16 springs, which bounds the spring and damper rates from above
+    float stiffnessRate = 16 * cloth.springConstant / cloth.particleMass;
+    //six triangles of area sideSpringLength^2 / 2 around the particle, a third of each one's drag
+    float dragScale = 1.225 * 1.28 * 6 * cloth.sideSpringLength * cloth.sideSpringLength / 2 / 3 / cloth.particleMass;
+    float3 velocity = particles[index].velocity;
+    float dampingRate = 16 * cloth.dampingConstant / cloth.particleMass + dragScale * getRelativeWindSpeed(enableWind, wind, velocity);
+    float stabilityLimit = (sqrt(dampingRate * dampingRate + 4 * stiffnessRate) - dampingRate) / stiffnessRate;
+
+    float strainRate = 0;
+    if (position.x > 0) strainRate = max(strainRate, length(velocity - particles[index - 1].velocity));
+    if (position.y > 0) strainRate = max(strainRate, length(velocity - particles[index - cloth.particleCount].velocity));
+    if (position.x < cloth.particleCount - 1) strainRate = max(strainRate, length(velocity - particles[index + 1].velocity));
+    if (position.y < cloth.particleCount - 1) strainRate = max(strainRate, length(velocity - particles[index + cloth.particleCount].velocity));
+    strainRate /= cloth.sideSpringLength;
+
+    return min(SUBSTEP_SAFETY * stabilityLimit, STRAIN_CFL / strainRate);
+}
+
+[[intersection(triangle, raytracing::triangle_data, raytracing::instancing, raytracing::world_space_data)]]
 bool intersectIgnoreClothTriangles(
-    uint geometryId             [[geometry_id]],
-    ray_data float3 &position   [[payload]],
-    float3 origin               [[origin]],
-    float3 direction            [[direction]],
-    float distance              [[distance]]
+    uint instanceId                     [[instance_id]],
+    ray_data ClothRayPayload &payload   [[payload]],
+    float3 origin                       [[origin]],
+    float3 direction                    [[direction]],
+    float distance                      [[distance]]
 ) {
-    return geometryId != 0 || length(origin + direction * distance - position) > EPSILON;
+    return instanceId != payload.instanceId || length(origin + direction * distance - payload.position) > EPSILON;
 }
 
 /*
@@ -166,31 +231,511 @@ bool intersectIgnoreClothTriangles(
 + - + - +
 */
 
+//first half of the drag: each triangle's force once, for the particles around it to gather in applyClothDrag
+//rather than every particle recomputing all six of its triangles; reads only the index buffer, so Cloth and
+//ClothBatch share it. the wind is sampled once per triangle at its centroid
+kernel void computeClothTriangleDragKernel(
+    uint triangle                                   [[thread_position_in_grid]],
+    const device Particle *particles                [[buffer(3)]],
+    constant bool &enableWind                       [[buffer(8)]],
+    const device uint *indices                      [[buffer(14)]],
+    device float3 *triangleDrag                     [[buffer(24)]],
+    constant uint &triangleCount                    [[buffer(25)]],
+    constant WindParameters &wind                   [[buffer(26)]],
+    texture3d<float, access::sample> windFrom       [[texture(0)]],
+    texture3d<float, access::sample> windTo         [[texture(1)]]
+) {
+    if (triangle >= triangleCount) return;
+    const device Particle &particleA = particles[indices[3 * triangle]];
+    const device Particle &particleB = particles[indices[3 * triangle + 1]];
+    const device Particle &particleC = particles[indices[3 * triangle + 2]];
+    float3 surfaceVelocity = (particleA.velocity + particleB.velocity + particleC.velocity) / 3;
+    float3 centroid = (particleA.position + particleB.position + particleC.position) / 3;
+    float3 windVelocity = getWind(enableWind, wind, windFrom, windTo, centroid);
+    triangleDrag[triangle] = getTriangleDrag(particleA.position, particleB.position, particleC.position, surfaceVelocity, windVelocity);
+}
+
 kernel void simulateClothKernel(
     uint2 position                                                                                  [[thread_position_in_grid]],
     constant float &dt                                                                              [[buffer(0)]],
-    raytracing::primitive_acceleration_structure accelerationStructure                              [[buffer(1)]],
-    raytracing::intersection_function_table<raytracing::triangle_data> intersectionFunctionTable    [[buffer(2)]],
+    SceneAccelerationStructure accelerationStructure                                                [[buffer(1)]],
+    SceneIntersectionFunctionTable intersectionFunctionTable                                        [[buffer(2)]],
     device Particle *particles                                                                      [[buffer(3)]],
     device PrimitiveData *primitiveData                                                             [[buffer(4)]],
     device packed_float3 *vertices                                                                  [[buffer(5)]],
     constant bool &finalIteration                                                                   [[buffer(6)]],
-    constant float3 &moveDirection                                                                  [[buffer(7)]],
-    constant bool &enableWind                                                                       [[buffer(8)]]
+    constant uint &sceneInstanceId                                                                  [[buffer(7)]],
+    const device float3 *triangleDrag                                                               [[buffer(24)]]
 ) {
     if (position.x >= particleCount || position.y >= particleCount) return;
     uint index = position.y * particleCount + position.x;
     device Particle &particle = particles[index];
+    float3 acceleration = 0;
 
-    applyGravity(particle);
-    applyClothSpringDampers(position, particles, index, 1);
-    applyClothSpringDampers(position, particles, index, 2);
-    applyClothDrag(position, particles, enableWind);
-    simulateMotion(particle, dt, moveDirection);
+    applyGravity(acceleration);
+    applyClothSpringDampers(getClothParameters(), acceleration, position, particles, index, 1);
+    applyClothSpringDampers(getClothParameters(), acceleration, position, particles, index, 2);
+    applyClothDrag(getClothParameters(), acceleration, position, triangleDrag);
+    simulateMotion(particle, acceleration, dt);
     if (finalIteration) {
-        constrainCollision(particle, accelerationStructure, intersectionFunctionTable, vertices[index]);
-        recalculateClothNormals(position, particles, primitiveData);
+        constrainCollision(particle, accelerationStructure, intersectionFunctionTable, sceneInstanceId, vertices[index]);
+        recalculateClothNormals(getClothParameters(), position, particles, primitiveData);
 
         vertices[index] = particle.position;
     }
-}
\ No newline at end of file
+}
+
+//Jacobi variant of simulateClothKernel: every thread reads the state left by the previous substep and writes its own
+//particle into a second buffer, so the result no longer depends on the order threads run in
+kernel void simulateClothDeterministicKernel(
+    uint2 position                                                                                  [[thread_position_in_grid]],
+    constant float &dt                                                                              [[buffer(0)]],
+    SceneAccelerationStructure accelerationStructure                                                [[buffer(1)]],
+    SceneIntersectionFunctionTable intersectionFunctionTable                                        [[buffer(2)]],
+    const device Particle *previousParticles                                                        [[buffer(3)]],
+    device packed_float3 *vertices                                                                  [[buffer(5)]],
+    constant bool &finalIteration                                                                   [[buffer(6)]],
+    constant uint &sceneInstanceId                                                                  [[buffer(7)]],
+    device Particle *nextParticles                                                                  [[buffer(9)]],
+    const device float3 *triangleDrag                                                               [[buffer(24)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    uint index = position.y * particleCount + position.x;
+    float3 acceleration = 0;
+
+    applyGravity(acceleration);
+    applyClothSpringDampers(getClothParameters(), acceleration, position, previousParticles, index, 1);
+    applyClothSpringDampers(getClothParameters(), acceleration, position, previousParticles, index, 2);
+    applyClothDrag(getClothParameters(), acceleration, position, triangleDrag);
+
+    device Particle &particle = nextParticles[index];
+    particle = previousParticles[index];
+    simulateMotion(particle, acceleration, dt);
+    if (finalIteration) {
+        constrainCollision(particle, accelerationStructure, intersectionFunctionTable, sceneInstanceId, vertices[index]);
+        vertices[index] = particle.position;
+    }
+}
+
+//normals read neighbouring particles, so the deterministic mode runs them once the final substep has finished
+kernel void recalculateClothNormalsKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    const device Particle *particles        [[buffer(3)]],
+    device PrimitiveData *primitiveData     [[buffer(4)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    recalculateClothNormals(getClothParameters(), position, particles, primitiveData);
+}
+
+//normals of a cloth played back from a bake, which only stores vertex positions
+kernel void recalculateBakedClothNormalsKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    device PrimitiveData *primitiveData     [[buffer(4)]],
+    const device packed_float3 *vertices    [[buffer(5)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    //the normals only need the grid size, so particleCount is the one constant playback sets
+    ClothParameters cloth = {};
+    cloth.particleCount = particleCount;
+    recalculateClothNormals(cloth, position, vertices, primitiveData);
+}
+
+//min-reduces getSubstepLimit over the cloth once the frame is done; Cloth::update reads it to size the next frame's
+//substeps. positive floats order the same as their bits, so the minimum can use an integer atomic
+kernel void reduceSubstepLimitKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    const device Particle *particles        [[buffer(3)]],
+    constant bool &enableWind               [[buffer(8)]],
+    device atomic_uint *substepLimit        [[buffer(13)]],
+    constant WindParameters &wind           [[buffer(26)]]
+) {
+    bool inside = position.x < particleCount && position.y < particleCount;
+    float limit = inside ? getSubstepLimit(getClothParameters(), position, particles, enableWind, wind) : INFINITY;
+    limit = simd_min(limit);
+    if (simd_is_first()) {
+        atomic_fetch_min_explicit(substepLimit, as_type<uint>(limit), memory_order_relaxed);
+    }
+}
+
+//XPBD mode: predict from gravity and drag, project one color of distance constraints per dispatch, then turn the
+//displacement into velocity; the spring constant only enters as a compliance, so the substep count stays fixed
+kernel void predictClothKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    constant float &dt                      [[buffer(0)]],
+    const device Particle *particles        [[buffer(3)]],
+    device float3 *predictedPositions       [[buffer(10)]],
+    const device float3 *triangleDrag       [[buffer(24)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    uint index = position.y * particleCount + position.x;
+    const device Particle &particle = particles[index];
+    float3 acceleration = 0;
+    applyGravity(acceleration);
+    applyClothDrag(getClothParameters(), acceleration, position, triangleDrag);
+    predictedPositions[index] = particle.position + dt * (particle.velocity + dt * acceleration);
+}
+
+//constraints of one color share no particle, so every thread owns both of its endpoints
+kernel void projectClothConstraintsKernel(
+    uint position                                   [[thread_position_in_grid]],
+    constant float &dt                              [[buffer(0)]],
+    const device Particle *particles                [[buffer(3)]],
+    device float3 *predictedPositions               [[buffer(10)]],
+    const device DistanceConstraint *constraints    [[buffer(11)]],
+    constant uint2 &colorRange                      [[buffer(12)]],
+    const device uchar *hardParticles               [[buffer(30)]]
+) {
+    if (position >= colorRange.y) return;
+    DistanceConstraint constraint = constraints[colorRange.x + position];
+    const device Particle &particleA = particles[constraint.particleA];
+    const device Particle &particleB = particles[constraint.particleB];
+    float3 positionA = predictedPositions[constraint.particleA];
+    float3 positionB = predictedPositions[constraint.particleB];
+    float3 displacement = positionA - positionB;
+    float distance = length(displacement);
+    float weightA = (1 - hardParticles[constraint.particleA]) / particleMass;
+    float weightB = (1 - hardParticles[constraint.particleB]) / particleMass;
+    if (!(distance > 0) || weightA + weightB == 0) return;
+    float3 direction = displacement / distance;
+
+    //applySpring and applyDamper give each end half the force, so a pair behaves like a spring of k / 2
+    float compliance = 2 / springConstant;
+    float gamma = compliance * dampingConstant / 2 / dt;
+    float3 relativeMotion = (positionA - particleA.position) - (positionB - particleB.position);
+    float lambda = (-(distance - constraint.restLength) - gamma * dot(direction, relativeMotion)) / ((1 + gamma) * (weightA + weightB) + compliance / (dt * dt));
+
+    predictedPositions[constraint.particleA] = positionA + weightA * lambda * direction;
+    predictedPositions[constraint.particleB] = positionB - weightB * lambda * direction;
+}
+
+kernel void updateClothXpbdKernel(
+    uint2 position                                                                                  [[thread_position_in_grid]],
+    constant float &dt                                                                              [[buffer(0)]],
+    SceneAccelerationStructure accelerationStructure                                                [[buffer(1)]],
+    SceneIntersectionFunctionTable intersectionFunctionTable                                        [[buffer(2)]],
+    device Particle *particles                                                                      [[buffer(3)]],
+    device packed_float3 *vertices                                                                  [[buffer(5)]],
+    constant bool &finalIteration                                                                   [[buffer(6)]],
+    constant uint &sceneInstanceId                                                                  [[buffer(7)]],
+    const device float3 *predictedPositions                                                         [[buffer(10)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    uint index = position.y * particleCount + position.x;
+    device Particle &particle = particles[index];
+    float3 predictedPosition = predictedPositions[index];
+    particle.velocity = (predictedPosition - particle.position) / dt;
+    particle.position = predictedPosition;
+    if (finalIteration) {
+        constrainCollision(particle, accelerationStructure, intersectionFunctionTable, sceneInstanceId, vertices[index]);
+        vertices[index] = particle.position;
+    }
+}
+
+//attachments: one thread per attachment after every substep, so only attached particles pay for them; a particle is in
+//at most one attachment, so no two threads write the same particle
+//the explicit modes correct the particles the substep just wrote and republish their vertices on the final iteration
+kernel void applyClothAttachmentsKernel(
+    uint position                           [[thread_position_in_grid]],
+    constant float &dt                      [[buffer(0)]],
+    device Particle *particles              [[buffer(3)]],
+    device packed_float3 *vertices          [[buffer(5)]],
+    constant bool &finalIteration           [[buffer(6)]],
+    const device Attachment *attachments    [[buffer(27)]],
+    constant AttachmentStep &step           [[buffer(28)]],
+    const device float4x4 *handles          [[buffer(29)]]
+) {
+    if (position >= step.attachmentCount) return;
+    Attachment attachment = attachments[position];
+    device Particle &particle = particles[attachment.particle];
+    float3 correction = getAttachmentCorrection(attachment, handles, particle.position, particleMass, dt, step.fraction);
+    particle.position += correction;
+    particle.velocity += correction / dt;
+    if (finalIteration) vertices[attachment.particle] = particle.position;
+}
+
+//XPBD corrects the predicted positions between prediction and projection, and the velocity update picks it up
+kernel void applyClothXpbdAttachmentsKernel(
+    uint position                           [[thread_position_in_grid]],
+    constant float &dt                      [[buffer(0)]],
+    device float3 *predictedPositions       [[buffer(10)]],
+    const device Attachment *attachments    [[buffer(27)]],
+    constant AttachmentStep &step           [[buffer(28)]],
+    const device float4x4 *handles          [[buffer(29)]]
+) {
+    if (position >= step.attachmentCount) return;
+    Attachment attachment = attachments[position];
+    float3 predictedPosition = predictedPositions[attachment.particle];
+    predictedPositions[attachment.particle] = predictedPosition + getAttachmentCorrection(attachment, handles, predictedPosition, particleMass, dt, step.fraction);
+}
+
+
+//self-collision: triangles go into every cell of a uniform spatial hash that their box, grown by the thickness,
+//overlaps; the buckets are laid out with a counting sort (count, scan, scatter) every substep, then each particle
+//checks the triangles in its own cell and is pushed back to the side of the plane it came from; the entry buffer's
+//capacity is an argument rather than a constant, since the host grows the buffer when a frame needs more
+constant uint selfCollisionTableSize [[function_constant(6)]];
+constant float selfCollisionThickness [[function_constant(8)]];
+constant float selfCollisionCellSize [[function_constant(9)]];
+
+int3 getSelfCollisionCell(float3 position) {
+    return int3(floor(position / selfCollisionCellSize));
+}
+
+uint hashSelfCollisionCell(int3 cell) {
+    return ((uint)cell.x * 73856093u ^ (uint)cell.y * 19349663u ^ (uint)cell.z * 83492791u) & (selfCollisionTableSize - 1);
+}
+
+kernel void countClothTrianglesKernel(
+    uint triangle                           [[thread_position_in_grid]],
+    const device Particle *particles        [[buffer(3)]],
+    const device uint *indices              [[buffer(14)]],
+    device float3 *triangleBounds           [[buffer(15)]],
+    device float4 *triangleNormals          [[buffer(16)]],
+    device atomic_uint *bucketCounts        [[buffer(17)]]
+) {
+    if (triangle >= 2 * (particleCount - 1) * (particleCount - 1)) return;
+    float3 a = particles[indices[3 * triangle]].position;
+    float3 b = particles[indices[3 * triangle + 1]].position;
+    float3 c = particles[indices[3 * triangle + 2]].position;
+    float3 lower = min(a, min(b, c)) - selfCollisionThickness, upper = max(a, max(b, c)) + selfCollisionThickness;
+    float3 normal = cross(b - a, c - a);
+    triangleBounds[2 * triangle] = lower;
+    triangleBounds[2 * triangle + 1] = upper;
+    triangleNormals[triangle] = float4(normalize(normal), length(normal));
+
+    int3 lowerCell = getSelfCollisionCell(lower), upperCell = getSelfCollisionCell(upper);
+    for (int z = lowerCell.z; z <= upperCell.z; z++) {
+        for (int y = lowerCell.y; y <= upperCell.y; y++) {
+            for (int x = lowerCell.x; x <= upperCell.x; x++) {
+                atomic_fetch_add_explicit(&bucketCounts[hashSelfCollisionCell(int3(x, y, z))], 1, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+//runs as a single threadgroup: every thread scans a contiguous run of buckets, then the run totals are scanned in
+//threadgroup memory; counts are cleared for the next substep and copied into the scatter cursors, and the largest
+//total of the frame is kept for the host to grow the entry buffer to
+kernel void scanClothBucketsKernel(
+    uint thread                             [[thread_position_in_threadgroup]],
+    uint threadCount                        [[threads_per_threadgroup]],
+    device atomic_uint *bucketCounts        [[buffer(17)]],
+    device uint *bucketStarts               [[buffer(18)]],
+    device uint *bucketCursors              [[buffer(20)]],
+    device uint &requiredEntries            [[buffer(23)]]
+) {
+    threadgroup uint runTotals[1024];
+    uint runLength = (selfCollisionTableSize + threadCount - 1) / threadCount;
+    uint first = min(selfCollisionTableSize, thread * runLength), last = min(selfCollisionTableSize, first + runLength);
+    uint total = 0;
+    for (uint bucket = first; bucket < last; bucket++) {
+        total += atomic_load_explicit(&bucketCounts[bucket], memory_order_relaxed);
+    }
+    runTotals[thread] = total;
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    for (uint offset = 1; offset < threadCount; offset *= 2) {
+        uint addend = thread >= offset ? runTotals[thread - offset] : 0;
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+        runTotals[thread] += addend;
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+
+    uint start = runTotals[thread] - total;
+    for (uint bucket = first; bucket < last; bucket++) {
+        bucketStarts[bucket] = start;
+        bucketCursors[bucket] = start;
+        start += atomic_exchange_explicit(&bucketCounts[bucket], 0, memory_order_relaxed);
+    }
+    if (thread == threadCount - 1) {
+        bucketStarts[selfCollisionTableSize] = runTotals[thread];
+        requiredEntries = max(requiredEntries, runTotals[thread]);
+    }
+}
+
+//entries past the capacity are dropped, and the buckets they belong to are searched in full by collideClothSelfKernel;
+//it only runs out when triangles stretch across several cells
+kernel void scatterClothTrianglesKernel(
+    uint triangle                           [[thread_position_in_grid]],
+    const device float3 *triangleBounds     [[buffer(15)]],
+    device uint *bucketEntries              [[buffer(19)]],
+    device atomic_uint *bucketCursors       [[buffer(20)]],
+    constant uint &entryCapacity            [[buffer(22)]]
+) {
+    if (triangle >= 2 * (particleCount - 1) * (particleCount - 1)) return;
+    int3 lowerCell = getSelfCollisionCell(triangleBounds[2 * triangle]), upperCell = getSelfCollisionCell(triangleBounds[2 * triangle + 1]);
+    for (int z = lowerCell.z; z <= upperCell.z; z++) {
+        for (int y = lowerCell.y; y <= upperCell.y; y++) {
+            for (int x = lowerCell.x; x <= upperCell.x; x++) {
+                uint entry = atomic_fetch_add_explicit(&bucketCursors[hashSelfCollisionCell(int3(x, y, z))], 1, memory_order_relaxed);
+                if (entry < entryCapacity) bucketEntries[entry] = triangle;
+            }
+        }
+    }
+}
+
+//corrections are gathered against the state the hash was built from and applied by a second kernel; the deepest
+//contact wins with ties going to the lower triangle, so the order entries landed in does not matter
+kernel void collideClothSelfKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    constant float &dt                      [[buffer(0)]],
+    const device Particle *particles        [[buffer(3)]],
+    const device uint *indices              [[buffer(14)]],
+    const device float3 *triangleBounds     [[buffer(15)]],
+    const device float4 *triangleNormals    [[buffer(16)]],
+    const device uint *bucketStarts         [[buffer(18)]],
+    const device uint *bucketEntries        [[buffer(19)]],
+    device float3 *corrections              [[buffer(21)]],
+    constant uint &entryCapacity            [[buffer(22)]],
+    const device uchar *hardParticles       [[buffer(30)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    uint index = position.y * particleCount + position.x;
+    const device Particle &particle = particles[index];
+    float3 positionCorrection = float3(), velocityCorrection = float3();
+    float deepest = 0;
+    uint deepestTriangle = ~0u;
+    uint bucket = hashSelfCollisionCell(getSelfCollisionCell(particle.position));
+    uint first = bucketStarts[bucket], last = bucketStarts[bucket + 1];
+    //a bucket the full entry buffer cut short checks every triangle's bounds instead, slow but losing no contact until
+    //the host grows the buffer for the next frame
+    bool overflowed = last > entryCapacity;
+    if (overflowed) {
+        first = 0;
+        last = 2 * (particleCount - 1) * (particleCount - 1);
+    }
+
+    for (uint entry = first; !hardParticles[index] && entry < last; entry++) {
+        uint triangle = overflowed ? entry : bucketEntries[entry];
+        if (any(particle.position < triangleBounds[2 * triangle]) || any(particle.position > triangleBounds[2 * triangle + 1])) continue;
+        float4 normalArea = triangleNormals[triangle];
+        if (!(normalArea.w > 0)) continue;
+
+        uint3 vertices = uint3(indices[3 * triangle], indices[3 * triangle + 1], indices[3 * triangle + 2]);
+        int3 dx = abs(int3(vertices % particleCount) - int(position.x)), dy = abs(int3(vertices / particleCount) - int(position.y));
+        if (any(max(dx, dy) <= 1)) continue;
+
+        float3 a = particles[vertices.x].position, b = particles[vertices.y].position, c = particles[vertices.z].position;
+        float3 normal = normalArea.xyz;
+        float side = dot(particle.position - dt * particle.velocity - a, normal) >= 0 ? 1 : -1;
+        float height = side * dot(particle.position - a, normal);
+        float depth = selfCollisionThickness - height;
+        if (depth <= 0 || height < -selfCollisionThickness) continue;
+
+        float3 projected = particle.position - dot(particle.position - a, normal) * normal;
+        float weightA = dot(cross(b - projected, c - projected), normal) / normalArea.w;
+        float weightB = dot(cross(c - projected, a - projected), normal) / normalArea.w;
+        float weightC = 1 - weightA - weightB;
+        if (weightA < 0 || weightB < 0 || weightC < 0) continue;
+        if (depth < deepest || (depth == deepest && triangle > deepestTriangle)) continue;
+
+        deepest = depth;
+        deepestTriangle = triangle;
+        float3 direction = side * normal;
+        float3 surfaceVelocity = weightA * particles[vertices.x].velocity + weightB * particles[vertices.y].velocity + weightC * particles[vertices.z].velocity;
+        float approach = dot(particle.velocity - surfaceVelocity, direction);
+        positionCorrection = depth * direction;
+        velocityCorrection = approach < 0 ? -approach * direction : float3();
+    }
+    corrections[2 * index] = positionCorrection;
+    corrections[2 * index + 1] = velocityCorrection;
+}
+
+kernel void applyClothSelfCollisionKernel(
+    uint2 position                          [[thread_position_in_grid]],
+    device Particle *particles              [[buffer(3)]],
+    const device float3 *corrections        [[buffer(21)]]
+) {
+    if (position.x >= particleCount || position.y >= particleCount) return;
+    uint index = position.y * particleCount + position.x;
+    particles[index].position += corrections[2 * index];
+    particles[index].velocity += corrections[2 * index + 1];
+}
+
+//instances are sorted by particleOffset, so the owner of a particle is the last one starting at or before it
+ClothInstance findClothInstance(constant ClothInstance *instances, uint instanceCount, uint particleIndex) {
+    uint low = 0, high = instanceCount - 1;
+    while (low < high) {
+        uint middle = (low + high + 1) / 2;
+        if (instances[middle].particleOffset <= particleIndex) low = middle;
+        else high = middle - 1;
+    }
+    return instances[low];
+}
+
+//simulateClothDeterministicKernel over every cloth of a ClothBatch in one dispatch; each thread looks up its cloth
+//and offsets the particle pointer to it, so the grid helpers keep working in that cloth's local indices
+kernel void simulateClothBatchKernel(
+    uint particleIndex                                                                              [[thread_position_in_grid]],
+    constant float &dt                                                                              [[buffer(0)]],
+    SceneAccelerationStructure accelerationStructure                                                [[buffer(1)]],
+    SceneIntersectionFunctionTable intersectionFunctionTable                                        [[buffer(2)]],
+    const device Particle *previousParticles                                                        [[buffer(3)]],
+    device packed_float3 *vertices                                                                  [[buffer(5)]],
+    constant bool &finalIteration                                                                   [[buffer(6)]],
+    constant uint &sceneInstanceId                                                                  [[buffer(7)]],
+    device Particle *nextParticles                                                                  [[buffer(9)]],
+    constant ClothInstance *instances                                                               [[buffer(22)]],
+    constant uint &instanceCount                                                                    [[buffer(23)]],
+    const device float3 *triangleDrag                                                               [[buffer(24)]]
+) {
+    ClothInstance instance = findClothInstance(instances, instanceCount, particleIndex);
+    ClothParameters cloth = instance.parameters;
+    uint index = particleIndex - instance.particleOffset;
+    if (index >= cloth.particleCount * cloth.particleCount) return;
+    uint2 position = uint2(index % cloth.particleCount, index / cloth.particleCount);
+    const device Particle *clothParticles = previousParticles + instance.particleOffset;
+    float3 acceleration = 0;
+
+    applyGravity(acceleration);
+    applyClothSpringDampers(cloth, acceleration, position, clothParticles, index, 1);
+    applyClothSpringDampers(cloth, acceleration, position, clothParticles, index, 2);
+    applyClothDrag(cloth, acceleration, position, triangleDrag + instance.triangleOffset);
+
+    device Particle &particle = nextParticles[particleIndex];
+    particle = previousParticles[particleIndex];
+    simulateMotion(particle, acceleration, dt);
+    if (finalIteration) {
+        constrainCollision(particle, accelerationStructure, intersectionFunctionTable, sceneInstanceId, vertices[particleIndex]);
+        vertices[particleIndex] = particle.position;
+    }
+}
+
+//applyClothAttachmentsKernel over a ClothBatch, whose attachments name particles in the shared arena; the mass comes
+//from the cloth the particle belongs to
+kernel void applyClothBatchAttachmentsKernel(
+    uint position                           [[thread_position_in_grid]],
+    constant float &dt                      [[buffer(0)]],
+    device Particle *particles              [[buffer(3)]],
+    device packed_float3 *vertices          [[buffer(5)]],
+    constant bool &finalIteration           [[buffer(6)]],
+    constant ClothInstance *instances       [[buffer(22)]],
+    constant uint &instanceCount            [[buffer(23)]],
+    const device Attachment *attachments    [[buffer(27)]],
+    constant AttachmentStep &step           [[buffer(28)]],
+    const device float4x4 *handles          [[buffer(29)]]
+) {
+    if (position >= step.attachmentCount) return;
+    Attachment attachment = attachments[position];
+    float mass = findClothInstance(instances, instanceCount, attachment.particle).parameters.particleMass;
+    device Particle &particle = particles[attachment.particle];
+    float3 correction = getAttachmentCorrection(attachment, handles, particle.position, mass, dt, step.fraction);
+    particle.position += correction;
+    particle.velocity += correction / dt;
+    if (finalIteration) vertices[attachment.particle] = particle.position;
+}
+
+kernel void recalculateClothBatchNormalsKernel(
+    uint particleIndex                      [[thread_position_in_grid]],
+    const device Particle *particles        [[buffer(3)]],
+    device PrimitiveData *primitiveData     [[buffer(4)]],
+    constant ClothInstance *instances       [[buffer(22)]],
+    constant uint &instanceCount            [[buffer(23)]]
+) {
+    ClothInstance instance = findClothInstance(instances, instanceCount, particleIndex);
+    ClothParameters cloth = instance.parameters;
+    uint index = particleIndex - instance.particleOffset;
+    if (index >= cloth.particleCount * cloth.particleCount) return;
+    uint2 position = uint2(index % cloth.particleCount, index / cloth.particleCount);
+    recalculateClothNormals(cloth, position, particles + instance.particleOffset, primitiveData + instance.triangleOffset);
+}
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "simulation/BakeCache.hpp"
+
+static inline float getComponent(const pfloat3 &v, int component) {
+    return component == 0 ? v.x : component == 1 ? v.y : v.z;
+}
+
+static inline void setComponent(pfloat3 &v, int component, float value) {
+    (component == 0 ? v.x : component == 1 ? v.y : v.z) = value;
+}
+
+//later frames continue the motion of the last one, so a cloth moving steadily leaves residuals near zero
+static inline int32_t predict(uint32_t localFrame, int32_t previous, int32_t beforePrevious) {
+    return localFrame == 1 ? previous : 2 * previous - beforePrevious;
+}
+
+static inline void writeResidual(std::vector<uint8_t> &bytes, int32_t residual) {
+    uint32_t zigzag = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+    while (zigzag >= 0x80) {
+        bytes.push_back((zigzag & 0x7f) | 0x80);
+        zigzag >>= 7;
+    }
+    bytes.push_back(zigzag);
+}
+
+//a varint running into pEnd, or past the five bytes a 32 bit value takes, means the chunk is corrupt
+static inline int32_t readResidual(const uint8_t *&pCursor, const uint8_t *pEnd) {
+    uint32_t zigzag = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (pCursor == pEnd || shift > 28) throw std::runtime_error("corrupt bake chunk");
+        uint8_t byte = *pCursor++;
+        zigzag |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+}
+
+BakeWriter::BakeWriter(const char *fileName, uint32_t vertexCount, uint32_t chunkFrames) {
+    this->_vertexCount = vertexCount;
+    this->_chunkFrames = chunkFrames;
+    this->_pFile = fopen(fileName, "wb");
+    if (this->_pFile == nullptr) throw std::runtime_error("could not open bake file for writing");
+
+    BakeHeader header = {.magic = {'M', 'C', 'B', 'K'}, .version = BAKE_VERSION, .vertexCount = vertexCount, .chunkFrames = chunkFrames};
+    fwrite(&header, sizeof(BakeHeader), 1, this->_pFile);
+    this->_byteCount = sizeof(BakeHeader);
+    this->_frames.reserve(chunkFrames * vertexCount);
+    this->_keyframe.resize(3 * vertexCount);
+    this->_previous.resize(3 * vertexCount);
+    this->_beforePrevious.resize(3 * vertexCount);
+}
+
+BakeWriter::~BakeWriter() {
+    this->flush();
+    fclose(this->_pFile);
+}
+
+void BakeWriter::addFrame(const pfloat3 *vertices) {
+    this->_frames.insert(this->_frames.end(), vertices, vertices + this->_vertexCount);
+    this->_frameCount++;
+    if (this->_frames.size() == this->_chunkFrames * this->_vertexCount) this->flush();
+}
+
+uint32_t BakeWriter::getFrameCount() {
+    return this->_frameCount;
+}
+
+uint64_t BakeWriter::getByteCount() {
+    return this->_byteCount;
+}
+
+void BakeWriter::flush() {
+    const uint32_t n = this->_vertexCount;
+    if (n == 0 || this->_frames.empty()) return;
+    uint32_t frameCount = this->_frames.size() / n;
+
+    //bounds over every frame of the chunk, so all of them quantize against the same grid
+    float lower[3], upper[3];
+    for (int component = 0; component < 3; component++) {
+        lower[component] = INFINITY;
+        upper[component] = -INFINITY;
+    }
+    for (const pfloat3 &vertex: this->_frames) {
+        for (int component = 0; component < 3; component++) {
+            lower[component] = std::min(lower[component], getComponent(vertex, component));
+            upper[component] = std::max(upper[component], getComponent(vertex, component));
+        }
+    }
+    BakeChunkHeader chunk = {.frameCount = frameCount, .byteCount = 0, .origin = {}, .scale = {}};
+    for (int component = 0; component < 3; component++) {
+        setComponent(chunk.origin, component, lower[component]);
+        setComponent(chunk.scale, component, (upper[component] - lower[component]) / UINT16_MAX);
+    }
+
+    this->_residuals.clear();
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        const pfloat3 *vertices = this->_frames.data() + frame * n;
+        for (uint32_t i = 0; i < 3 * n; i++) {
+            int component = i % 3;
+            float scale = getComponent(chunk.scale, component);
+            float offset = getComponent(vertices[i / 3], component) - getComponent(chunk.origin, component);
+            int32_t quantized = scale > 0 ? std::clamp((int32_t)lroundf(offset / scale), 0, (int32_t)UINT16_MAX) : 0;
+            if (frame == 0) {
+                this->_keyframe[i] = quantized;
+            }
+            else {
+                writeResidual(this->_residuals, quantized - predict(frame, this->_previous[i], this->_beforePrevious[i]));
+            }
+            this->_beforePrevious[i] = this->_previous[i];
+            this->_previous[i] = quantized;
+        }
+    }
+    chunk.byteCount = this->_residuals.size();
+
+    fwrite(&chunk, sizeof(BakeChunkHeader), 1, this->_pFile);
+    fwrite(this->_keyframe.data(), sizeof(uint16_t), this->_keyframe.size(), this->_pFile);
+    fwrite(this->_residuals.data(), 1, this->_residuals.size(), this->_pFile);
+    this->_byteCount += sizeof(BakeChunkHeader) + this->_keyframe.size() * sizeof(uint16_t) + this->_residuals.size();
+    this->_frames.clear();
+}
+
+BakeReader::BakeReader(const char *fileName) {
+    int file = open(fileName, O_RDONLY);
+    if (file < 0) throw std::runtime_error("could not open bake file");
+    struct stat status;
+    fstat(file, &status);
+    this->_mappingSize = status.st_size;
+    this->_pMapping = this->_mappingSize > 0 ? mmap(nullptr, this->_mappingSize, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    close(file);
+    if (this->_pMapping == MAP_FAILED) throw std::runtime_error("could not map bake file");
+    //the destructor does not run when the constructor throws, so the mapping is released first
+    auto fail = [&](const char *message) {
+        munmap(this->_pMapping, this->_mappingSize);
+        throw std::runtime_error(message);
+    };
+    if (this->_mappingSize < sizeof(BakeHeader)) fail("not a bake file");
+
+    //the header is checked against the file before anything is sized from it
+    const uint8_t *pBytes = (const uint8_t*)this->_pMapping;
+    BakeHeader header;
+    memcpy(&header, pBytes, sizeof(BakeHeader));
+    if (memcmp(header.magic, "MCBK", 4) != 0 || header.version != BAKE_VERSION) fail("not a bake file");
+    if (header.chunkFrames == 0) fail("bake file has no frames per chunk");
+    size_t keyframeSize = 3 * (size_t)header.vertexCount * sizeof(uint16_t);
+    if (keyframeSize > this->_mappingSize) fail("bake file is smaller than one keyframe");
+    this->_vertexCount = header.vertexCount;
+    this->_chunkFrames = header.chunkFrames;
+    this->_previous.resize(3 * header.vertexCount);
+    this->_beforePrevious.resize(3 * header.vertexCount);
+
+    //index the chunks up front; a bake cut short by a crash keeps every chunk that was written in full, while a chunk
+    //whose frame count could not have been written means the file is corrupt
+    const uint8_t *pChunk = pBytes + sizeof(BakeHeader), *pEnd = pBytes + this->_mappingSize;
+    while (pEnd - pChunk >= (ptrdiff_t)sizeof(BakeChunkHeader)) {
+        BakeChunkHeader chunk;
+        memcpy(&chunk, pChunk, sizeof(BakeChunkHeader));
+        size_t chunkSize = sizeof(BakeChunkHeader) + keyframeSize + chunk.byteCount;
+        if ((size_t)(pEnd - pChunk) < chunkSize) break;
+        if (chunk.frameCount == 0 || chunk.frameCount > this->_chunkFrames) fail("corrupt bake chunk");
+        if ((uint64_t)this->_frameCount + chunk.frameCount > UINT32_MAX) fail("bake file has too many frames");
+        this->_chunks.push_back(pChunk);
+        this->_frameCount += chunk.frameCount;
+        if (chunk.frameCount < this->_chunkFrames) break;
+        pChunk += chunkSize;
+    }
+}
+
+BakeReader::~BakeReader() {
+    munmap(this->_pMapping, this->_mappingSize);
+}
+
+uint32_t BakeReader::getVertexCount() {
+    return this->_vertexCount;
+}
+
+uint32_t BakeReader::getFrameCount() {
+    return this->_frameCount;
+}
+
+void BakeReader::readFrame(uint32_t frame, pfloat3 *vertices) {
+    if (this->_frameCount == 0) return;
+    frame = std::min(frame, this->_frameCount - 1);
+    uint32_t chunkIndex = frame / this->_chunkFrames;
+    const uint8_t *pChunk = this->_chunks[chunkIndex];
+    BakeChunkHeader chunk;
+    memcpy(&chunk, pChunk, sizeof(BakeChunkHeader));
+
+    bool sameChunk = this->_decodedFrame != UINT32_MAX && this->_decodedFrame / this->_chunkFrames == chunkIndex;
+    if (!sameChunk || frame < this->_decodedFrame) {
+        const uint8_t *pKeyframe = pChunk + sizeof(BakeChunkHeader);
+        for (uint32_t i = 0; i < 3 * this->_vertexCount; i++) {
+            uint16_t quantized;
+            memcpy(&quantized, pKeyframe + i * sizeof(uint16_t), sizeof(uint16_t));
+            this->_previous[i] = quantized;
+        }
+        this->_pCursor = pKeyframe + 3 * (size_t)this->_vertexCount * sizeof(uint16_t);
+        this->_pChunkEnd = this->_pCursor + chunk.byteCount;
+        this->_decodedFrame = chunkIndex * this->_chunkFrames;
+    }
+    while (this->_decodedFrame < frame) this->decodeNextFrame();
+
+    for (uint32_t i = 0; i < 3 * this->_vertexCount; i++) {
+        int component = i % 3;
+        setComponent(vertices[i / 3], component, getComponent(chunk.origin, component) + this->_previous[i] * getComponent(chunk.scale, component));
+    }
+}
+
+//the decoded frame is forgotten while the residuals are read, so a corrupt chunk that throws midway makes the next
+//readFrame start over from the keyframe
+void BakeReader::decodeNextFrame() {
+    uint32_t frame = this->_decodedFrame;
+    uint32_t localFrame = frame % this->_chunkFrames + 1;
+    this->_decodedFrame = UINT32_MAX;
+    for (uint32_t i = 0; i < 3 * this->_vertexCount; i++) {
+        int32_t quantized = predict(localFrame, this->_previous[i], this->_beforePrevious[i]) + readResidual(this->_pCursor, this->_pChunkEnd);
+        this->_beforePrevious[i] = this->_previous[i];
+        this->_previous[i] = quantized;
+    }
+    this->_decodedFrame = frame + 1;
+}
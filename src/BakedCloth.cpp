@@ -0,0 +1,67 @@
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include "sceneobjects/BakedCloth.hpp"
+#include "sceneobjects/Cloth.hpp"
+
+BakedCloth::BakedCloth(MTL::Device *pDevice, const char *fileName) : _reader(fileName) {
+    //bakes come from square cloths, so the vertex count gives back the grid the indices were generated for
+    uint32_t vertexCount = this->_reader.getVertexCount();
+    uint32_t particleCount = lround(sqrt((double)vertexCount));
+    if (particleCount < 2 || particleCount * particleCount != vertexCount) throw std::runtime_error("bake is not a square cloth");
+    uint32_t triangleCount = 2 * (particleCount - 1) * (particleCount - 1);
+
+    this->_pVertexBuffer = pDevice->newBuffer(vertexCount * sizeof(pfloat3), MTL::ResourceStorageModeManaged);
+    this->_pNextVertexBuffer = pDevice->newBuffer(vertexCount * sizeof(pfloat3), MTL::ResourceStorageModeManaged);
+    this->_pIndexBuffer = Cloth::acquireIndexBuffer(pDevice, particleCount);
+    this->_pDataBuffer = pDevice->newBuffer(triangleCount * sizeof(PrimitiveData), MTL::ResourceStorageModePrivate);
+    this->_reader.readFrame(0, (pfloat3*)this->_pVertexBuffer->contents());
+    this->_pVertexBuffer->didModifyRange(NS::Range::Make(0, this->_pVertexBuffer->length()));
+
+    NS::Error *err = nullptr;
+    MTL::FunctionConstantValues *pFunctionConstants = MTL::FunctionConstantValues::alloc()->init();
+    pFunctionConstants->setConstantValue(&particleCount, MTL::DataTypeUInt, NS::UInteger(0));
+    MTL::Library *pLibrary = pDevice->newDefaultLibrary();
+    MTL::Function *pNormalsFunction = pLibrary->newFunction(NS::String::string("recalculateBakedClothNormalsKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+    assertNSError(err);
+    this->_pNormalsPipelineState = new ComputePipelineState(pDevice, pNormalsFunction, MTL::Size::Make(particleCount, particleCount, 1));
+
+    this->getDescriptor()->setTriangleCount(triangleCount);
+    this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
+    this->getDescriptor()->setIndexBuffer(this->_pIndexBuffer);
+    this->getDescriptor()->setPrimitiveDataBuffer(this->_pDataBuffer);
+    this->getDescriptor()->setPrimitiveDataStride(sizeof(PrimitiveData));
+    this->getDescriptor()->setPrimitiveDataElementSize(sizeof(PrimitiveData));
+
+    pFunctionConstants->release();
+    pLibrary->release();
+    pNormalsFunction->release();
+}
+
+BakedCloth::~BakedCloth() {
+    delete this->_pNormalsPipelineState;
+    this->_pVertexBuffer->release();
+    this->_pNextVertexBuffer->release();
+    Cloth::releaseIndexBuffer(this->_pIndexBuffer);
+    this->_pDataBuffer->release();
+}
+
+//the renderer waits for the update's command buffer, which the queue runs after the last frame's render, so the buffer
+//that render used is free again by the time it comes round as the next buffer
+void BakedCloth::update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+    if (this->_reader.getFrameCount() == 0) return;
+    this->_frame = (this->_frame + 1) % this->_reader.getFrameCount();
+    this->_reader.readFrame(this->_frame, (pfloat3*)this->_pNextVertexBuffer->contents());
+    this->_pNextVertexBuffer->didModifyRange(NS::Range::Make(0, this->_pNextVertexBuffer->length()));
+    std::swap(this->_pVertexBuffer, this->_pNextVertexBuffer);
+
+    MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
+    pCEnc->setBuffer(this->_pDataBuffer, 0, 4);
+    pCEnc->setBuffer(this->_pVertexBuffer, 0, 5);
+    this->_pNormalsPipelineState->dispatch(pCEnc);
+    pCEnc->endEncoding();
+}
+
+void BakedCloth::updateGeometry() {
+    this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
+}
@@ -0,0 +1,65 @@
+#include "simulation/BlockSparseMatrix.hpp"
+
+Block3 Block3::inverse() const {
+    simd::float3 a = this->rows[0], b = this->rows[1], c = this->rows[2];
+    simd::float3 bc = simd::cross(b, c), ca = simd::cross(c, a), ab = simd::cross(a, b);
+    float determinant = simd::dot(a, bc);
+    if (determinant == 0) return Block3::identity();
+    //rows of the inverse are the columns of the cofactor vectors above
+    Block3 inverse = Block3{{
+        simd::float3{bc.x, ca.x, ab.x},
+        simd::float3{bc.y, ca.y, ab.y},
+        simd::float3{bc.z, ca.z, ab.z}
+    }};
+    return inverse * (1 / determinant);
+}
+
+void BlockSparseMatrix::setPattern(std::vector<uint32_t> rowStarts, std::vector<uint32_t> columns) {
+    this->_rowStarts = rowStarts;
+    this->_columns = columns;
+    this->_blocks.assign(columns.size(), Block3::zero());
+    this->_diagonals.resize(this->getRowCount());
+    for (uint32_t row = 0; row < this->getRowCount(); row++) {
+        for (uint32_t block = this->getRowStart(row); block < this->getRowEnd(row); block++) {
+            if (this->_columns[block] == row) this->_diagonals[row] = block;
+        }
+    }
+}
+
+uint32_t BlockSparseMatrix::getRowCount() const {
+    return this->_rowStarts.empty() ? 0 : this->_rowStarts.size() - 1;
+}
+
+uint32_t BlockSparseMatrix::getRowStart(uint32_t row) const {
+    return this->_rowStarts[row];
+}
+
+uint32_t BlockSparseMatrix::getRowEnd(uint32_t row) const {
+    return this->_rowStarts[row + 1];
+}
+
+uint32_t BlockSparseMatrix::getColumn(uint32_t block) const {
+    return this->_columns[block];
+}
+
+uint32_t BlockSparseMatrix::getDiagonal(uint32_t row) const {
+    return this->_diagonals[row];
+}
+
+Block3& BlockSparseMatrix::getBlock(uint32_t block) {
+    return this->_blocks[block];
+}
+
+const Block3& BlockSparseMatrix::getBlock(uint32_t block) const {
+    return this->_blocks[block];
+}
+
+void BlockSparseMatrix::multiply(const simd::float3 *x, simd::float3 *y, uint32_t begin, uint32_t end) const {
+    for (uint32_t row = begin; row < end; row++) {
+        simd::float3 sum = simd::float3{};
+        for (uint32_t block = this->_rowStarts[row]; block < this->_rowStarts[row + 1]; block++) {
+            sum += this->_blocks[block] * x[this->_columns[block]];
+        }
+        y[row] = sum;
+    }
+}
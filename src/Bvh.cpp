@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include "pathtracing/Bvh.hpp"
+
+//relative costs of visiting a node and of testing a triangle in the surface area heuristic
+constexpr float TRAVERSAL_COST = 1, INTERSECTION_COST = 1;
+//the largest leaf, which is only made when splitting it would cost more
+constexpr uint32_t MAX_LEAF_TRIANGLES = 8;
+//ranges at most this large, or this fraction of the tree per thread, are built as one task
+constexpr uint32_t MIN_TASK_TRIANGLES = 1024, TASKS_PER_THREAD = 4;
+//nodes this deep are always leaves, so the traversal stack, which holds at most one node per level, cannot overflow
+constexpr uint32_t MAX_DEPTH = 64;
+
+static inline simd::float3 toFloat3(pfloat3 v) {
+    return simd::float3{v.x, v.y, v.z};
+}
+
+static inline pfloat3 toPfloat3(simd::float3 v) {
+    return pfloat3{v.x, v.y, v.z};
+}
+
+static inline float getArea(simd::float3 lower, simd::float3 upper) {
+    simd::float3 extent = simd::max(upper - lower, simd::float3{0, 0, 0});
+    return 2 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+struct Bounds {
+    simd::float3 lower = simd::float3{INFINITY, INFINITY, INFINITY};
+    simd::float3 upper = simd::float3{-INFINITY, -INFINITY, -INFINITY};
+
+    inline void grow(simd::float3 lower, simd::float3 upper) {
+        this->lower = simd::min(this->lower, lower);
+        this->upper = simd::max(this->upper, upper);
+    };
+    inline float getArea() const {
+        return ::getArea(this->lower, this->upper);
+    };
+};
+
+//the bounds of a range's triangles and of their centroids
+struct RangeBounds {
+    Bounds node, centroids;
+
+    inline void merge(const RangeBounds &other) {
+        this->node.grow(other.node.lower, other.node.upper);
+        this->centroids.grow(other.centroids.lower, other.centroids.upper);
+    };
+};
+
+struct Bin {
+    Bounds bounds;
+    uint32_t count = 0;
+};
+
+//the triangles of a range sorted into BVH_BINS bins along each axis
+struct BinSet {
+    Bin bins[3][BVH_BINS];
+
+    inline void merge(const BinSet &other) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (uint32_t i = 0; i < BVH_BINS; i++) {
+                this->bins[axis][i].bounds.grow(other.bins[axis][i].bounds.lower, other.bins[axis][i].bounds.upper);
+                this->bins[axis][i].count += other.bins[axis][i].count;
+            }
+        }
+    };
+};
+
+//accumulate(partial, begin, end) over the range, in one chunk per thread when parallel, merged in chunk order
+template <typename Partial, typename Accumulate>
+static Partial reduceRange(ThreadPool *pThreadPool, bool parallel, uint32_t begin, uint32_t end, Accumulate accumulate) {
+    uint32_t chunkCount = parallel ? pThreadPool->getThreadCount() : 1;
+    std::vector<Partial> partials(chunkCount);
+    auto accumulateChunks = [&](uint32_t firstChunk, uint32_t lastChunk) {
+        for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+            accumulate(partials[chunk], begin + (uint64_t)(end - begin) * chunk / chunkCount, begin + (uint64_t)(end - begin) * (chunk + 1) / chunkCount);
+        }
+    };
+    if (parallel) pThreadPool->parallelFor(chunkCount, accumulateChunks);
+    else accumulateChunks(0, 1);
+    for (uint32_t chunk = 1; chunk < chunkCount; chunk++) partials[0].merge(partials[chunk]);
+    return partials[0];
+}
+
+static inline uint32_t getBin(const BvhPrimitive &primitive, int axis, const Bounds &centroids, float scale) {
+    return std::min(BVH_BINS - 1, (uint32_t)((primitive.centroid[axis] - centroids.lower[axis]) * scale));
+}
+
+Bvh::Bvh(ThreadPool *pThreadPool) : _scheduler(pThreadPool) {
+    this->_pThreadPool = pThreadPool;
+}
+
+//writes the range's bounds into node and either makes it a leaf, returning false, or reorders the range about the
+//cheapest split and returns true with the first triangle of the second half in middle
+bool Bvh::splitNode(BvhNode &node, uint32_t begin, uint32_t end, uint32_t depth, bool parallel, uint32_t &middle) {
+    const BvhPrimitive *primitives = this->_primitives.data();
+    uint32_t *order = this->_order.data();
+    RangeBounds bounds = reduceRange<RangeBounds>(this->_pThreadPool, parallel, begin, end, [&](RangeBounds &partial, uint32_t chunkBegin, uint32_t chunkEnd) {
+        for (uint32_t i = chunkBegin; i < chunkEnd; i++) {
+            const BvhPrimitive &primitive = primitives[order[i]];
+            partial.node.grow(primitive.lower, primitive.upper);
+            partial.centroids.grow(primitive.centroid, primitive.centroid);
+        }
+    });
+    node.lower = toPfloat3(bounds.node.lower);
+    node.upper = toPfloat3(bounds.node.upper);
+    node.offset = begin;
+    node.count = end - begin;
+    if (end - begin == 1 || depth + 1 >= MAX_DEPTH) return false;
+
+    simd::float3 centroidExtent = bounds.centroids.upper - bounds.centroids.lower;
+    float scales[3];
+    for (int axis = 0; axis < 3; axis++) scales[axis] = centroidExtent[axis] > 0 ? BVH_BINS / centroidExtent[axis] : 0;
+    BinSet binSet = reduceRange<BinSet>(this->_pThreadPool, parallel, begin, end, [&](BinSet &partial, uint32_t chunkBegin, uint32_t chunkEnd) {
+        for (uint32_t i = chunkBegin; i < chunkEnd; i++) {
+            const BvhPrimitive &primitive = primitives[order[i]];
+            for (int axis = 0; axis < 3; axis++) {
+                Bin &bin = partial.bins[axis][getBin(primitive, axis, bounds.centroids, scales[axis])];
+                bin.bounds.grow(primitive.lower, primitive.upper);
+                bin.count++;
+            }
+        }
+    });
+
+    //sweep each axis from the right for the cost of everything above a plane, then from the left for the total
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    uint32_t bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scales[axis] == 0) continue;
+        float rightCosts[BVH_BINS];
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t i = BVH_BINS - 1; i > 0; i--) {
+            right.grow(binSet.bins[axis][i].bounds.lower, binSet.bins[axis][i].bounds.upper);
+            rightCount += binSet.bins[axis][i].count;
+            rightCosts[i] = rightCount ? rightCount * right.getArea() : 0;
+        }
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 1; i < BVH_BINS; i++) {
+            left.grow(binSet.bins[axis][i - 1].bounds.lower, binSet.bins[axis][i - 1].bounds.upper);
+            leftCount += binSet.bins[axis][i - 1].count;
+            if (leftCount == 0 || leftCount == end - begin) continue;
+            float cost = leftCount * left.getArea() + rightCosts[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = i;
+            }
+        }
+    }
+
+    //triangles whose centroids all coincide cannot be binned apart; a range too big for a leaf is halved as it lies
+    if (bestAxis < 0) {
+        if (end - begin <= MAX_LEAF_TRIANGLES) return false;
+        middle = begin + (end - begin) / 2;
+        node.count = 0;
+        return true;
+    }
+    float nodeArea = bounds.node.getArea();
+    float splitCost = TRAVERSAL_COST + INTERSECTION_COST * (nodeArea > 0 ? bestCost / nodeArea : 0);
+    if (end - begin <= MAX_LEAF_TRIANGLES && INTERSECTION_COST * (end - begin) <= splitCost) return false;
+
+    middle = std::partition(order + begin, order + end, [&](uint32_t primitive) {
+        return getBin(primitives[primitive], bestAxis, bounds.centroids, scales[bestAxis]) < bestBin;
+    }) - order;
+    node.count = 0;
+    return true;
+}
+
+void Bvh::buildSubtree(std::vector<BvhNode> &nodes, uint32_t node, uint32_t begin, uint32_t end, uint32_t depth) {
+    uint32_t middle;
+    if (!this->splitNode(nodes[node], begin, end, depth, false, middle)) return;
+    uint32_t child = nodes.size();
+    nodes.resize(child + 2);
+    nodes[node].offset = child;
+    this->buildSubtree(nodes, child, begin, middle, depth + 1);
+    this->buildSubtree(nodes, child + 1, middle, end, depth + 1);
+}
+
+void Bvh::build(const TraceScene &scene) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t triangleCount = scene.getTriangleCount();
+    this->_primitives.resize(triangleCount);
+    this->_order.resize(triangleCount);
+    std::iota(this->_order.begin(), this->_order.end(), 0);
+
+    uint32_t primitiveOffset = 0;
+    for (uint32_t geometryId = 0; geometryId < scene.geometries.size(); geometryId++) {
+        const TraceGeometry &geometry = scene.geometries[geometryId];
+        this->_pThreadPool->parallelFor(geometry.triangleCount, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                simd::float3 v0 = geometry.getVertex(geometry.indices[3 * i]);
+                simd::float3 v1 = geometry.getVertex(geometry.indices[3 * i + 1]);
+                simd::float3 v2 = geometry.getVertex(geometry.indices[3 * i + 2]);
+                BvhPrimitive &primitive = this->_primitives[primitiveOffset + i];
+                primitive.lower = simd::min(v0, simd::min(v1, v2));
+                primitive.upper = simd::max(v0, simd::max(v1, v2));
+                primitive.centroid = (primitive.lower + primitive.upper) * 0.5f;
+                primitive.geometryId = geometryId;
+                primitive.primitiveId = i;
+            }
+        });
+        primitiveOffset += geometry.triangleCount;
+    }
+
+    this->_nodes.clear();
+    this->_subtrees.clear();
+    this->_topNodeCount = 0;
+    if (triangleCount > 0) {
+        //the top levels, one node at a time with the binning spread over every thread
+        uint32_t taskSize = std::max(MIN_TASK_TRIANGLES, triangleCount / (TASKS_PER_THREAD * this->_pThreadPool->getThreadCount()));
+        std::vector<BuildTask> pending = {BuildTask{0, 0, triangleCount, 0}}, tasks;
+        this->_nodes.resize(1);
+        while (!pending.empty()) {
+            BuildTask task = pending.back();
+            pending.pop_back();
+            if (task.end - task.begin <= taskSize) {
+                tasks.push_back(task);
+                continue;
+            }
+            uint32_t middle;
+            if (!this->splitNode(this->_nodes[task.node], task.begin, task.end, task.depth, true, middle)) continue;
+            uint32_t child = this->_nodes.size();
+            this->_nodes.resize(child + 2);
+            this->_nodes[task.node].offset = child;
+            pending.push_back(BuildTask{child + 1, middle, task.end, task.depth + 1});
+            pending.push_back(BuildTask{child, task.begin, middle, task.depth + 1});
+        }
+
+        this->_topNodeCount = this->_nodes.size();
+
+        //the subtrees below, each with its root at index 0 of its own array
+        std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+        this->_scheduler.run(tasks.size(), [&](uint32_t i, unsigned int) {
+            subtrees[i].resize(1);
+            this->buildSubtree(subtrees[i], 0, tasks[i].begin, tasks[i].end, tasks[i].depth);
+        });
+        for (uint32_t i = 0; i < tasks.size(); i++) {
+            //the subtree's node k lands at base + k, its root on the node the task was made for
+            uint32_t base = this->_nodes.size() - 1;
+            for (BvhNode &node: subtrees[i]) {
+                if (node.count == 0) node.offset += base;
+            }
+            this->_nodes[tasks[i].node] = subtrees[i][0];
+            this->_nodes.insert(this->_nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+            this->_subtrees.push_back(Subtree{base + 1, (uint32_t)this->_nodes.size()});
+        }
+    }
+
+    this->_triangleIds.resize(triangleCount);
+    this->_pThreadPool->parallelFor(triangleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const BvhPrimitive &primitive = this->_primitives[this->_order[i]];
+            this->_triangleIds[i] = simd::uint2{primitive.geometryId, primitive.primitiveId};
+        }
+    });
+    this->gatherTriangles(scene);
+    this->_geometryTriangleCounts.clear();
+    for (const TraceGeometry &geometry: scene.geometries) this->_geometryTriangleCounts.push_back(geometry.triangleCount);
+    this->_builtSahCost = this->getSahCost();
+    this->_buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//copies each triangle's vertices from the scene into leaf order, placed by their geometry's transform
+void Bvh::gatherTriangles(const TraceScene &scene) {
+    this->_triangles.resize(this->_triangleIds.size());
+    this->_pThreadPool->parallelFor(this->_triangleIds.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const TraceGeometry &geometry = scene.geometries[this->_triangleIds[i].x];
+            const uint32_t *indices = geometry.indices + 3 * this->_triangleIds[i].y;
+            this->_triangles[i] = BvhTriangle{geometry.getVertex(indices[0]), geometry.getVertex(indices[1]), geometry.getVertex(indices[2])};
+        }
+    });
+}
+
+//a leaf's bounds from its triangles, or an interior node's from its children's, which must have been refit already
+void Bvh::refitNode(uint32_t index) {
+    BvhNode &node = this->_nodes[index];
+    Bounds bounds;
+    if (node.count > 0) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+            const BvhTriangle &triangle = this->_triangles[i];
+            bounds.grow(simd::min(triangle.v0, simd::min(triangle.v1, triangle.v2)), simd::max(triangle.v0, simd::max(triangle.v1, triangle.v2)));
+        }
+    }
+    else {
+        const BvhNode &left = this->_nodes[node.offset], &right = this->_nodes[node.offset + 1];
+        bounds.grow(toFloat3(left.lower), toFloat3(left.upper));
+        bounds.grow(toFloat3(right.lower), toFloat3(right.upper));
+    }
+    node.lower = toPfloat3(bounds.lower);
+    node.upper = toPfloat3(bounds.upper);
+}
+
+//children always come after their parent, in the top nodes and within each subtree, so walking a range backwards
+//refits every child before its parent
+void Bvh::refit(const TraceScene &scene) {
+    this->gatherTriangles(scene);
+    this->_scheduler.run(this->_subtrees.size(), [&](uint32_t i, unsigned int) {
+        for (uint32_t node = this->_subtrees[i].end; node-- > this->_subtrees[i].begin;) this->refitNode(node);
+    });
+    for (uint32_t node = this->_topNodeCount; node-- > 0;) this->refitNode(node);
+}
+
+bool Bvh::canRefit(const TraceScene &scene) {
+    if (this->_nodes.empty() || scene.geometries.size() != this->_geometryTriangleCounts.size()) return false;
+    for (uint32_t i = 0; i < scene.geometries.size(); i++) {
+        if (scene.geometries[i].triangleCount != this->_geometryTriangleCounts[i]) return false;
+    }
+    return true;
+}
+
+void Bvh::update(const TraceScene &scene) {
+    auto start = std::chrono::steady_clock::now();
+    this->_lastUpdateRebuilt = !this->canRefit(scene);
+    if (!this->_lastUpdateRebuilt) {
+        this->refit(scene);
+        this->_lastUpdateRebuilt = this->getSahCost() > BVH_REBUILD_COST_RATIO * this->_builtSahCost;
+    }
+    if (this->_lastUpdateRebuilt) this->build(scene);
+    this->_updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//children are visited nearest first, and a node left on the stack is skipped if a closer hit has been found since
+bool Bvh::intersect(const TraceRay &ray, TraceHit &hit) const {
+    if (this->_nodes.empty()) return false;
+    simd::float3 inverseDirection = 1 / ray.direction;
+    TraceRay closest = ray;
+    bool found = false;
+
+    const BvhNode *nodes = this->_nodes.data();
+    if (getBoundsDistance(closest, inverseDirection, toFloat3(nodes[0].lower), toFloat3(nodes[0].upper), closest.maxDistance) == INFINITY) return false;
+    uint32_t stackNodes[MAX_DEPTH];
+    float stackDistances[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    uint32_t index = 0;
+    while (true) {
+        const BvhNode &node = nodes[index];
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                const BvhTriangle &triangle = this->_triangles[i];
+                float distance;
+                simd::float2 barycentricCoord;
+                if (!intersectTriangle(closest, triangle.v0, triangle.v1, triangle.v2, distance, barycentricCoord)) continue;
+                closest.maxDistance = distance;
+                hit = TraceHit{.distance = distance, .barycentricCoord = barycentricCoord, .geometryId = this->_triangleIds[i].x, .primitiveId = this->_triangleIds[i].y};
+                found = true;
+            }
+        }
+        else {
+            const BvhNode &left = nodes[node.offset], &right = nodes[node.offset + 1];
+            float leftDistance = getBoundsDistance(closest, inverseDirection, toFloat3(left.lower), toFloat3(left.upper), closest.maxDistance);
+            float rightDistance = getBoundsDistance(closest, inverseDirection, toFloat3(right.lower), toFloat3(right.upper), closest.maxDistance);
+            if (leftDistance != INFINITY || rightDistance != INFINITY) {
+                bool leftFirst = leftDistance <= rightDistance;
+                uint32_t near = leftFirst ? node.offset : node.offset + 1;
+                float farDistance = leftFirst ? rightDistance : leftDistance;
+                if (farDistance != INFINITY) {
+                    stackNodes[stackSize] = leftFirst ? node.offset + 1 : node.offset;
+                    stackDistances[stackSize] = farDistance;
+                    stackSize++;
+                }
+                index = near;
+                continue;
+            }
+        }
+
+        while (stackSize > 0 && stackDistances[stackSize - 1] >= closest.maxDistance) stackSize--;
+        if (stackSize == 0) return found;
+        stackSize--;
+        index = stackNodes[stackSize];
+    }
+}
+
+uint32_t Bvh::getNodeCount() {
+    return this->_nodes.size();
+}
+
+float Bvh::getSahCost() {
+    if (this->_nodes.empty()) return 0;
+    float rootArea = getArea(toFloat3(this->_nodes[0].lower), toFloat3(this->_nodes[0].upper));
+    if (rootArea <= 0) return 0;
+    double cost = 0;
+    for (const BvhNode &node: this->_nodes) {
+        float area = getArea(toFloat3(node.lower), toFloat3(node.upper)) / rootArea;
+        cost += node.count > 0 ? INTERSECTION_COST * node.count * area : TRAVERSAL_COST * area;
+    }
+    return cost;
+}
+
+double Bvh::getBuildSeconds() {
+    return this->_buildSeconds;
+}
+
+double Bvh::getUpdateSeconds() {
+    return this->_updateSeconds;
+}
+
+bool Bvh::getLastUpdateRebuilt() {
+    return this->_lastUpdateRebuilt;
+}
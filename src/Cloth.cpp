@@ -1,69 +1,64 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "SceneAccelerationStructure.hpp"
+#include "ThreadPool.hpp"
 #include "sceneobjects/Cloth.hpp"
+#include "simulation/ClothConstraints.hpp"
+
+//setup only, so one pool serves every cloth and its threads sleep once the scene is built
+static ThreadPool &getSetupThreadPool() {
+    static ThreadPool threadPool;
+    return threadPool;
+}
+
+typedef struct CachedIndexBuffer {
+    MTL::Buffer *pBuffer;
+    uint32_t users;
+} CachedIndexBuffer;
+
+static std::mutex indexBufferMutex;
+static std::map<std::pair<MTL::Device*, uint32_t>, CachedIndexBuffer> indexBuffers;
 
 void test(MTL::ComputePipelineState *state, NS::Error *e){
 
 }
 
-Cloth::Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant) {
+Cloth::Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant, bool deterministic, ClothIntegrator integrator) {
     this->_springConstant = springConstant;
     this->_size = size;
     this->_particleCount = particleCount;
+    this->_integrator = integrator == INTEGRATOR_XPBD ? INTEGRATOR_XPBD : INTEGRATOR_EXPLICIT;
+    bool xpbd = this->_integrator == INTEGRATOR_XPBD;
+    deterministic = deterministic && !xpbd;
+    this->_deterministic = deterministic;
 
     NS::Error *err = nullptr;
 
-    float vertices[3 * particleCount * particleCount];
-    unsigned int indices[6 * (particleCount - 1) * (particleCount - 1)];
-    PrimitiveData primitiveData[2 * (particleCount - 1) * (particleCount - 1)];
-    Particle particleData[particleCount * particleCount];
-    
-    //generate indices
-    for (int i = 0; i < particleCount - 1; i++) {
-        for (int j = 0; j < particleCount - 1; j++) {
-            unsigned int index = 6 * (i * (particleCount - 1) + j);
-            indices[index    ] = i * particleCount + j;
-            indices[index + 1] = i * particleCount + j + 1;
-            indices[index + 2] = (i + 1) * particleCount + j;
-            indices[index + 3] = i * particleCount + j + 1;
-            indices[index + 4] = (i + 1) * particleCount + j + 1;
-            indices[index + 5] = (i + 1) * particleCount + j;
-        }
-    }
-
-    //generate particle data
-    for (int i = 0; i < particleCount; i++) {
-        for (int j = 0; j < particleCount; j++) {
-            particleData[i * particleCount + j] = {
-                .alive = i > 0,
-                .normal = simd::float3{ 0, 0, -1},
-                .position = simd::float3{
-                    size * (j - (particleCount - 1.0f) / 2) / (particleCount - 1),
-                    0.5f + size * (1 - (float)i / (particleCount - 1)),
-                    -0.75f + 0.01f * (float)rand() / RAND_MAX
-                },
-                .velocity = simd::float3{},
-                .acceleration = simd::float3{}
-            };
-        }
-    }
-
-    float particleMass = size * size * unitMass / particleCount / particleCount;
-    float sideSpringLength = size / (particleCount - 1);
-    float diagonalSpringLength = sqrt(2) * sideSpringLength;
+    ClothParameters params = makeClothParameters(size, particleCount, unitMass, springConstant, dampingConstant);
 
     MTL::FunctionConstantValues *pFunctionConstants = MTL::FunctionConstantValues::alloc()->init();
     pFunctionConstants->setConstantValue(&particleCount, MTL::DataTypeUInt, NS::UInteger(0));
-    pFunctionConstants->setConstantValue(&particleMass, MTL::DataTypeFloat, NS::UInteger(1));
+    pFunctionConstants->setConstantValue(&params.particleMass, MTL::DataTypeFloat, NS::UInteger(1));
     pFunctionConstants->setConstantValue(&springConstant, MTL::DataTypeFloat, NS::UInteger(2));
     pFunctionConstants->setConstantValue(&dampingConstant, MTL::DataTypeFloat, NS::UInteger(3));
-    pFunctionConstants->setConstantValue(&sideSpringLength, MTL::DataTypeFloat, NS::UInteger(4));
-    pFunctionConstants->setConstantValue(&diagonalSpringLength, MTL::DataTypeFloat, NS::UInteger(5));
+    pFunctionConstants->setConstantValue(&params.sideSpringLength, MTL::DataTypeFloat, NS::UInteger(4));
+    pFunctionConstants->setConstantValue(&params.diagonalSpringLength, MTL::DataTypeFloat, NS::UInteger(5));
+    SelfCollisionParameters selfCollision = makeSelfCollisionParameters(params, 2 * (particleCount - 1) * (particleCount - 1), params.sideSpringLength / 2);
+    pFunctionConstants->setConstantValue(&selfCollision.tableSize, MTL::DataTypeUInt, NS::UInteger(6));
+    pFunctionConstants->setConstantValue(&selfCollision.thickness, MTL::DataTypeFloat, NS::UInteger(8));
+    pFunctionConstants->setConstantValue(&selfCollision.cellSize, MTL::DataTypeFloat, NS::UInteger(9));
 
     MTL::IntersectionFunctionDescriptor *pIntersectFunctionDescriptor = MTL::IntersectionFunctionDescriptor::alloc()->init();
     pIntersectFunctionDescriptor->setConstantValues(pFunctionConstants);
     pIntersectFunctionDescriptor->setName(NS::String::string("intersectIgnoreClothTriangles", NS::UTF8StringEncoding));
 
     MTL::Library *pLibrary = pDevice->newDefaultLibrary();
-    MTL::Function *pClothFunction = pLibrary->newFunction(NS::String::string("simulateClothKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+    const char *clothFunctionName = xpbd ? "updateClothXpbdKernel" : deterministic ? "simulateClothDeterministicKernel" : "simulateClothKernel";
+    MTL::Function *pClothFunction = pLibrary->newFunction(NS::String::string(clothFunctionName, NS::UTF8StringEncoding), pFunctionConstants, &err);
     MTL::Function *pIntersectFunction = pLibrary->newIntersectionFunction(pIntersectFunctionDescriptor, &err);
 
     MTL::ComputePipelineDescriptor *pComputeClothPipelineDescriptor = MTL::ComputePipelineDescriptor::alloc()->init();
@@ -85,23 +80,99 @@ Cloth::Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float uni
     pIntersectionFunctionTableDescriptor->setFunctionCount(1);
     this->_pIntersectionFunctionTable = this->_pComputeClothPipelineState->newIntersectionFunctionTable(pIntersectionFunctionTableDescriptor);
     this->_pIntersectionFunctionTable->setFunction(pIntersectFunctionHandle, 0);
+
+    if (deterministic || xpbd) {
+        MTL::Function *pNormalsFunction = pLibrary->newFunction(NS::String::string("recalculateClothNormalsKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+        this->_pNormalsPipelineState = new ComputePipelineState(pDevice, pNormalsFunction, MTL::Size::Make(particleCount, particleCount, 1));
+        pNormalsFunction->release();
+    }
+    if (!xpbd) {
+        MTL::Function *pSubstepLimitFunction = pLibrary->newFunction(NS::String::string("reduceSubstepLimitKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+        this->_pSubstepLimitPipelineState = new ComputePipelineState(pDevice, pSubstepLimitFunction, MTL::Size::Make(particleCount, particleCount, 1));
+        this->_pSubstepLimitBuffer = pDevice->newBuffer(sizeof(float), MTL::ResourceStorageModeShared);
+        pSubstepLimitFunction->release();
+    }
+    auto newPipelineState = [&](const char *functionName, MTL::Size contextSize) {
+        MTL::Function *pFunction = pLibrary->newFunction(NS::String::string(functionName, NS::UTF8StringEncoding), pFunctionConstants, &err);
+        ComputePipelineState *pPipelineState = new ComputePipelineState(pDevice, pFunction, contextSize);
+        pFunction->release();
+        return pPipelineState;
+    };
+    uint32_t triangleCount = 2 * (particleCount - 1) * (particleCount - 1);
+    this->_pTriangleDragPipelineState = newPipelineState("computeClothTriangleDragKernel", MTL::Size::Make(triangleCount, 1, 1));
+    this->_pCountTrianglesPipelineState = newPipelineState("countClothTrianglesKernel", MTL::Size::Make(triangleCount, 1, 1));
+    this->_pScanBucketsPipelineState = newPipelineState("scanClothBucketsKernel", MTL::Size::Make(1, 1, 1));
+    this->_pScatterTrianglesPipelineState = newPipelineState("scatterClothTrianglesKernel", MTL::Size::Make(triangleCount, 1, 1));
+    this->_pCollideSelfPipelineState = newPipelineState("collideClothSelfKernel", MTL::Size::Make(particleCount, particleCount, 1));
+    this->_pApplySelfCollisionPipelineState = newPipelineState("applyClothSelfCollisionKernel", MTL::Size::Make(particleCount, particleCount, 1));
+    MTL::Function *pAttachmentFunction = pLibrary->newFunction(NS::String::string(xpbd ? "applyClothXpbdAttachmentsKernel" : "applyClothAttachmentsKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+    this->_pAttachmentBuffers = new ClothAttachmentBuffers(pDevice, pAttachmentFunction, particleCount * particleCount);
+    pAttachmentFunction->release();
+    if (xpbd) {
+        MTL::Function *pPredictFunction = pLibrary->newFunction(NS::String::string("predictClothKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+        MTL::Function *pProjectFunction = pLibrary->newFunction(NS::String::string("projectClothConstraintsKernel", NS::UTF8StringEncoding), pFunctionConstants, &err);
+        this->_pPredictPipelineState = new ComputePipelineState(pDevice, pPredictFunction, MTL::Size::Make(particleCount, particleCount, 1));
+        this->_pProjectPipelineState = pDevice->newComputePipelineState(pProjectFunction, &err);
+        assertNSError(err);
+        pPredictFunction->release();
+        pProjectFunction->release();
+
+        std::vector<DistanceConstraint> constraints = buildClothConstraints(params);
+        this->_colorStarts = colorConstraints(constraints, particleCount * particleCount);
+        this->_pConstraintBuffer = pDevice->newBuffer(constraints.data(), constraints.size() * sizeof(DistanceConstraint), MTL::ResourceStorageModeManaged);
+        this->_pPredictedPositionBuffer = pDevice->newBuffer(particleCount * particleCount * sizeof(simd::float3), MTL::ResourceStorageModePrivate);
+    }
     
-    this->_pVertexBuffer = pDevice->newBuffer(3 * particleCount * particleCount * sizeof(float), MTL::ResourceStorageModeManaged);
-    MTL::Buffer *pIndexBuffer = pDevice->newBuffer(6 * (particleCount - 1) * (particleCount - 1) * sizeof(unsigned int), MTL::ResourceStorageModeManaged);
-    this->_pDataBuffer = pDevice->newBuffer(2 * (particleCount - 1) * (particleCount - 1) * sizeof(PrimitiveData), MTL::ResourceStorageModeManaged);
+    //the initial state goes straight into the mapped buffers a block of rows at a time, so even a million particles only
+    //costs one pass over the memory split across the setup threads
+    this->_pVertexBuffer = pDevice->newBuffer(particleCount * particleCount * sizeof(pfloat3), MTL::ResourceStorageModeManaged);
+    this->_pIndexBuffer = Cloth::acquireIndexBuffer(pDevice, particleCount);
+    this->_pDataBuffer = pDevice->newBuffer(triangleCount * sizeof(PrimitiveData), MTL::ResourceStorageModeManaged);
     this->_pParticleBuffer = pDevice->newBuffer(particleCount * particleCount * sizeof(Particle), MTL::ResourceStorageModeManaged);
-    memcpy(this->_pVertexBuffer->contents(), vertices, this->_pVertexBuffer->length());
-    memcpy(pIndexBuffer->contents(), indices, pIndexBuffer->length());
-    memcpy(this->_pDataBuffer->contents(), primitiveData, this->_pDataBuffer->length());
-    memcpy(this->_pParticleBuffer->contents(), particleData, this->_pParticleBuffer->length());
+    Particle *particles = (Particle*)this->_pParticleBuffer->contents();
+    pfloat3 *vertices = (pfloat3*)this->_pVertexBuffer->contents();
+    PrimitiveData *primitiveData = (PrimitiveData*)this->_pDataBuffer->contents();
+    getSetupThreadPool().parallelFor(particleCount, [&](uint32_t begin, uint32_t end) {
+        generateClothParticles(size, particleCount, particles, begin, end);
+        for (uint32_t i = begin * particleCount; i < end * particleCount; i++) {
+            simd::float3 position = particles[i].position;
+            vertices[i] = pfloat3{position.x, position.y, position.z};
+        }
+        //the last particle row starts no quads
+        for (uint32_t t = 2 * begin * (particleCount - 1); t < 2 * std::min(end, particleCount - 1) * (particleCount - 1); t++) {
+            primitiveData[t] = PrimitiveData{
+                .v0Normal = simd::float3{0, 0, -1},
+                .v1Normal = simd::float3{0, 0, -1},
+                .v2Normal = simd::float3{0, 0, -1}
+            };
+        }
+    });
     this->_pVertexBuffer->didModifyRange(NS::Range::Make(0, this->_pVertexBuffer->length()));
-    pIndexBuffer->didModifyRange(NS::Range::Make(0, pIndexBuffer->length()));
     this->_pDataBuffer->didModifyRange(NS::Range::Make(0, this->_pDataBuffer->length()));
     this->_pParticleBuffer->didModifyRange(NS::Range::Make(0, this->_pParticleBuffer->length()));
+    this->_pAttachmentBuffers->setAttachments(generateClothAttachments(particleCount, particles));
+    if (deterministic) {
+        this->_pNextParticleBuffer = pDevice->newBuffer(this->_pParticleBuffer->length(), MTL::ResourceStorageModePrivate);
+    }
+    this->_pTriangleDragBuffer = pDevice->newBuffer(triangleCount * sizeof(simd::float3), MTL::ResourceStorageModePrivate);
+    this->_pWindTextures = new WindTextures(pDevice);
+    this->_pTriangleBoundsBuffer = pDevice->newBuffer(2 * triangleCount * sizeof(simd::float3), MTL::ResourceStorageModePrivate);
+    this->_pTriangleNormalsBuffer = pDevice->newBuffer(triangleCount * sizeof(simd::float4), MTL::ResourceStorageModePrivate);
+    this->_pBucketCountBuffer = pDevice->newBuffer(selfCollision.tableSize * sizeof(uint32_t), MTL::ResourceStorageModeManaged);
+    this->_pBucketStartBuffer = pDevice->newBuffer((selfCollision.tableSize + 1) * sizeof(uint32_t), MTL::ResourceStorageModePrivate);
+    this->_pBucketCursorBuffer = pDevice->newBuffer(selfCollision.tableSize * sizeof(uint32_t), MTL::ResourceStorageModePrivate);
+    this->_entryCapacity = selfCollision.capacity;
+    this->_pBucketEntryBuffer = pDevice->newBuffer(selfCollision.capacity * sizeof(uint32_t), MTL::ResourceStorageModePrivate);
+    this->_pRequiredEntryBuffer = pDevice->newBuffer(sizeof(uint32_t), MTL::ResourceStorageModeShared);
+    *(uint32_t*)this->_pRequiredEntryBuffer->contents() = 0;
+    this->_pSelfCollisionCorrectionBuffer = pDevice->newBuffer(2 * particleCount * particleCount * sizeof(simd::float3), MTL::ResourceStorageModePrivate);
+    //the scan clears the counts after reading them, so they only need zeroing once
+    memset(this->_pBucketCountBuffer->contents(), 0, this->_pBucketCountBuffer->length());
+    this->_pBucketCountBuffer->didModifyRange(NS::Range::Make(0, this->_pBucketCountBuffer->length()));
 
-    this->getDescriptor()->setTriangleCount(2 * (particleCount - 1) * (particleCount - 1));
+    this->getDescriptor()->setTriangleCount(triangleCount);
     this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
-    this->getDescriptor()->setIndexBuffer(pIndexBuffer);
+    this->getDescriptor()->setIndexBuffer(this->_pIndexBuffer);
     this->getDescriptor()->setPrimitiveDataBuffer(this->_pDataBuffer);
     this->getDescriptor()->setPrimitiveDataStride(sizeof(PrimitiveData));
     this->getDescriptor()->setPrimitiveDataElementSize(sizeof(PrimitiveData));
@@ -117,40 +188,261 @@ Cloth::Cloth(MTL::Device *pDevice, float size, uint32_t particleCount, float uni
     pIntersectionFunctionsArray->release();
     pIntersectionFunctionTableDescriptor->release();
     pIntersectFunctionHandle->release();
-    pIndexBuffer->release();
 }
 
 Cloth::~Cloth() {
+    delete this->_pTriangleDragPipelineState;
+    delete this->_pWindTextures;
+    delete this->_pCountTrianglesPipelineState;
+    delete this->_pScanBucketsPipelineState;
+    delete this->_pScatterTrianglesPipelineState;
+    delete this->_pCollideSelfPipelineState;
+    delete this->_pApplySelfCollisionPipelineState;
+    delete this->_pAttachmentBuffers;
+    Cloth::releaseIndexBuffer(this->_pIndexBuffer);
+    for (MTL::Buffer *pBuffer: {
+        this->_pTriangleDragBuffer, this->_pTriangleBoundsBuffer, this->_pTriangleNormalsBuffer, this->_pBucketCountBuffer,
+        this->_pBucketStartBuffer, this->_pBucketCursorBuffer, this->_pBucketEntryBuffer, this->_pRequiredEntryBuffer,
+        this->_pSelfCollisionCorrectionBuffer
+    }) {
+        pBuffer->release();
+    }
     this->_pComputeClothPipelineState->release();
     this->_pIntersectionFunctionTable->release();
     this->_pVertexBuffer->release();
     this->_pDataBuffer->release();
     this->_pParticleBuffer->release();
+    if (this->_deterministic) {
+        delete this->_pNormalsPipelineState;
+        this->_pNextParticleBuffer->release();
+    }
+    if (this->_integrator == INTEGRATOR_XPBD) {
+        delete this->_pNormalsPipelineState;
+        delete this->_pPredictPipelineState;
+        this->_pProjectPipelineState->release();
+        this->_pConstraintBuffer->release();
+        this->_pPredictedPositionBuffer->release();
+    }
+    else {
+        delete this->_pSubstepLimitPipelineState;
+        this->_pSubstepLimitBuffer->release();
+    }
 }
 
-void Cloth::update(MTL::CommandBuffer *pCmd, MTL::AccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
-    //generate timestep based on stiffness, particle density, and delta time
-    float density = this->_particleCount / this->_size;
-    unsigned int iterations = 1 + this->_springConstant * density * density * dt;
+void Cloth::update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+    this->growSelfCollisionEntries();
+    if (this->_integrator == INTEGRATOR_XPBD) {
+        this->updateXpbd(pCmd, pAccelerationStructure, dt, moveDirection, enable);
+        return;
+    }
+    unsigned int iterations = this->getSubsteps(dt, moveDirection, enable);
+    printf("Cloth substeps: %u\n", iterations);
     float fdt = dt / iterations;
     MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
     pCEnc->setBytes(&fdt, sizeof(float), 0);
-    pCEnc->setAccelerationStructure(pAccelerationStructure, 1);
+    pAccelerationStructure->bind(pCEnc, 1);
     pCEnc->setIntersectionFunctionTable(this->_pIntersectionFunctionTable, 2);
+    uint32_t sceneInstanceId = pAccelerationStructure->getInstanceId(this);
+    pCEnc->setBytes(&sceneInstanceId, sizeof(uint32_t), 7);
     pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
     pCEnc->setBuffer(this->_pDataBuffer, 0, 4);
     pCEnc->setBuffer(this->_pVertexBuffer, 0, 5);
-    pCEnc->setBytes(&moveDirection, sizeof(simd::float3), 7);
     pCEnc->setBytes(&enable, sizeof(bool), 8);
-    pCEnc->setComputePipelineState(this->_pComputeClothPipelineState);
+    this->_pWindTextures->bind(pCEnc);
+    this->_pAttachmentBuffers->bind(pCEnc, dt, moveDirection);
     for (int i = 0; i < iterations; i++) {
         bool finalIteration = i == iterations - 1;
         pCEnc->setBytes(&finalIteration, sizeof(bool), 6);
+        if (this->_deterministic) {
+            //read the previous substep from one buffer and write the next into the other, then swap
+            pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+            pCEnc->setBuffer(this->_pNextParticleBuffer, 0, 9);
+            std::swap(this->_pParticleBuffer, this->_pNextParticleBuffer);
+        }
+        this->encodeSelfCollision(pCEnc);
+        this->encodeTriangleDrag(pCEnc);
+        pCEnc->setComputePipelineState(this->_pComputeClothPipelineState);
         pCEnc->dispatchThreadgroups(this->_clothTPG, this->_clothTPT);
+        //the deterministic mode wrote the substep into the buffer now swapped in as current
+        pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+        this->_pAttachmentBuffers->dispatch(pCEnc, (i + 1.0f) / iterations);
+    }
+    this->_pAttachmentBuffers->endFrame();
+    if (this->_deterministic) {
+        pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+        this->_pNormalsPipelineState->dispatch(pCEnc);
     }
+
+    //the renderer waits for this command buffer, so the reduced limit is in place before the next update reads it
+    *(float*)this->_pSubstepLimitBuffer->contents() = INFINITY;
+    pCEnc->setBuffer(this->_pSubstepLimitBuffer, 0, 13);
+    this->_pSubstepLimitPipelineState->dispatch(pCEnc);
     pCEnc->endEncoding();
+    this->synchronizeBakedVertices(pCmd);
+    this->_substepLimitMoveDirection = moveDirection;
+    this->_substepLimitWind = enable;
+    this->_hasSubstepLimit = true;
+}
+
+//the limit measured at the end of the last frame holds while the inputs stay the same; on the first frame and
+//whenever wind or cloth movement changes, fall back to the fixed stiffness heuristic for one frame
+unsigned int Cloth::getSubsteps(float dt, simd::float3 moveDirection, bool enable) {
+    bool sameInputs = simd::all(moveDirection == this->_substepLimitMoveDirection) && enable == this->_substepLimitWind;
+    if (!this->_hasSubstepLimit || !sameInputs) {
+        return getClothSubsteps(this->_springConstant, this->_size, this->_particleCount, dt);
+    }
+    return getAdaptiveClothSubsteps(*(float*)this->_pSubstepLimitBuffer->contents(), dt);
+}
+
+void Cloth::setWindField(const WindField *pWindField) {
+    this->_pWindTextures->setWindField(pWindField);
+}
+
+void Cloth::setAttachments(const std::vector<Attachment> &attachments) {
+    this->_pAttachmentBuffers->setAttachments(attachments);
+}
+
+void Cloth::setHandleTransform(uint32_t handle, simd::float4x4 transform) {
+    this->_pAttachmentBuffers->setHandleTransform(handle, transform);
+}
+
+void Cloth::setSelfCollision(bool enable) {
+    this->_selfCollision = enable;
 }
 
+//resolves contacts left by the previous substep before the next one runs, so it works the same in every mode;
+//expects the current particles in slot 3, the substep length in slot 0 and the hard particle mask in slot 30
+void Cloth::encodeSelfCollision(MTL::ComputeCommandEncoder *pCEnc) {
+    if (!this->_selfCollision) return;
+    pCEnc->setBuffer(this->_pIndexBuffer, 0, 14);
+    pCEnc->setBuffer(this->_pTriangleBoundsBuffer, 0, 15);
+    pCEnc->setBuffer(this->_pTriangleNormalsBuffer, 0, 16);
+    pCEnc->setBuffer(this->_pBucketCountBuffer, 0, 17);
+    pCEnc->setBuffer(this->_pBucketStartBuffer, 0, 18);
+    pCEnc->setBuffer(this->_pBucketEntryBuffer, 0, 19);
+    pCEnc->setBuffer(this->_pBucketCursorBuffer, 0, 20);
+    pCEnc->setBuffer(this->_pSelfCollisionCorrectionBuffer, 0, 21);
+    pCEnc->setBytes(&this->_entryCapacity, sizeof(uint32_t), 22);
+    pCEnc->setBuffer(this->_pRequiredEntryBuffer, 0, 23);
+    this->_pCountTrianglesPipelineState->dispatch(pCEnc);
+    this->_pScanBucketsPipelineState->dispatch(pCEnc);
+    this->_pScatterTrianglesPipelineState->dispatch(pCEnc);
+    this->_pCollideSelfPipelineState->dispatch(pCEnc);
+    this->_pApplySelfCollisionPipelineState->dispatch(pCEnc);
+}
+
+//like the CPU SelfCollision's entries, the entry buffer grows to the most any substep needed; the renderer has waited
+//for the last update, so the total its scans kept is complete. the overflowing frame itself searched the cut short
+//buckets in full, so only its speed suffered, and half again as much room keeps a cloth still bunching up from
+//overflowing every frame
+void Cloth::growSelfCollisionEntries() {
+    uint32_t &requiredEntries = *(uint32_t*)this->_pRequiredEntryBuffer->contents();
+    if (requiredEntries > this->_entryCapacity) {
+        MTL::Device *pDevice = this->_pBucketEntryBuffer->device();
+        this->_entryCapacity = requiredEntries + requiredEntries / 2;
+        this->_pBucketEntryBuffer->release();
+        this->_pBucketEntryBuffer = pDevice->newBuffer(this->_entryCapacity * sizeof(uint32_t), MTL::ResourceStorageModePrivate);
+    }
+    requiredEntries = 0;
+}
+
+//the drag on every triangle from the particles in slot 3, which the particle pass after it gathers; expects the wind
+//flag in slot 8 and the wind textures bound
+void Cloth::encodeTriangleDrag(MTL::ComputeCommandEncoder *pCEnc) {
+    uint32_t triangleCount = 2 * (this->_particleCount - 1) * (this->_particleCount - 1);
+    pCEnc->setBuffer(this->_pIndexBuffer, 0, 14);
+    pCEnc->setBuffer(this->_pTriangleDragBuffer, 0, 24);
+    pCEnc->setBytes(&triangleCount, sizeof(uint32_t), 25);
+    this->_pTriangleDragPipelineState->dispatch(pCEnc);
+}
+
+void Cloth::setBakeWriter(BakeWriter *pBakeWriter) {
+    this->_pBakeWriter = pBakeWriter;
+}
+
+MTL::Buffer *Cloth::acquireIndexBuffer(MTL::Device *pDevice, uint32_t particleCount) {
+    std::lock_guard<std::mutex> lock(indexBufferMutex);
+    CachedIndexBuffer &cached = indexBuffers[{pDevice, particleCount}];
+    if (cached.users == 0) {
+        uint32_t quadRows = particleCount - 1;
+        cached.pBuffer = pDevice->newBuffer(6 * quadRows * quadRows * sizeof(uint32_t), MTL::ResourceStorageModeManaged);
+        uint32_t *indices = (uint32_t*)cached.pBuffer->contents();
+        getSetupThreadPool().parallelFor(quadRows, [&](uint32_t begin, uint32_t end) {
+            generateClothIndices(particleCount, indices, begin, end);
+        });
+        cached.pBuffer->didModifyRange(NS::Range::Make(0, cached.pBuffer->length()));
+    }
+    cached.users++;
+    return cached.pBuffer;
+}
+
+void Cloth::releaseIndexBuffer(MTL::Buffer *pIndexBuffer) {
+    std::lock_guard<std::mutex> lock(indexBufferMutex);
+    for (auto cached = indexBuffers.begin(); cached != indexBuffers.end(); cached++) {
+        if (cached->second.pBuffer != pIndexBuffer) continue;
+        if (--cached->second.users == 0) {
+            pIndexBuffer->release();
+            indexBuffers.erase(cached);
+        }
+        return;
+    }
+}
+
+//the vertex buffer is managed, so the GPU's writes only reach the CPU copy through a blit
+void Cloth::synchronizeBakedVertices(MTL::CommandBuffer *pCmd) {
+    if (this->_pBakeWriter == nullptr) return;
+    MTL::BlitCommandEncoder *pBEnc = pCmd->blitCommandEncoder();
+    pBEnc->synchronizeResource(this->_pVertexBuffer);
+    pBEnc->endEncoding();
+}
+
+//the renderer has waited for the update by now, so the synchronized vertices are complete
 void Cloth::updateGeometry() {
     this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
-}
\ No newline at end of file
+    if (this->_pBakeWriter != nullptr) {
+        this->_pBakeWriter->addFrame((const pfloat3*)this->_pVertexBuffer->contents());
+    }
+}
+
+void Cloth::updateXpbd(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+    unsigned int iterations = getXpbdSubsteps(dt);
+    float fdt = dt / iterations;
+    unsigned int projectGroupWidth = this->_pProjectPipelineState->threadExecutionWidth();
+    MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
+    pCEnc->setBytes(&fdt, sizeof(float), 0);
+    pAccelerationStructure->bind(pCEnc, 1);
+    pCEnc->setIntersectionFunctionTable(this->_pIntersectionFunctionTable, 2);
+    uint32_t sceneInstanceId = pAccelerationStructure->getInstanceId(this);
+    pCEnc->setBytes(&sceneInstanceId, sizeof(uint32_t), 7);
+    pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+    pCEnc->setBuffer(this->_pDataBuffer, 0, 4);
+    pCEnc->setBuffer(this->_pVertexBuffer, 0, 5);
+    pCEnc->setBytes(&enable, sizeof(bool), 8);
+    this->_pWindTextures->bind(pCEnc);
+    this->_pAttachmentBuffers->bind(pCEnc, dt, moveDirection);
+    pCEnc->setBuffer(this->_pPredictedPositionBuffer, 0, 10);
+    pCEnc->setBuffer(this->_pConstraintBuffer, 0, 11);
+    for (int i = 0; i < iterations; i++) {
+        this->encodeSelfCollision(pCEnc);
+        this->encodeTriangleDrag(pCEnc);
+        this->_pPredictPipelineState->dispatch(pCEnc);
+        this->_pAttachmentBuffers->dispatch(pCEnc, (i + 1.0f) / iterations);
+
+        //one dispatch per color; the encoder orders them, so a color always sees the positions the previous one wrote
+        pCEnc->setComputePipelineState(this->_pProjectPipelineState);
+        for (int color = 0; color + 1 < this->_colorStarts.size(); color++) {
+            simd::uint2 colorRange = simd::uint2{this->_colorStarts[color], this->_colorStarts[color + 1] - this->_colorStarts[color]};
+            pCEnc->setBytes(&colorRange, sizeof(simd::uint2), 12);
+            pCEnc->dispatchThreadgroups(MTL::Size::Make((colorRange.y + projectGroupWidth - 1) / projectGroupWidth, 1, 1), MTL::Size::Make(projectGroupWidth, 1, 1));
+        }
+
+        bool finalIteration = i == iterations - 1;
+        pCEnc->setBytes(&finalIteration, sizeof(bool), 6);
+        pCEnc->setComputePipelineState(this->_pComputeClothPipelineState);
+        pCEnc->dispatchThreadgroups(this->_clothTPG, this->_clothTPT);
+    }
+    this->_pAttachmentBuffers->endFrame();
+    this->_pNormalsPipelineState->dispatch(pCEnc);
+    pCEnc->endEncoding();
+    this->synchronizeBakedVertices(pCmd);
+}
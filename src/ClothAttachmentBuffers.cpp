@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstring>
+#include "ClothAttachmentBuffers.hpp"
+
+ClothAttachmentBuffers::ClothAttachmentBuffers(MTL::Device *pDevice, MTL::Function *pFunction, uint32_t particleCount) : _attachments(particleCount) {
+    NS::Error *err = nullptr;
+    this->_pDevice = pDevice;
+    this->_pPipelineState = pDevice->newComputePipelineState(pFunction, &err);
+    assertNSError(err);
+    this->_pHardParticleBuffer = pDevice->newBuffer(particleCount * sizeof(uint8_t), MTL::ResourceStorageModeManaged);
+    this->setAttachments({});
+}
+
+ClothAttachmentBuffers::~ClothAttachmentBuffers() {
+    this->_pPipelineState->release();
+    this->_pAttachmentBuffer->release();
+    this->_pHardParticleBuffer->release();
+    if (this->_pHandleBuffer) this->_pHandleBuffer->release();
+}
+
+//the renderer waits for every update's command buffer, so no pass still reads the buffers being replaced
+void ClothAttachmentBuffers::setAttachments(const std::vector<Attachment> &attachments) {
+    this->_attachments.setAttachments(attachments);
+    if (this->_pAttachmentBuffer) this->_pAttachmentBuffer->release();
+    //a buffer cannot be empty, so a cloth without attachments keeps one unused entry
+    this->_pAttachmentBuffer = this->_pDevice->newBuffer(std::max(1u, this->_attachments.getAttachmentCount()) * sizeof(Attachment), MTL::ResourceStorageModeManaged);
+    memcpy(this->_pAttachmentBuffer->contents(), this->_attachments.getAttachments().data(), this->_attachments.getAttachmentCount() * sizeof(Attachment));
+    this->_pAttachmentBuffer->didModifyRange(NS::Range::Make(0, this->_pAttachmentBuffer->length()));
+
+    const std::vector<uint8_t> &hardParticles = this->_attachments.getHardParticles();
+    memcpy(this->_pHardParticleBuffer->contents(), hardParticles.data(), hardParticles.size());
+    this->_pHardParticleBuffer->didModifyRange(NS::Range::Make(0, this->_pHardParticleBuffer->length()));
+}
+
+void ClothAttachmentBuffers::setHandleTransform(uint32_t handle, simd::float4x4 transform) {
+    this->_attachments.setHandleTransform(handle, transform);
+}
+
+const ClothAttachments& ClothAttachmentBuffers::getAttachments() {
+    return this->_attachments;
+}
+
+void ClothAttachmentBuffers::bind(MTL::ComputeCommandEncoder *pCEnc, float dt, simd::float3 moveDirection) {
+    this->_attachments.translateHandle(0, dt * moveDirection);
+    const std::vector<simd::float4x4> &handles = this->_attachments.getHandleTransforms();
+    size_t length = handles.size() * sizeof(simd::float4x4);
+    if (this->_pHandleBuffer == nullptr || this->_pHandleBuffer->length() < length) {
+        if (this->_pHandleBuffer) this->_pHandleBuffer->release();
+        this->_pHandleBuffer = this->_pDevice->newBuffer(length, MTL::ResourceStorageModeShared);
+    }
+    memcpy(this->_pHandleBuffer->contents(), handles.data(), length);
+
+    pCEnc->setBuffer(this->_pAttachmentBuffer, 0, 27);
+    pCEnc->setBuffer(this->_pHandleBuffer, 0, 29);
+    pCEnc->setBuffer(this->_pHardParticleBuffer, 0, 30);
+}
+
+void ClothAttachmentBuffers::dispatch(MTL::ComputeCommandEncoder *pCEnc, float fraction) {
+    uint32_t attachmentCount = this->_attachments.getAttachmentCount();
+    if (attachmentCount == 0) return;
+    AttachmentStep step = AttachmentStep{
+        .attachmentCount = attachmentCount,
+        .fraction = fraction
+    };
+    unsigned int groupWidth = this->_pPipelineState->maxTotalThreadsPerThreadgroup();
+    pCEnc->setBytes(&step, sizeof(AttachmentStep), 28);
+    pCEnc->setComputePipelineState(this->_pPipelineState);
+    pCEnc->dispatchThreadgroups(MTL::Size::Make((attachmentCount + groupWidth - 1) / groupWidth, 1, 1), MTL::Size::Make(groupWidth, 1, 1));
+}
+
+void ClothAttachmentBuffers::endFrame() {
+    this->_attachments.endFrame();
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cfloat>
+#include "simulation/ClothAttachments.hpp"
+
+ClothAttachments::ClothAttachments(uint32_t particleCount) {
+    this->_hard.assign(particleCount, 0);
+    this->addHandles(1);
+}
+
+void ClothAttachments::setAttachments(const std::vector<Attachment> &attachments) {
+    for (const Attachment &attachment: this->_attachments) this->_hard[attachment.particle] = 0;
+    this->_attachments = attachments;
+    std::sort(this->_attachments.begin(), this->_attachments.end(), [](const Attachment &a, const Attachment &b) {
+        return a.particle < b.particle;
+    });
+    for (const Attachment &attachment: this->_attachments) {
+        this->_hard[attachment.particle] = attachment.stiffness >= ATTACHMENT_HARD;
+        this->addHandles(attachment.handle + 1);
+    }
+}
+
+void ClothAttachments::setParticleCount(uint32_t particleCount) {
+    this->_hard.resize(particleCount, 0);
+}
+
+uint32_t ClothAttachments::findAttachment(uint32_t particle) const {
+    return std::lower_bound(this->_attachments.begin(), this->_attachments.end(), particle, [](const Attachment &attachment, uint32_t particle) {
+        return attachment.particle < particle;
+    }) - this->_attachments.begin();
+}
+
+uint32_t ClothAttachments::getHandleCount() const {
+    return this->_transforms.size() / 2;
+}
+
+void ClothAttachments::setHandleTransform(uint32_t handle, simd::float4x4 transform) {
+    this->addHandles(handle + 1);
+    this->_transforms[2 * handle + 1] = transform;
+}
+
+simd::float4x4 ClothAttachments::getHandleTransform(uint32_t handle) const {
+    return this->_transforms[2 * handle + 1];
+}
+
+void ClothAttachments::translateHandle(uint32_t handle, simd::float3 offset) {
+    this->addHandles(handle + 1);
+    simd::float4 &translation = this->_transforms[2 * handle + 1].columns[3];
+    translation = simd_make_float4(simd_make_float3(translation) + offset, translation.w);
+}
+
+bool ClothAttachments::isHandleMoving(uint32_t handle) const {
+    const simd::float4x4 &start = this->_transforms[2 * handle], &end = this->_transforms[2 * handle + 1];
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            if (start.columns[column][row] != end.columns[column][row]) return true;
+        }
+    }
+    return false;
+}
+
+simd::float3 ClothAttachments::getTarget(const Attachment &attachment, float fraction) const {
+    simd::float4 localPosition = simd_make_float4(attachment.localPosition, 1);
+    simd::float3 start = simd_make_float3(simd_mul(this->_transforms[2 * attachment.handle], localPosition));
+    simd::float3 end = simd_make_float3(simd_mul(this->_transforms[2 * attachment.handle + 1], localPosition));
+    return start + fraction * (end - start);
+}
+
+void ClothAttachments::endFrame() {
+    for (uint32_t handle = 0; handle < this->getHandleCount(); handle++) {
+        this->_transforms[2 * handle] = this->_transforms[2 * handle + 1];
+    }
+}
+
+void ClothAttachments::addHandles(uint32_t handleCount) {
+    if (this->getHandleCount() < handleCount) this->_transforms.resize(2 * handleCount, matrix_identity_float4x4);
+}
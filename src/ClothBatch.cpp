@@ -0,0 +1,189 @@
+#include <algorithm>
+#include "SceneAccelerationStructure.hpp"
+#include "sceneobjects/ClothBatch.hpp"
+
+ClothBatch::ClothBatch(MTL::Device *pDevice, const std::vector<ClothDescription> &descriptions) {
+    this->_descriptions = descriptions;
+    this->_instanceCount = descriptions.size();
+
+    NS::Error *err = nullptr;
+
+    //lay the cloths out back to back; each keeps its own grid, so indices only need shifting by the particle offset
+    std::vector<ClothInstance> instances;
+    uint32_t particleTotal = 0, triangleTotal = 0;
+    for (const ClothDescription &description: descriptions) {
+        instances.push_back(ClothInstance{
+            .particleOffset = particleTotal,
+            .triangleOffset = triangleTotal,
+            .parameters = makeClothParameters(description.size, description.particleCount, description.unitMass, description.springConstant, description.dampingConstant)
+        });
+        particleTotal += description.particleCount * description.particleCount;
+        triangleTotal += 2 * (description.particleCount - 1) * (description.particleCount - 1);
+    }
+
+    std::vector<Particle> particles(particleTotal);
+    std::vector<uint32_t> indices(3 * triangleTotal);
+    std::vector<PrimitiveData> primitiveData(triangleTotal);
+    std::vector<pfloat3> vertices(particleTotal);
+    std::vector<Attachment> attachments;
+    for (uint32_t i = 0; i < descriptions.size(); i++) {
+        const ClothDescription &description = descriptions[i];
+        const ClothInstance &instance = instances[i];
+        uint32_t *clothIndices = indices.data() + 3 * instance.triangleOffset;
+        Particle *clothParticles = particles.data() + instance.particleOffset;
+        uint32_t particleCount = description.particleCount * description.particleCount;
+
+        generateClothIndices(description.particleCount, clothIndices);
+        generateClothParticles(description.size, description.particleCount, clothParticles);
+        for (uint32_t j = 0; j < 6 * (description.particleCount - 1) * (description.particleCount - 1); j++) {
+            clothIndices[j] += instance.particleOffset;
+        }
+        for (uint32_t j = 0; j < particleCount; j++) {
+            clothParticles[j].position += description.offset;
+            simd::float3 position = clothParticles[j].position;
+            vertices[instance.particleOffset + j] = pfloat3{position.x, position.y, position.z};
+        }
+        for (Attachment attachment: generateClothAttachments(description.particleCount, clothParticles)) {
+            attachment.particle += instance.particleOffset;
+            attachments.push_back(attachment);
+        }
+    }
+
+    //parameters come from the instance table, so no function constants are needed and one compile serves any mix of cloths
+    MTL::IntersectionFunctionDescriptor *pIntersectFunctionDescriptor = MTL::IntersectionFunctionDescriptor::alloc()->init();
+    pIntersectFunctionDescriptor->setName(NS::String::string("intersectIgnoreClothTriangles", NS::UTF8StringEncoding));
+
+    MTL::Library *pLibrary = pDevice->newDefaultLibrary();
+    MTL::Function *pClothFunction = pLibrary->newFunction(NS::String::string("simulateClothBatchKernel", NS::UTF8StringEncoding));
+    MTL::Function *pNormalsFunction = pLibrary->newFunction(NS::String::string("recalculateClothBatchNormalsKernel", NS::UTF8StringEncoding));
+    MTL::Function *pTriangleDragFunction = pLibrary->newFunction(NS::String::string("computeClothTriangleDragKernel", NS::UTF8StringEncoding));
+    MTL::Function *pAttachmentFunction = pLibrary->newFunction(NS::String::string("applyClothBatchAttachmentsKernel", NS::UTF8StringEncoding));
+    MTL::Function *pIntersectFunction = pLibrary->newIntersectionFunction(pIntersectFunctionDescriptor, &err);
+
+    MTL::ComputePipelineDescriptor *pComputeClothPipelineDescriptor = MTL::ComputePipelineDescriptor::alloc()->init();
+    MTL::LinkedFunctions *pLinkedIntersectionFunctions = MTL::LinkedFunctions::alloc()->init();
+    const NS::Object *pIntersectionFunctions = {pIntersectFunction};
+    NS::Array *pIntersectionFunctionsArray = NS::Array::alloc()->init(&pIntersectionFunctions, NS::UInteger(1));
+    pLinkedIntersectionFunctions->setFunctions(pIntersectionFunctionsArray);
+    pComputeClothPipelineDescriptor->setComputeFunction(pClothFunction);
+    pComputeClothPipelineDescriptor->setLinkedFunctions(pLinkedIntersectionFunctions);
+
+    this->_pComputeClothPipelineState = pDevice->newComputePipelineState(pComputeClothPipelineDescriptor, MTL::PipelineOptionNone, nullptr, &err);
+    assertNSError(err);
+    unsigned int clothGroupWidth = this->_pComputeClothPipelineState->maxTotalThreadsPerThreadgroup();
+    this->_clothTPG = MTL::Size::Make((particleTotal + clothGroupWidth - 1) / clothGroupWidth, 1, 1);
+    this->_clothTPT = MTL::Size::Make(clothGroupWidth, 1, 1);
+    this->_pNormalsPipelineState = new ComputePipelineState(pDevice, pNormalsFunction, MTL::Size::Make(particleTotal, 1, 1));
+    this->_pTriangleDragPipelineState = new ComputePipelineState(pDevice, pTriangleDragFunction, MTL::Size::Make(triangleTotal, 1, 1));
+
+    MTL::IntersectionFunctionTableDescriptor *pIntersectionFunctionTableDescriptor = MTL::IntersectionFunctionTableDescriptor::alloc()->init();
+    MTL::FunctionHandle *pIntersectFunctionHandle = this->_pComputeClothPipelineState->functionHandle(pIntersectFunction);
+    pIntersectionFunctionTableDescriptor->setFunctionCount(1);
+    this->_pIntersectionFunctionTable = this->_pComputeClothPipelineState->newIntersectionFunctionTable(pIntersectionFunctionTableDescriptor);
+    this->_pIntersectionFunctionTable->setFunction(pIntersectFunctionHandle, 0);
+
+    this->_pInstanceBuffer = pDevice->newBuffer(instances.data(), instances.size() * sizeof(ClothInstance), MTL::ResourceStorageModeManaged);
+    this->_pVertexBuffer = pDevice->newBuffer(vertices.data(), vertices.size() * sizeof(pfloat3), MTL::ResourceStorageModeManaged);
+    this->_pIndexBuffer = pDevice->newBuffer(indices.data(), indices.size() * sizeof(uint32_t), MTL::ResourceStorageModeManaged);
+    this->_pDataBuffer = pDevice->newBuffer(primitiveData.data(), primitiveData.size() * sizeof(PrimitiveData), MTL::ResourceStorageModeManaged);
+    this->_pParticleBuffer = pDevice->newBuffer(particles.data(), particles.size() * sizeof(Particle), MTL::ResourceStorageModeManaged);
+    this->_pNextParticleBuffer = pDevice->newBuffer(this->_pParticleBuffer->length(), MTL::ResourceStorageModePrivate);
+    this->_pTriangleDragBuffer = pDevice->newBuffer(triangleTotal * sizeof(simd::float3), MTL::ResourceStorageModePrivate);
+    this->_pWindTextures = new WindTextures(pDevice);
+    this->_pAttachmentBuffers = new ClothAttachmentBuffers(pDevice, pAttachmentFunction, particleTotal);
+    this->_pAttachmentBuffers->setAttachments(attachments);
+    this->_triangleCount = triangleTotal;
+
+    this->getDescriptor()->setTriangleCount(triangleTotal);
+    this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
+    this->getDescriptor()->setIndexBuffer(this->_pIndexBuffer);
+    this->getDescriptor()->setPrimitiveDataBuffer(this->_pDataBuffer);
+    this->getDescriptor()->setPrimitiveDataStride(sizeof(PrimitiveData));
+    this->getDescriptor()->setPrimitiveDataElementSize(sizeof(PrimitiveData));
+    this->getDescriptor()->setIntersectionFunctionTableOffset(0);
+
+    pIntersectFunctionDescriptor->release();
+    pLibrary->release();
+    pClothFunction->release();
+    pNormalsFunction->release();
+    pTriangleDragFunction->release();
+    pAttachmentFunction->release();
+    pIntersectFunction->release();
+    pComputeClothPipelineDescriptor->release();
+    pLinkedIntersectionFunctions->release();
+    pIntersectionFunctionsArray->release();
+    pIntersectionFunctionTableDescriptor->release();
+    pIntersectFunctionHandle->release();
+}
+
+ClothBatch::~ClothBatch() {
+    delete this->_pNormalsPipelineState;
+    delete this->_pTriangleDragPipelineState;
+    delete this->_pWindTextures;
+    delete this->_pAttachmentBuffers;
+    this->_pComputeClothPipelineState->release();
+    this->_pIntersectionFunctionTable->release();
+    for (MTL::Buffer *pBuffer: {
+        this->_pInstanceBuffer, this->_pVertexBuffer, this->_pIndexBuffer, this->_pDataBuffer, this->_pParticleBuffer, this->_pNextParticleBuffer,
+        this->_pTriangleDragBuffer
+    }) {
+        pBuffer->release();
+    }
+}
+
+//every cloth advances by the same substep, so the stiffest and densest cloth of the batch sets it for all of them
+void ClothBatch::update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+    unsigned int iterations = 1;
+    for (const ClothDescription &description: this->_descriptions) {
+        iterations = std::max(iterations, getClothSubsteps(description.springConstant, description.size, description.particleCount, dt));
+    }
+    float fdt = dt / iterations;
+    MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
+    pCEnc->setBytes(&fdt, sizeof(float), 0);
+    pAccelerationStructure->bind(pCEnc, 1);
+    pCEnc->setIntersectionFunctionTable(this->_pIntersectionFunctionTable, 2);
+    uint32_t sceneInstanceId = pAccelerationStructure->getInstanceId(this);
+    pCEnc->setBytes(&sceneInstanceId, sizeof(uint32_t), 7);
+    pCEnc->setBuffer(this->_pDataBuffer, 0, 4);
+    pCEnc->setBuffer(this->_pVertexBuffer, 0, 5);
+    pCEnc->setBytes(&enable, sizeof(bool), 8);
+    this->_pWindTextures->bind(pCEnc);
+    this->_pAttachmentBuffers->bind(pCEnc, dt, moveDirection);
+    pCEnc->setBuffer(this->_pInstanceBuffer, 0, 22);
+    pCEnc->setBytes(&this->_instanceCount, sizeof(uint32_t), 23);
+    //the index arena holds particle indices across the whole batch, so one drag pass covers every cloth
+    pCEnc->setBuffer(this->_pIndexBuffer, 0, 14);
+    pCEnc->setBuffer(this->_pTriangleDragBuffer, 0, 24);
+    pCEnc->setBytes(&this->_triangleCount, sizeof(uint32_t), 25);
+    for (uint32_t i = 0; i < iterations; i++) {
+        bool finalIteration = i == iterations - 1;
+        pCEnc->setBytes(&finalIteration, sizeof(bool), 6);
+        pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+        pCEnc->setBuffer(this->_pNextParticleBuffer, 0, 9);
+        std::swap(this->_pParticleBuffer, this->_pNextParticleBuffer);
+        this->_pTriangleDragPipelineState->dispatch(pCEnc);
+        pCEnc->setComputePipelineState(this->_pComputeClothPipelineState);
+        pCEnc->dispatchThreadgroups(this->_clothTPG, this->_clothTPT);
+        pCEnc->setBuffer(this->_pParticleBuffer, 0, 3);
+        this->_pAttachmentBuffers->dispatch(pCEnc, (i + 1.0f) / iterations);
+    }
+    this->_pAttachmentBuffers->endFrame();
+    this->_pNormalsPipelineState->dispatch(pCEnc);
+    pCEnc->endEncoding();
+}
+
+void ClothBatch::setWindField(const WindField *pWindField) {
+    this->_pWindTextures->setWindField(pWindField);
+}
+
+void ClothBatch::setAttachments(const std::vector<Attachment> &attachments) {
+    this->_pAttachmentBuffers->setAttachments(attachments);
+}
+
+void ClothBatch::setHandleTransform(uint32_t handle, simd::float4x4 transform) {
+    this->_pAttachmentBuffers->setHandleTransform(handle, transform);
+}
+
+void ClothBatch::updateGeometry() {
+    this->getDescriptor()->setVertexBuffer(this->_pVertexBuffer);
+}
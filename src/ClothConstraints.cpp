@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cmath>
+#include "simulation/ClothConstraints.hpp"
+
+uint32_t getXpbdSubsteps(float dt) {
+    return std::max(1.0f, std::ceil(dt / XPBD_SUBSTEP));
+}
+
+std::vector<DistanceConstraint> buildClothConstraints(const ClothParameters &params) {
+    const int n = params.particleCount;
+    //right, down-left, down and down-right cover every undirected neighbour exactly once
+    const int offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    std::vector<DistanceConstraint> constraints;
+    for (int distance = 1; distance <= 2; distance++) {
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                for (const int *offset: offsets) {
+                    int nx = x + offset[0] * distance, ny = y + offset[1] * distance;
+                    if (nx < 0 || nx >= n || ny >= n) continue;
+                    float springLength = offset[0] != 0 && offset[1] != 0 ? params.diagonalSpringLength : params.sideSpringLength;
+                    constraints.push_back(DistanceConstraint{
+                        .particleA = (uint32_t)(y * n + x),
+                        .particleB = (uint32_t)(ny * n + nx),
+                        .restLength = distance * springLength
+                    });
+                }
+            }
+        }
+    }
+    return constraints;
+}
+
+std::vector<uint32_t> colorConstraints(std::vector<DistanceConstraint> &constraints, uint32_t particleCount) {
+    //bit c of a particle's words is set once a constraint of color c touches it; a grid particle has 16 constraints,
+    //but a mesh vertex can have any number, so every particle gets another word whenever the colors outgrow them
+    uint32_t wordCount = 1;
+    std::vector<uint64_t> usedColors(particleCount, 0);
+    std::vector<uint32_t> colors(constraints.size());
+    uint32_t colorCount = 0;
+    for (uint32_t i = 0; i < constraints.size(); i++) {
+        const uint64_t *usedA = &usedColors[wordCount * constraints[i].particleA];
+        const uint64_t *usedB = &usedColors[wordCount * constraints[i].particleB];
+        uint32_t color = 0;
+        while (color < 64 * wordCount && ((usedA[color / 64] | usedB[color / 64]) >> color % 64) & 1) color++;
+        if (color == 64 * wordCount) {
+            std::vector<uint64_t> grown((wordCount + 1) * particleCount, 0);
+            for (uint32_t particle = 0; particle < particleCount; particle++) {
+                std::copy_n(&usedColors[wordCount * particle], wordCount, &grown[(wordCount + 1) * particle]);
+            }
+            usedColors = std::move(grown);
+            wordCount++;
+        }
+        colors[i] = color;
+        colorCount = std::max(colorCount, color + 1);
+        usedColors[wordCount * constraints[i].particleA + color / 64] |= 1ull << color % 64;
+        usedColors[wordCount * constraints[i].particleB + color / 64] |= 1ull << color % 64;
+    }
+
+    //counting sort by color keeps the original order within each batch
+    std::vector<uint32_t> colorStarts(colorCount + 1, 0);
+    for (uint32_t color: colors) colorStarts[color + 1]++;
+    for (uint32_t color = 0; color < colorCount; color++) colorStarts[color + 1] += colorStarts[color];
+    std::vector<DistanceConstraint> sorted(constraints.size());
+    std::vector<uint32_t> next(colorStarts.begin(), colorStarts.end() - 1);
+    for (uint32_t i = 0; i < constraints.size(); i++) {
+        sorted[next[colors[i]]++] = constraints[i];
+    }
+    constraints = sorted;
+    return colorStarts;
+}
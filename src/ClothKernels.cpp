@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "simulation/ClothKernels.hpp"
+#include "simulation/FloatBatch.hpp"
+
+//the scalar functions below mirror shaders/Simulation.metal and handle the grid border, where some neighbours are missing
+//the grid ones are templates on the side length N, like the particleCount function constant of simulateClothKernel, so
+//an instantiation for a known size folds the row length and the border tests into constants; N = 0 reads the side
+//length from the parameters at run time
+template <uint32_t N>
+static inline uint32_t getGridSize(const ClothParameters &params) {
+    return N > 0 ? N : params.particleCount;
+}
+
+static bool isFinite(simd::float3 v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+static void applyGravity(simd::float3 &acceleration) {
+    acceleration += simd::float3{0, -1, 0};
+}
+
+static void applySpring(const ClothParameters &params, simd::float3 &acceleration, simd::float3 direction, float distance, float springLength) {
+    simd::float3 da = -params.springConstant * (springLength - distance) * direction / params.particleMass;
+    acceleration += da / 2;
+}
+
+static void applyDamper(const ClothParameters &params, simd::float3 &acceleration, simd::float3 direction, simd::float3 closingVelocity) {
+    simd::float3 da = -params.dampingConstant * simd::dot(closingVelocity, direction) * direction / params.particleMass;
+    acceleration += da / 2;
+}
+
+static void applySpringDamper(const ClothParameters &params, simd::float3 &acceleration, const ClothState &state, uint32_t indexA, uint32_t indexB, float springLength) {
+    simd::float3 displacement = state.getPosition(indexB) - state.getPosition(indexA);
+    float distance = simd::length(displacement);
+    simd::float3 direction = simd::normalize(displacement);
+    direction = isFinite(direction) ? direction : simd::float3{};
+    simd::float3 closingVelocity = state.getVelocity(indexA) - state.getVelocity(indexB);
+    applySpring(params, acceleration, direction, distance, springLength);
+    applyDamper(params, acceleration, direction, closingVelocity);
+}
+
+template <uint32_t N>
+static void applyClothSpringDampers(const ClothParameters &params, simd::float3 &acceleration, uint32_t x, uint32_t y, const ClothState &state, uint32_t index, uint32_t distance) {
+    const uint32_t n = getGridSize<N>(params);
+    float side = distance * params.sideSpringLength, diagonal = distance * params.diagonalSpringLength;
+    if (x >= distance) applySpringDamper(params, acceleration, state, index, index - distance, side);
+    if (y >= distance) applySpringDamper(params, acceleration, state, index, index - distance * n, side);
+    if (x < n - distance) applySpringDamper(params, acceleration, state, index, index + distance, side);
+    if (y < n - distance) applySpringDamper(params, acceleration, state, index, index + distance * n, side);
+    if (x >= distance && y >= distance) applySpringDamper(params, acceleration, state, index, index - distance * n - distance, diagonal);
+    if (x >= distance && y < n - distance) applySpringDamper(params, acceleration, state, index, index + distance * n - distance, diagonal);
+    if (x < n - distance && y >= distance) applySpringDamper(params, acceleration, state, index, index - distance * n + distance, diagonal);
+    if (x < n - distance && y < n - distance) applySpringDamper(params, acceleration, state, index, index + distance * n + distance, diagonal);
+}
+
+//the field's wind at position, or the constant breeze the cloth had before wind fields when none is set
+static inline simd::float3 getWind(bool enableWind, const WindField *pWindField, simd::float3 position) {
+    if (!enableWind) return simd::float3{};
+    return pWindField ? pWindField->sample(position) : simd::float3{0, 0, 2};
+}
+
+//bounds the speed of the air relative to a particle moving at velocity anywhere in the field
+static inline float getRelativeWindSpeed(bool enableWind, const WindField *pWindField, simd::float3 velocity) {
+    if (!enableWind) return simd::length(velocity);
+    if (!pWindField) return simd::length(velocity - simd::float3{0, 0, 2});
+    WindParameters wind = pWindField->getParameters();
+    return simd::length(velocity - wind.meanWind) + wind.gustSpeed;
+}
+
+static simd::float3 getTriangleDrag(simd::float3 positionA, simd::float3 positionB, simd::float3 positionC, simd::float3 surfaceVelocity, simd::float3 wind) {
+    simd::float3 longNormal = simd::cross(positionB - positionA, positionC - positionA);
+    simd::float3 normal = simd::normalize(longNormal);
+    simd::float3 dv = surfaceVelocity - wind;
+    if (simd::length(dv) < EPSILON) return simd::float3{};
+    float crossArea = simd::length(longNormal) / 2 * simd::dot(simd::normalize(dv), normal);
+    return -1.225f * simd::length_squared(dv) * 1.28f * crossArea * normal / 2;
+}
+
+template <uint32_t N>
+static void applyClothDrag(const ClothParameters &params, simd::float3 &acceleration, uint32_t x, uint32_t y, const ClothState &state) {
+    const uint32_t n = getGridSize<N>(params);
+    const simd::float3 *triangleDrag = state.triangleDrag.data();
+    uint32_t triangleIndex = y * (n - 1) + x;
+    simd::float3 drag = simd::float3{};
+    if (x > 0 && y > 0) {
+        drag += triangleDrag[2 * (triangleIndex - (n - 1) - 1) + 1];
+    }
+    if (x < n - 1 && y > 0) {
+        drag += triangleDrag[2 * (triangleIndex - (n - 1))];
+        drag += triangleDrag[2 * (triangleIndex - (n - 1)) + 1];
+    }
+    if (x < n - 1 && y < n - 1) {
+        drag += triangleDrag[2 * triangleIndex];
+    }
+    if (x > 0 && y < n - 1) {
+        drag += triangleDrag[2 * (triangleIndex - 1) + 1];
+        drag += triangleDrag[2 * (triangleIndex - 1)];
+    }
+    acceleration += drag / 3 / params.particleMass;
+}
+
+static simd::float3 getTriangleNormal(const ClothState &state, uint32_t indexA, uint32_t indexB, uint32_t indexC) {
+    simd::float3 positionA = state.getPosition(indexA);
+    return simd::normalize(simd::cross(state.getPosition(indexB) - positionA, state.getPosition(indexC) - positionA));
+}
+
+//FloatBatch::width consecutive particles of one row, loaded once and shared by all of their springs
+typedef struct ParticleBatch {
+    FloatBatch positionX, positionY, positionZ;
+    FloatBatch velocityX, velocityY, velocityZ;
+    FloatBatch accelerationX, accelerationY, accelerationZ;
+} ParticleBatch;
+
+static void applySpringDamperBatch(const ClothState &state, ParticleBatch &batch, uint32_t neighbour, FloatBatch springLength, FloatBatch springScale, FloatBatch damperScale) {
+    FloatBatch zero = FloatBatch::broadcast(0), one = FloatBatch::broadcast(1);
+    FloatBatch dx = FloatBatch::load(&state.positionX[neighbour]) - batch.positionX;
+    FloatBatch dy = FloatBatch::load(&state.positionY[neighbour]) - batch.positionY;
+    FloatBatch dz = FloatBatch::load(&state.positionZ[neighbour]) - batch.positionZ;
+    FloatBatch distance = sqrt(multiplyAdd(dx, dx, multiplyAdd(dy, dy, dz * dz)));
+    //coincident particles get no direction, like the isfinite check in applySpringDamper
+    FloatBatch inverseDistance = ifGreater(distance, zero, one / distance);
+    FloatBatch directionX = dx * inverseDistance, directionY = dy * inverseDistance, directionZ = dz * inverseDistance;
+    FloatBatch closingX = batch.velocityX - FloatBatch::load(&state.velocityX[neighbour]);
+    FloatBatch closingY = batch.velocityY - FloatBatch::load(&state.velocityY[neighbour]);
+    FloatBatch closingZ = batch.velocityZ - FloatBatch::load(&state.velocityZ[neighbour]);
+    FloatBatch closingSpeed = multiplyAdd(closingX, directionX, multiplyAdd(closingY, directionY, closingZ * directionZ));
+    //spring and damper accelerations both act along the direction, so they are folded into one scale
+    FloatBatch scale = springScale * (distance - springLength) - damperScale * closingSpeed;
+    batch.accelerationX = multiplyAdd(scale, directionX, batch.accelerationX);
+    batch.accelerationY = multiplyAdd(scale, directionY, batch.accelerationY);
+    batch.accelerationZ = multiplyAdd(scale, directionZ, batch.accelerationZ);
+}
+
+//every particle in the batch is at least distance away from the row ends, so only the row bounds need checking
+template <uint32_t N>
+static void applyClothSpringDampersBatch(const ClothParameters &params, const ClothState &state, ParticleBatch &batch, uint32_t y, uint32_t index, uint32_t distance) {
+    const uint32_t n = getGridSize<N>(params);
+    FloatBatch side = FloatBatch::broadcast(distance * params.sideSpringLength);
+    FloatBatch diagonal = FloatBatch::broadcast(distance * params.diagonalSpringLength);
+    FloatBatch springScale = FloatBatch::broadcast(params.springConstant / params.particleMass / 2);
+    FloatBatch damperScale = FloatBatch::broadcast(params.dampingConstant / params.particleMass / 2);
+    bool up = y >= distance, down = y < n - distance;
+    applySpringDamperBatch(state, batch, index - distance, side, springScale, damperScale);
+    if (up) applySpringDamperBatch(state, batch, index - distance * n, side, springScale, damperScale);
+    applySpringDamperBatch(state, batch, index + distance, side, springScale, damperScale);
+    if (down) applySpringDamperBatch(state, batch, index + distance * n, side, springScale, damperScale);
+    if (up) applySpringDamperBatch(state, batch, index - distance * n - distance, diagonal, springScale, damperScale);
+    if (down) applySpringDamperBatch(state, batch, index + distance * n - distance, diagonal, springScale, damperScale);
+    if (up) applySpringDamperBatch(state, batch, index - distance * n + distance, diagonal, springScale, damperScale);
+    if (down) applySpringDamperBatch(state, batch, index + distance * n + distance, diagonal, springScale, damperScale);
+}
+
+template <uint32_t N>
+static void accumulateParticleForces(const ClothParameters &params, ClothState &state, uint32_t x, uint32_t y) {
+    uint32_t index = y * getGridSize<N>(params) + x;
+    simd::float3 acceleration = simd::float3{};
+    applyGravity(acceleration);
+    applyClothSpringDampers<N>(params, acceleration, x, y, state, index, 1);
+    applyClothSpringDampers<N>(params, acceleration, x, y, state, index, 2);
+    applyClothDrag<N>(params, acceleration, x, y, state);
+    state.setAcceleration(index, acceleration);
+}
+
+template <uint32_t N>
+static void accumulateGridForces(const ClothParameters &params, ClothState &state, uint32_t y) {
+    const uint32_t n = getGridSize<N>(params);
+    const uint32_t border = 2;
+    uint32_t x = 0;
+    for (; x < border && x < n; x++) {
+        accumulateParticleForces<N>(params, state, x, y);
+    }
+    for (; x + FloatBatch::width + border <= n; x += FloatBatch::width) {
+        uint32_t index = y * n + x;
+        ParticleBatch batch = {
+            FloatBatch::load(&state.positionX[index]), FloatBatch::load(&state.positionY[index]), FloatBatch::load(&state.positionZ[index]),
+            FloatBatch::load(&state.velocityX[index]), FloatBatch::load(&state.velocityY[index]), FloatBatch::load(&state.velocityZ[index]),
+            FloatBatch::broadcast(0), FloatBatch::broadcast(-1), FloatBatch::broadcast(0)
+        };
+        applyClothSpringDampersBatch<N>(params, state, batch, y, index, 1);
+        applyClothSpringDampersBatch<N>(params, state, batch, y, index, 2);
+        batch.accelerationX.store(&state.accelerationX[index]);
+        batch.accelerationY.store(&state.accelerationY[index]);
+        batch.accelerationZ.store(&state.accelerationZ[index]);
+
+        for (uint32_t i = 0; i < FloatBatch::width; i++) {
+            simd::float3 acceleration = state.getAcceleration(index + i);
+            applyClothDrag<N>(params, acceleration, x + i, y, state);
+            state.setAcceleration(index + i, acceleration);
+        }
+    }
+    for (; x < n; x++) {
+        accumulateParticleForces<N>(params, state, x, y);
+    }
+}
+
+template <uint32_t N>
+static void accumulateGridExternalForces(const ClothParameters &params, ClothState &state, uint32_t y) {
+    const uint32_t n = getGridSize<N>(params);
+    for (uint32_t x = 0; x < n; x++) {
+        simd::float3 acceleration = simd::float3{};
+        applyGravity(acceleration);
+        applyClothDrag<N>(params, acceleration, x, y, state);
+        state.setAcceleration(y * n + x, acceleration);
+    }
+}
+
+void simulateClothMotion(ClothState &state, uint32_t begin, uint32_t end, float dt) {
+    for (uint32_t i = begin; i < end; i++) {
+        state.velocityX[i] += dt * state.accelerationX[i];
+        state.velocityY[i] += dt * state.accelerationY[i];
+        state.velocityZ[i] += dt * state.accelerationZ[i];
+        state.positionX[i] += dt * state.velocityX[i];
+        state.positionY[i] += dt * state.velocityY[i];
+        state.positionZ[i] += dt * state.velocityZ[i];
+        state.accelerationX[i] = 0;
+        state.accelerationY[i] = 0;
+        state.accelerationZ[i] = 0;
+    }
+}
+
+void applyClothAttachments(const ClothParameters &params, const ClothAttachments &attachments, ClothState &state, uint32_t begin, uint32_t end, float dt, float fraction) {
+    const std::vector<Attachment> &list = attachments.getAttachments();
+    for (uint32_t a = begin; a < end; a++) {
+        const Attachment &attachment = list[a];
+        //an implicit zero-length spring: the share of the gap closed in one substep tends to 1 as the stiffness grows,
+        //and reaches it exactly for ATTACHMENT_HARD
+        float share = 1 / (1 + params.particleMass / (attachment.stiffness * dt * dt));
+        simd::float3 correction = share * (attachments.getTarget(attachment, fraction) - state.getPosition(attachment.particle));
+        state.setPosition(attachment.particle, state.getPosition(attachment.particle) + correction);
+        state.setVelocity(attachment.particle, state.getVelocity(attachment.particle) + correction / dt);
+    }
+}
+
+void constrainClothCollision(CollisionDelegate *pCollisionDelegate, ClothState &state, const pfloat3 *previousPositions, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        simd::float3 previousPosition = simd::float3{previousPositions[i].x, previousPositions[i].y, previousPositions[i].z};
+        simd::float3 displacement = state.getPosition(i) - previousPosition;
+        simd::float3 direction = simd::normalize(displacement);
+        if (!isFinite(direction)) continue;
+        simd::float3 origin = previousPosition - EPSILON * direction;
+        float distance;
+        simd::float3 surfaceNormal;
+
+        if (pCollisionDelegate->intersect(origin, direction, simd::length(displacement) + EPSILON, previousPosition, distance, surfaceNormal)) {
+            simd::float3 velocity = state.getVelocity(i);
+            state.setVelocity(i, velocity + simd::dot(surfaceNormal, -velocity) * surfaceNormal);
+            state.setPosition(i, origin + distance * direction + 2 * EPSILON * surfaceNormal);
+        }
+    }
+}
+
+template <uint32_t N>
+static float getGridSubstepLimit(const ClothParameters &params, const ClothState &state, uint32_t y, bool enableWind, const WindField *pWindField) {
+    const uint32_t n = getGridSize<N>(params);
+    //no particle has more than 16 springs, which bounds the spring and damper rates from above
+    const float stiffnessRate = 16 * params.springConstant / params.particleMass;
+    const float damperRate = 16 * params.dampingConstant / params.particleMass;
+    const float dragScale = 1.225f * 1.28f * 6 * params.sideSpringLength * params.sideSpringLength / 2 / 3 / params.particleMass;
+
+    float limit = INFINITY;
+    for (uint32_t x = 0; x < n; x++) {
+        uint32_t index = y * n + x;
+        simd::float3 velocity = state.getVelocity(index);
+        float dampingRate = damperRate + dragScale * getRelativeWindSpeed(enableWind, pWindField, velocity);
+        float stabilityLimit = (sqrtf(dampingRate * dampingRate + 4 * stiffnessRate) - dampingRate) / stiffnessRate;
+
+        float strainRate = 0;
+        if (x > 0) strainRate = std::max(strainRate, simd::length(velocity - state.getVelocity(index - 1)));
+        if (y > 0) strainRate = std::max(strainRate, simd::length(velocity - state.getVelocity(index - n)));
+        if (x < n - 1) strainRate = std::max(strainRate, simd::length(velocity - state.getVelocity(index + 1)));
+        if (y < n - 1) strainRate = std::max(strainRate, simd::length(velocity - state.getVelocity(index + n)));
+        strainRate /= params.sideSpringLength;
+
+        limit = std::min(limit, std::min(SUBSTEP_SAFETY * stabilityLimit, STRAIN_CFL / strainRate));
+    }
+    return limit;
+}
+
+template <uint32_t N>
+static void recalculateGridNormals(const ClothParameters &params, const ClothState &state, uint32_t y, PrimitiveData *primitiveData) {
+    const uint32_t n = getGridSize<N>(params);
+    for (uint32_t x = 0; x < n; x++) {
+        uint32_t index = y * n + x;
+        uint32_t triangleIndex = y * (n - 1) + x;
+        simd::float3 averageNormal = simd::float3{};
+        if (x > 0 && y > 0) {
+            averageNormal += getTriangleNormal(state, index, index - 1, index - n);
+        }
+        if (x < n - 1 && y > 0) {
+            averageNormal += getTriangleNormal(state, index, index - n, index - n + 1);
+            averageNormal += getTriangleNormal(state, index, index - n + 1, index + 1);
+        }
+        if (x < n - 1 && y < n - 1) {
+            averageNormal += getTriangleNormal(state, index, index + 1, index + n);
+        }
+        if (x > 0 && y < n - 1) {
+            averageNormal += getTriangleNormal(state, index, index + n, index + n - 1);
+            averageNormal += getTriangleNormal(state, index, index + n - 1, index - 1);
+        }
+
+        averageNormal = simd::normalize(averageNormal);
+        if (x > 0 && y > 0) {
+            primitiveData[2 * (triangleIndex - (n - 1) - 1) + 1].v1Normal = averageNormal;
+        }
+        if (x < n - 1 && y > 0) {
+            primitiveData[2 * (triangleIndex - (n - 1))].v2Normal = averageNormal;
+            primitiveData[2 * (triangleIndex - (n - 1)) + 1].v2Normal = averageNormal;
+        }
+        if (x < n - 1 && y < n - 1) {
+            primitiveData[2 * triangleIndex + 0].v0Normal = averageNormal;
+        }
+        if (x > 0 && y < n - 1) {
+            primitiveData[2 * (triangleIndex - 1) + 1].v0Normal = averageNormal;
+            primitiveData[2 * (triangleIndex - 1)].v1Normal = averageNormal;
+        }
+    }
+}
+
+void accumulateClothForces(const ClothParameters &params, ClothState &state, uint32_t y) {
+    accumulateGridForces<0>(params, state, y);
+}
+
+void accumulateClothExternalForces(const ClothParameters &params, ClothState &state, uint32_t y) {
+    accumulateGridExternalForces<0>(params, state, y);
+}
+
+float getClothSubstepLimit(const ClothParameters &params, const ClothState &state, uint32_t y, bool enableWind, const WindField *pWindField) {
+    return getGridSubstepLimit<0>(params, state, y, enableWind, pWindField);
+}
+
+void recalculateClothNormals(const ClothParameters &params, const ClothState &state, uint32_t y, PrimitiveData *primitiveData) {
+    recalculateGridNormals<0>(params, state, y, primitiveData);
+}
+
+template <uint32_t N>
+static ClothGridKernels makeClothGridKernels() {
+    return ClothGridKernels{
+        .particleCount = N,
+        .accumulateForces = accumulateGridForces<N>,
+        .accumulateExternalForces = accumulateGridExternalForces<N>,
+        .getSubstepLimit = getGridSubstepLimit<N>,
+        .recalculateNormals = recalculateGridNormals<N>
+    };
+}
+
+//TestScene's cloth and the benchmark's grid sizes
+ClothGridKernels getClothGridKernels(uint32_t particleCount) {
+    switch (particleCount) {
+        case 20: return makeClothGridKernels<20>();
+        case 64: return makeClothGridKernels<64>();
+        case 128: return makeClothGridKernels<128>();
+        case 256: return makeClothGridKernels<256>();
+        case 512: return makeClothGridKernels<512>();
+        case 1024: return makeClothGridKernels<1024>();
+        default: return makeClothGridKernels<0>();
+    }
+}
+
+void computeClothTriangleDrag(const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end, bool enableWind, const WindField *pWindField) {
+    for (uint32_t t = begin; t < end; t++) {
+        uint32_t a = topology.indices[3 * t], b = topology.indices[3 * t + 1], c = topology.indices[3 * t + 2];
+        simd::float3 positionA = state.getPosition(a), positionB = state.getPosition(b), positionC = state.getPosition(c);
+        simd::float3 surfaceVelocity = (state.getVelocity(a) + state.getVelocity(b) + state.getVelocity(c)) / 3;
+        simd::float3 wind = getWind(enableWind, pWindField, (positionA + positionB + positionC) / 3);
+        state.triangleDrag[t] = getTriangleDrag(positionA, positionB, positionC, surfaceVelocity, wind);
+    }
+}
+
+//a third of the drag of every triangle around the particle, as applyClothDrag gathers on a grid
+static void applyTopologyDrag(const ClothParameters &params, const ClothTopology &topology, simd::float3 &acceleration, const ClothState &state, uint32_t index) {
+    simd::float3 drag = simd::float3{};
+    for (uint32_t entry = topology.getTriangleStart(index); entry < topology.getTriangleEnd(index); entry++) {
+        drag += state.triangleDrag[ClothTopology::getTriangle(topology.triangleCorners[entry])];
+    }
+    acceleration += drag / 3 / params.particleMass;
+}
+
+void accumulateClothForces(const ClothParameters &params, const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end) {
+    const float springScale = params.springConstant / params.particleMass / 2;
+    const float damperScale = params.dampingConstant / params.particleMass / 2;
+    const uint32_t *neighbours = topology.springNeighbours.data();
+    const float *restLengths = topology.springRestLengths.data();
+    const float *positionX = state.positionX.data(), *positionY = state.positionY.data(), *positionZ = state.positionZ.data();
+    const float *velocityX = state.velocityX.data(), *velocityY = state.velocityY.data(), *velocityZ = state.velocityZ.data();
+
+    for (uint32_t i = begin; i < end; i++) {
+        //plain float sums over the row so the loop stays a gather the compiler can vectorize, see applySpringDamperBatch
+        float x = positionX[i], y = positionY[i], z = positionZ[i];
+        float vx = velocityX[i], vy = velocityY[i], vz = velocityZ[i];
+        float ax = 0, ay = 0, az = 0;
+        const uint32_t first = topology.getSpringStart(i), last = topology.getSpringEnd(i);
+        for (uint32_t spring = first; spring < last; spring++) {
+            uint32_t j = neighbours[spring];
+            float dx = positionX[j] - x, dy = positionY[j] - y, dz = positionZ[j] - z;
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+            //a select and a clamped divide rather than a branch, which would stop the loop from vectorizing
+            float inverseDistance = (distance > 0 ? 1.0f : 0.0f) / std::max(distance, FLT_MIN);
+            float closingSpeed = ((vx - velocityX[j]) * dx + (vy - velocityY[j]) * dy + (vz - velocityZ[j]) * dz) * inverseDistance;
+            float scale = (springScale * (distance - restLengths[spring]) - damperScale * closingSpeed) * inverseDistance;
+            ax += scale * dx;
+            ay += scale * dy;
+            az += scale * dz;
+        }
+
+        simd::float3 acceleration = simd::float3{ax, ay, az};
+        applyGravity(acceleration);
+        applyTopologyDrag(params, topology, acceleration, state, i);
+        state.setAcceleration(i, acceleration);
+    }
+}
+
+void accumulateClothExternalForces(const ClothParameters &params, const ClothTopology &topology, ClothState &state, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        simd::float3 acceleration = simd::float3{};
+        applyGravity(acceleration);
+        applyTopologyDrag(params, topology, acceleration, state, i);
+        state.setAcceleration(i, acceleration);
+    }
+}
+
+//the grid bound with the topology's own spring count, and the strain measured along every spring against its rest length
+float getClothSubstepLimit(const ClothParameters &params, const ClothTopology &topology, const ClothState &state, uint32_t begin, uint32_t end, bool enableWind, const WindField *pWindField) {
+    const float stiffnessRate = topology.maxSprings * params.springConstant / params.particleMass;
+    const float damperRate = topology.maxSprings * params.dampingConstant / params.particleMass;
+    const float dragScale = 1.225f * 1.28f * 6 * params.sideSpringLength * params.sideSpringLength / 2 / 3 / params.particleMass;
+
+    float limit = INFINITY;
+    for (uint32_t i = begin; i < end; i++) {
+        simd::float3 velocity = state.getVelocity(i);
+        float dampingRate = damperRate + dragScale * getRelativeWindSpeed(enableWind, pWindField, velocity);
+        float stabilityLimit = (sqrtf(dampingRate * dampingRate + 4 * stiffnessRate) - dampingRate) / stiffnessRate;
+
+        float strainRate = 0;
+        for (uint32_t spring = topology.getSpringStart(i); spring < topology.getSpringEnd(i); spring++) {
+            float restLength = topology.springRestLengths[spring];
+            if (restLength > 0) strainRate = std::max(strainRate, simd::length(velocity - state.getVelocity(topology.springNeighbours[spring])) / restLength);
+        }
+
+        limit = std::min(limit, std::min(SUBSTEP_SAFETY * stabilityLimit, STRAIN_CFL / strainRate));
+    }
+    return limit;
+}
+
+void recalculateClothNormals(const ClothTopology &topology, const ClothState &state, uint32_t begin, uint32_t end, PrimitiveData *primitiveData) {
+    for (uint32_t i = begin; i < end; i++) {
+        simd::float3 averageNormal = simd::float3{};
+        for (uint32_t entry = topology.getTriangleStart(i); entry < topology.getTriangleEnd(i); entry++) {
+            uint32_t corner = topology.triangleCorners[entry];
+            const uint32_t *triangle = &topology.indices[3 * ClothTopology::getTriangle(corner)];
+            uint32_t v = ClothTopology::getCorner(corner);
+            averageNormal += getTriangleNormal(state, i, triangle[(v + 1) % 3], triangle[(v + 2) % 3]);
+        }
+
+        averageNormal = simd::normalize(averageNormal);
+        for (uint32_t entry = topology.getTriangleStart(i); entry < topology.getTriangleEnd(i); entry++) {
+            uint32_t corner = topology.triangleCorners[entry];
+            PrimitiveData &data = primitiveData[ClothTopology::getTriangle(corner)];
+            switch (ClothTopology::getCorner(corner)) {
+                case 0: data.v0Normal = averageNormal; break;
+                case 1: data.v1Normal = averageNormal; break;
+                default: data.v2Normal = averageNormal; break;
+            }
+        }
+    }
+}
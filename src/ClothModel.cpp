@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "simulation/ClothModel.hpp"
+
+ClothParameters makeClothParameters(float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant) {
+    float sideSpringLength = size / (particleCount - 1);
+    return ClothParameters{
+        .particleCount = particleCount,
+        .particleMass = size * size * unitMass / particleCount / particleCount,
+        .springConstant = springConstant,
+        .dampingConstant = dampingConstant,
+        .sideSpringLength = sideSpringLength,
+        .diagonalSpringLength = sqrtf(2) * sideSpringLength
+    };
+}
+
+SelfCollisionParameters makeSelfCollisionParameters(const ClothParameters &params, uint32_t triangleCount, float thickness) {
+    uint32_t tableSize = 1;
+    while (tableSize < 2 * triangleCount) tableSize *= 2;
+    return SelfCollisionParameters{
+        .tableSize = tableSize,
+        .capacity = 8 * triangleCount,
+        .thickness = thickness,
+        //any cell size finds every contact; about one thickened triangle per cell keeps both the lists and the copies short
+        .cellSize = params.sideSpringLength + 2 * thickness
+    };
+}
+
+uint32_t getClothSubsteps(float springConstant, float size, uint32_t particleCount, float dt) {
+    float density = particleCount / size;
+    return 1 + springConstant * density * density * dt;
+}
+
+uint32_t getAdaptiveClothSubsteps(float substepLimit, float dt) {
+    if (!(substepLimit > 0)) return MAX_CLOTH_SUBSTEPS;
+    return std::min((float)MAX_CLOTH_SUBSTEPS, std::max(1.0f, std::ceil(dt / substepLimit)));
+}
+
+void generateClothIndices(uint32_t particleCount, uint32_t *indices) {
+    generateClothIndices(particleCount, indices, 0, particleCount - 1);
+}
+
+void generateClothIndices(uint32_t particleCount, uint32_t *indices, uint32_t firstRow, uint32_t lastRow) {
+    for (uint32_t i = firstRow; i < lastRow; i++) {
+        for (uint32_t j = 0; j < particleCount - 1; j++) {
+            uint32_t index = 6 * (i * (particleCount - 1) + j);
+            indices[index    ] = i * particleCount + j;
+            indices[index + 1] = i * particleCount + j + 1;
+            indices[index + 2] = (i + 1) * particleCount + j;
+            indices[index + 3] = i * particleCount + j + 1;
+            indices[index + 4] = (i + 1) * particleCount + j + 1;
+            indices[index + 5] = (i + 1) * particleCount + j;
+        }
+    }
+}
+
+//integer hash of the particle index in [0, 1), so every chunk jitters its particles the same way regardless of which
+//thread fills it or in what order
+static inline float getJitter(uint32_t index) {
+    index ^= index >> 16;
+    index *= 0x7feb352d;
+    index ^= index >> 15;
+    index *= 0x846ca68b;
+    index ^= index >> 16;
+    return (index >> 8) * (1.0f / (1 << 24));
+}
+
+void generateClothParticles(float size, uint32_t particleCount, Particle *particles) {
+    generateClothParticles(size, particleCount, particles, 0, particleCount);
+}
+
+void generateClothParticles(float size, uint32_t particleCount, Particle *particles, uint32_t firstRow, uint32_t lastRow) {
+    for (uint32_t i = firstRow; i < lastRow; i++) {
+        for (uint32_t j = 0; j < particleCount; j++) {
+            particles[i * particleCount + j] = {
+                .normal = simd::float3{ 0, 0, -1},
+                .position = simd::float3{
+                    size * (j - (particleCount - 1.0f) / 2) / (particleCount - 1),
+                    0.5f + size * (1 - (float)i / (particleCount - 1)),
+                    -0.75f + 0.01f * getJitter(i * particleCount + j)
+                },
+                .velocity = simd::float3{},
+                .acceleration = simd::float3{}
+            };
+        }
+    }
+}
+
+std::vector<Attachment> generateClothAttachments(uint32_t particleCount, const Particle *particles) {
+    std::vector<Attachment> attachments(particleCount);
+    for (uint32_t j = 0; j < particleCount; j++) {
+        attachments[j] = Attachment{
+            .localPosition = particles[j].position,
+            .particle = j,
+            .handle = 0,
+            .stiffness = ATTACHMENT_HARD
+        };
+    }
+    return attachments;
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "simulation/ClothSleep.hpp"
+
+//kinetic energy per unit mass and strain rate a block must stay under, and for how many substeps, before it sleeps
+constexpr float SLEEP_ENERGY = 2e-4f;
+constexpr float SLEEP_STRAIN_RATE = 0.5f;
+constexpr uint32_t SLEEP_SUBSTEPS = 256;
+
+ClothSleep::ClothSleep(const ClothTopology &topology, uint32_t blockSize, uint32_t particleCapacity) {
+    this->_pTopology = &topology;
+    this->_blockSize = std::max(blockSize, 1u);
+    uint32_t blockCount = (std::max(topology.particleCount, particleCapacity) + this->_blockSize - 1) / this->_blockSize;
+    this->_awake.assign(blockCount, 1);
+    this->_active.assign(blockCount, 1);
+    this->_quiet.assign(blockCount, 0);
+    this->_quietSubsteps.assign(blockCount, 0);
+    this->collectNeighbours();
+    this->collectAwakeBlocks();
+}
+
+uint32_t ClothSleep::getBlockEnd(uint32_t block) const {
+    return std::min(this->_pTopology->particleCount, (block + 1) * this->_blockSize);
+}
+
+bool ClothSleep::isTriangleAwake(uint32_t triangle) const {
+    const std::vector<uint32_t> &indices = this->_pTopology->indices;
+    return this->_awake[this->getBlock(indices[3 * triangle])] || this->_awake[this->getBlock(indices[3 * triangle + 1])] || this->_awake[this->getBlock(indices[3 * triangle + 2])];
+}
+
+bool ClothSleep::wasActive(uint32_t block, bool neighbours) const {
+    if (this->_active[block] || !neighbours) return this->_active[block];
+    for (uint32_t entry = this->_neighbourStarts[block]; entry < this->_neighbourStarts[block + 1]; entry++) {
+        if (this->_active[this->_neighbours[entry]]) return true;
+    }
+    return false;
+}
+
+void ClothSleep::beginFrame() {
+    this->_active = this->_awake;
+}
+
+void ClothSleep::wakeAll() {
+    if (this->isAllAwake()) return;
+    for (uint32_t block = 0; block < this->getBlockCount(); block++) this->wake(block);
+    this->collectAwakeBlocks();
+}
+
+//only sleeping blocks are woken, and the attachments are sorted by particle, so attachments on the same block wake it once
+void ClothSleep::wakeAttachments(const ClothAttachments &attachments) {
+    bool changed = false;
+    for (const Attachment &attachment: attachments.getAttachments()) {
+        uint32_t block = this->getBlock(attachment.particle);
+        if (this->_awake[block] || !attachments.isHandleMoving(attachment.handle)) continue;
+        this->wake(block);
+        changed = true;
+    }
+    if (changed) this->collectAwakeBlocks();
+}
+
+void ClothSleep::update(ThreadPool *pThreadPool, ClothState &state) {
+    const ClothTopology &topology = *this->_pTopology;
+    const std::vector<uint32_t> &awakeBlocks = this->_awakeBlocks;
+
+    //the energy test fails on the first moving particle, so only blocks that are nearly still pay for the strain test
+    pThreadPool->parallelFor(awakeBlocks.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t entry = begin; entry < end; entry++) {
+            uint32_t block = awakeBlocks[entry];
+            bool quiet = true;
+            for (uint32_t i = this->getBlockStart(block); quiet && i < this->getBlockEnd(block); i++) {
+                quiet = simd::length_squared(state.getVelocity(i)) / 2 < SLEEP_ENERGY;
+            }
+            for (uint32_t i = this->getBlockStart(block); quiet && i < this->getBlockEnd(block); i++) {
+                simd::float3 velocity = state.getVelocity(i);
+                for (uint32_t spring = topology.getSpringStart(i); quiet && spring < topology.getSpringEnd(i); spring++) {
+                    float restLength = topology.springRestLengths[spring];
+                    float strainRate = simd::length(velocity - state.getVelocity(topology.springNeighbours[spring]));
+                    quiet = restLength <= 0 || strainRate < SLEEP_STRAIN_RATE * restLength;
+                }
+            }
+            this->_quiet[block] = quiet;
+        }
+    });
+
+    //serial over blocks, so which blocks sleep and wake never depends on the thread count; moving blocks first restart
+    //the count of every neighbour, so a block next to a moving one never falls asleep whatever the block order
+    bool changed = false;
+    for (uint32_t block: awakeBlocks) {
+        if (this->_quiet[block]) continue;
+        this->_quietSubsteps[block] = 0;
+        for (uint32_t entry = this->_neighbourStarts[block]; entry < this->_neighbourStarts[block + 1]; entry++) {
+            uint32_t neighbour = this->_neighbours[entry];
+            if (!this->_awake[neighbour]) changed = true;
+            this->wake(neighbour);
+        }
+    }
+    for (uint32_t block: awakeBlocks) {
+        if (!this->_quiet[block]) continue;
+        if (++this->_quietSubsteps[block] >= SLEEP_SUBSTEPS) {
+            this->_awake[block] = 0;
+            changed = true;
+            for (uint32_t i = this->getBlockStart(block); i < this->getBlockEnd(block); i++) {
+                state.setVelocity(i, simd::float3{});
+            }
+        }
+    }
+    if (changed) this->collectAwakeBlocks();
+}
+
+void ClothSleep::updateTopology(const std::vector<uint32_t> &particles) {
+    this->collectNeighbours();
+    for (uint32_t particle: particles) this->wake(this->getBlock(particle));
+    this->collectAwakeBlocks();
+}
+
+void ClothSleep::wake(uint32_t block) {
+    this->_awake[block] = 1;
+    this->_active[block] = 1;
+    this->_quietSubsteps[block] = 0;
+}
+
+//the spring list is gathered again after every tear, so only that needs reading
+void ClothSleep::collectNeighbours() {
+    uint32_t blockCount = this->getBlockCount();
+    std::vector<std::vector<uint32_t>> neighbours(blockCount);
+    for (const DistanceConstraint &spring: this->_pTopology->springs) {
+        uint32_t a = this->getBlock(spring.particleA), b = this->getBlock(spring.particleB);
+        if (a == b) continue;
+        neighbours[a].push_back(b);
+        neighbours[b].push_back(a);
+    }
+    this->_neighbourStarts.assign(blockCount + 1, 0);
+    this->_neighbours.clear();
+    for (uint32_t block = 0; block < blockCount; block++) {
+        std::sort(neighbours[block].begin(), neighbours[block].end());
+        neighbours[block].erase(std::unique(neighbours[block].begin(), neighbours[block].end()), neighbours[block].end());
+        this->_neighbourStarts[block + 1] = this->_neighbourStarts[block] + neighbours[block].size();
+        this->_neighbours.insert(this->_neighbours.end(), neighbours[block].begin(), neighbours[block].end());
+    }
+}
+
+void ClothSleep::collectAwakeBlocks() {
+    this->_awakeBlocks.clear();
+    for (uint32_t block = 0; block < this->getBlockCount(); block++) {
+        if (this->_awake[block]) this->_awakeBlocks.push_back(block);
+    }
+}
@@ -0,0 +1,42 @@
+#include "simulation/ClothState.hpp"
+
+void ClothState::resize(uint32_t count) {
+    for (std::vector<float> *pArray: {
+        &this->positionX, &this->positionY, &this->positionZ,
+        &this->velocityX, &this->velocityY, &this->velocityZ,
+        &this->accelerationX, &this->accelerationY, &this->accelerationZ
+    }) {
+        pArray->resize(count);
+    }
+}
+
+void ClothState::reserve(uint32_t count) {
+    for (std::vector<float> *pArray: {
+        &this->positionX, &this->positionY, &this->positionZ,
+        &this->velocityX, &this->velocityY, &this->velocityZ,
+        &this->accelerationX, &this->accelerationY, &this->accelerationZ
+    }) {
+        pArray->reserve(count);
+    }
+}
+
+uint32_t ClothState::size() const {
+    return this->positionX.size();
+}
+
+void ClothState::importParticles(const Particle *particles, uint32_t count) {
+    this->resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        this->setPosition(i, particles[i].position);
+        this->setVelocity(i, particles[i].velocity);
+        this->setAcceleration(i, particles[i].acceleration);
+    }
+}
+
+void ClothState::exportParticles(Particle *particles) const {
+    for (uint32_t i = 0; i < this->size(); i++) {
+        particles[i].position = this->getPosition(i);
+        particles[i].velocity = this->getVelocity(i);
+        particles[i].acceleration = this->getAcceleration(i);
+    }
+}
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include "simulation/ClothTearing.hpp"
+
+//entry of neighbour in the particle's sorted spring row, or the row end when no spring joins them
+static uint32_t findSpring(const ClothTopology &topology, uint32_t particle, uint32_t neighbour) {
+    const uint32_t *neighbours = topology.springNeighbours.data();
+    const uint32_t *last = neighbours + topology.getSpringEnd(particle);
+    const uint32_t *found = std::lower_bound(neighbours + topology.getSpringStart(particle), last, neighbour);
+    return found != last && *found == neighbour ? found - neighbours : topology.getSpringEnd(particle);
+}
+
+static bool hasSpring(const ClothTopology &topology, uint32_t particle, uint32_t neighbour) {
+    return findSpring(topology, particle, neighbour) != topology.getSpringEnd(particle);
+}
+
+static bool hasCorner(const uint32_t *triangle, uint32_t particle) {
+    return triangle[0] == particle || triangle[1] == particle || triangle[2] == particle;
+}
+
+//shifts the rest of the row over the entry, so the row stays sorted and its slack gathers at the end
+static void eraseSpringEntry(ClothTopology &topology, uint32_t particle, uint32_t entry) {
+    uint32_t last = --topology.springEnds[particle];
+    for (; entry < last; entry++) {
+        topology.springNeighbours[entry] = topology.springNeighbours[entry + 1];
+        topology.springRestLengths[entry] = topology.springRestLengths[entry + 1];
+    }
+}
+
+//a split particle has the highest index yet, so its entry moves to the end of the row to keep the row sorted
+static void renameSpringEntry(ClothTopology &topology, uint32_t particle, uint32_t from, uint32_t to) {
+    uint32_t entry = findSpring(topology, particle, from);
+    uint32_t last = topology.getSpringEnd(particle) - 1;
+    if (entry > last) return;
+    float restLength = topology.springRestLengths[entry];
+    for (; entry < last; entry++) {
+        topology.springNeighbours[entry] = topology.springNeighbours[entry + 1];
+        topology.springRestLengths[entry] = topology.springRestLengths[entry + 1];
+    }
+    topology.springNeighbours[last] = to;
+    topology.springRestLengths[last] = restLength;
+}
+
+//whether two triangles around the particle share an edge from it whose spring is unbroken
+static bool isJoined(const ClothTopology &topology, uint32_t particle, uint32_t a, uint32_t b) {
+    const uint32_t *first = &topology.indices[3 * a], *second = &topology.indices[3 * b];
+    for (int v = 0; v < 3; v++) {
+        if (first[v] != particle && hasCorner(second, first[v]) && hasSpring(topology, particle, first[v])) return true;
+    }
+    return false;
+}
+
+//whether the neighbour is the far corner of a triangle across the edge of the particle's triangle opposite the particle,
+//which is where a bending spring reaches
+static bool isAcross(const ClothTopology &topology, const uint32_t *triangle, uint32_t particle, uint32_t neighbour) {
+    uint32_t v = triangle[0] == particle ? 0 : triangle[1] == particle ? 1 : 2;
+    uint32_t a = triangle[(v + 1) % 3], b = triangle[(v + 2) % 3];
+    for (uint32_t entry = topology.getTriangleStart(neighbour); entry < topology.getTriangleEnd(neighbour); entry++) {
+        const uint32_t *other = &topology.indices[3 * ClothTopology::getTriangle(topology.triangleCorners[entry])];
+        if (hasCorner(other, a) && hasCorner(other, b)) return true;
+    }
+    return false;
+}
+
+ClothTearing::ClothTearing(ClothTopology &topology, float strain, uint32_t particleCapacity) {
+    this->_pTopology = &topology;
+    this->_strain = strain;
+    this->_particleCapacity = std::max(particleCapacity, topology.particleCount);
+
+    //a split particle never has more springs or triangles than the one it split from
+    uint32_t spare = this->_particleCapacity - topology.particleCount;
+    uint32_t maxTriangles = 0;
+    for (uint32_t i = 0; i < topology.particleCount; i++) {
+        maxTriangles = std::max(maxTriangles, topology.getTriangleEnd(i) - topology.getTriangleStart(i));
+    }
+    topology.springStarts.reserve(this->_particleCapacity + 1);
+    topology.springEnds.reserve(this->_particleCapacity);
+    topology.springNeighbours.reserve(topology.springNeighbours.size() + spare * topology.maxSprings);
+    topology.springRestLengths.reserve(topology.springRestLengths.size() + spare * topology.maxSprings);
+    topology.triangleStarts.reserve(this->_particleCapacity + 1);
+    topology.triangleEnds.reserve(this->_particleCapacity);
+    topology.triangleCorners.reserve(topology.triangleCorners.size() + spare * maxTriangles);
+    topology.origins.reserve(this->_particleCapacity);
+}
+
+bool ClothTearing::apply(ThreadPool *pThreadPool, ClothState &state, const ClothSleep &sleep) {
+    ClothTopology &topology = *this->_pTopology;
+    const std::vector<uint32_t> &awakeBlocks = sleep.getAwakeBlocks();
+    this->_tornParticles.clear();
+    this->_candidates.resize(awakeBlocks.size());
+
+    //sleeping blocks do not stretch, so only awake ones are measured; a spring is measured from its lower particle,
+    //or from its awake end when the other one sleeps
+    pThreadPool->parallelFor(awakeBlocks.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t entry = begin; entry < end; entry++) {
+            std::vector<uint64_t> &candidates = this->_candidates[entry];
+            candidates.clear();
+            for (uint32_t i = sleep.getBlockStart(awakeBlocks[entry]); i < sleep.getBlockEnd(awakeBlocks[entry]); i++) {
+                simd::float3 position = state.getPosition(i);
+                for (uint32_t spring = topology.getSpringStart(i); spring < topology.getSpringEnd(i); spring++) {
+                    uint32_t j = topology.springNeighbours[spring];
+                    float restLength = topology.springRestLengths[spring];
+                    if (j < i && sleep.isAwake(sleep.getBlock(j))) continue;
+                    if (restLength > 0 && simd::length(state.getPosition(j) - position) > (1 + this->_strain) * restLength) {
+                        candidates.push_back((uint64_t)std::min(i, j) << 32 | std::max(i, j));
+                    }
+                }
+            }
+        }
+    });
+
+    for (const std::vector<uint64_t> &candidates: this->_candidates) {
+        for (uint64_t spring: candidates) this->breakSpring(spring >> 32, (uint32_t)spring);
+    }
+    if (this->_tornParticles.empty()) return false;
+
+    std::sort(this->_tornParticles.begin(), this->_tornParticles.end());
+    this->_tornParticles.erase(std::unique(this->_tornParticles.begin(), this->_tornParticles.end()), this->_tornParticles.end());
+    uint32_t brokenCount = this->_tornParticles.size();
+    for (uint32_t entry = 0; entry < brokenCount; entry++) {
+        this->split(state, this->_tornParticles[entry]);
+    }
+
+    //the spring list only seeds the solvers and the sleep neighbours, so it is gathered again from the rows rather
+    //than patched
+    topology.springs.clear();
+    for (uint32_t i = 0; i < topology.particleCount; i++) {
+        for (uint32_t spring = topology.getSpringStart(i); spring < topology.getSpringEnd(i); spring++) {
+            if (topology.springNeighbours[spring] < i) continue;
+            topology.springs.push_back(DistanceConstraint{
+                .particleA = i,
+                .particleB = topology.springNeighbours[spring],
+                .restLength = topology.springRestLengths[spring]
+            });
+        }
+    }
+    return true;
+}
+
+//removes the spring from both rows, and the bending spring between the far corners of the two triangles on its edge
+//an edge of a triangle that has already lost one holds, since losing a second would leave the corner between them as a
+//particle with no springs at all, which nothing keeps from drifting off the triangle
+void ClothTearing::breakSpring(uint32_t a, uint32_t b) {
+    ClothTopology &topology = *this->_pTopology;
+    uint32_t entry = findSpring(topology, a, b);
+    if (entry == topology.getSpringEnd(a)) return;
+    for (uint32_t corner = topology.getTriangleStart(a); corner < topology.getTriangleEnd(a); corner++) {
+        const uint32_t *triangle = &topology.indices[3 * ClothTopology::getTriangle(topology.triangleCorners[corner])];
+        if (!hasCorner(triangle, b)) continue;
+        for (int v = 0; v < 3; v++) {
+            if (triangle[v] == a || triangle[v] == b) continue;
+            if (!hasSpring(topology, a, triangle[v]) || !hasSpring(topology, b, triangle[v])) return;
+        }
+    }
+    eraseSpringEntry(topology, a, entry);
+    eraseSpringEntry(topology, b, findSpring(topology, b, a));
+    this->_tornParticles.push_back(a);
+    this->_tornParticles.push_back(b);
+
+    uint32_t farCorners[2], farCount = 0;
+    for (uint32_t corner = topology.getTriangleStart(a); corner < topology.getTriangleEnd(a) && farCount < 2; corner++) {
+        const uint32_t *triangle = &topology.indices[3 * ClothTopology::getTriangle(topology.triangleCorners[corner])];
+        if (!hasCorner(triangle, b)) continue;
+        for (int v = 0; v < 3; v++) {
+            if (triangle[v] != a && triangle[v] != b) farCorners[farCount++] = triangle[v];
+        }
+    }
+    if (farCount < 2) return;
+    entry = findSpring(topology, farCorners[0], farCorners[1]);
+    if (entry == topology.getSpringEnd(farCorners[0])) return;
+    eraseSpringEntry(topology, farCorners[0], entry);
+    eraseSpringEntry(topology, farCorners[1], findSpring(topology, farCorners[1], farCorners[0]));
+    this->_tornParticles.push_back(farCorners[0]);
+    this->_tornParticles.push_back(farCorners[1]);
+}
+
+//the first piece of the particle's triangle fan keeps the particle, and every other piece moves to a spare slot along
+//with the springs that reach into it; their triangles are re-pointed in place and the particle's rows shrink
+void ClothTearing::split(ClothState &state, uint32_t particle) {
+    ClothTopology &topology = *this->_pTopology;
+    const uint32_t triangleFirst = topology.getTriangleStart(particle);
+    const uint32_t triangleCount = topology.getTriangleEnd(particle) - triangleFirst;
+    const uint32_t springFirst = topology.getSpringStart(particle);
+    const uint32_t springCount = topology.getSpringEnd(particle) - springFirst;
+    auto getTriangle = [&](uint32_t entry) {
+        return ClothTopology::getTriangle(topology.triangleCorners[triangleFirst + entry]);
+    };
+
+    //flood the fan across joined triangles, numbering the pieces in row order
+    std::vector<uint32_t> pieces(triangleCount, UINT32_MAX), stack;
+    uint32_t pieceCount = 0;
+    for (uint32_t seed = 0; seed < triangleCount; seed++) {
+        if (pieces[seed] != UINT32_MAX) continue;
+        pieces[seed] = pieceCount;
+        stack.push_back(seed);
+        while (!stack.empty()) {
+            uint32_t entry = stack.back();
+            stack.pop_back();
+            for (uint32_t other = 0; other < triangleCount; other++) {
+                if (pieces[other] == UINT32_MAX && isJoined(topology, particle, getTriangle(entry), getTriangle(other))) {
+                    pieces[other] = pieceCount;
+                    stack.push_back(other);
+                }
+            }
+        }
+        pieceCount++;
+    }
+    uint32_t splitCount = std::min(pieceCount, this->_particleCapacity - topology.particleCount + 1) - 1;
+    if (pieceCount < 2 || splitCount == 0) return;
+    if (topology.origins.empty()) {
+        topology.origins.resize(topology.particleCount);
+        for (uint32_t i = 0; i < topology.particleCount; i++) topology.origins[i] = i;
+    }
+
+    //a spring follows the piece with a triangle on its edge, or across whose far edge it bends; others stay
+    std::vector<uint32_t> springPieces(springCount, 0);
+    for (uint32_t spring = 0; spring < springCount; spring++) {
+        uint32_t neighbour = topology.springNeighbours[springFirst + spring];
+        for (uint32_t entry = 0; entry < triangleCount; entry++) {
+            const uint32_t *triangle = &topology.indices[3 * getTriangle(entry)];
+            if (hasCorner(triangle, neighbour) || isAcross(topology, triangle, particle, neighbour)) {
+                springPieces[spring] = pieces[entry];
+                break;
+            }
+        }
+    }
+
+    //pieces past the spare slots stay with the particle
+    auto staysWithParticle = [&](uint32_t piece) {
+        return piece == 0 || piece > splitCount;
+    };
+    for (uint32_t piece = 1; piece <= splitCount; piece++) {
+        uint32_t split = topology.particleCount++;
+        for (uint32_t spring = 0; spring < springCount; spring++) {
+            if (springPieces[spring] != piece) continue;
+            uint32_t neighbour = topology.springNeighbours[springFirst + spring];
+            topology.springNeighbours.push_back(neighbour);
+            topology.springRestLengths.push_back(topology.springRestLengths[springFirst + spring]);
+            renameSpringEntry(topology, neighbour, particle, split);
+        }
+        topology.springEnds.push_back(topology.springNeighbours.size());
+        topology.springStarts.push_back(topology.springNeighbours.size());
+
+        for (uint32_t entry = 0; entry < triangleCount; entry++) {
+            if (pieces[entry] != piece) continue;
+            uint32_t corner = topology.triangleCorners[triangleFirst + entry];
+            topology.triangleCorners.push_back(corner);
+            topology.indices[3 * ClothTopology::getTriangle(corner) + ClothTopology::getCorner(corner)] = split;
+        }
+        topology.triangleEnds.push_back(topology.triangleCorners.size());
+        topology.triangleStarts.push_back(topology.triangleCorners.size());
+
+        topology.origins.push_back(topology.origins[particle]);
+        state.resize(topology.particleCount);
+        state.setPosition(split, state.getPosition(particle));
+        state.setVelocity(split, state.getVelocity(particle));
+        state.setAcceleration(split, simd::float3{});
+        this->_tornParticles.push_back(split);
+    }
+
+    uint32_t last = springFirst;
+    for (uint32_t spring = 0; spring < springCount; spring++) {
+        if (!staysWithParticle(springPieces[spring])) continue;
+        topology.springNeighbours[last] = topology.springNeighbours[springFirst + spring];
+        topology.springRestLengths[last++] = topology.springRestLengths[springFirst + spring];
+    }
+    topology.springEnds[particle] = last;
+    last = triangleFirst;
+    for (uint32_t entry = 0; entry < triangleCount; entry++) {
+        if (staysWithParticle(pieces[entry])) topology.triangleCorners[last++] = topology.triangleCorners[triangleFirst + entry];
+    }
+    topology.triangleEnds[particle] = last;
+}
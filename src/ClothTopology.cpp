@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "simulation/ClothConstraints.hpp"
+#include "simulation/ClothTopology.hpp"
+
+//fills the per-particle rows from the spring and triangle lists with two counting passes
+static void buildRows(ClothTopology &topology) {
+    const uint32_t count = topology.particleCount;
+    topology.springStarts.assign(count + 1, 0);
+    for (const DistanceConstraint &spring: topology.springs) {
+        topology.springStarts[spring.particleA + 1]++;
+        topology.springStarts[spring.particleB + 1]++;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        topology.maxSprings = std::max(topology.maxSprings, topology.springStarts[i + 1]);
+        topology.springStarts[i + 1] += topology.springStarts[i];
+    }
+
+    std::vector<std::pair<uint32_t, float>> entries(topology.springStarts[count]);
+    std::vector<uint32_t> cursors(topology.springStarts.begin(), topology.springStarts.end() - 1);
+    for (const DistanceConstraint &spring: topology.springs) {
+        entries[cursors[spring.particleA]++] = {spring.particleB, spring.restLength};
+        entries[cursors[spring.particleB]++] = {spring.particleA, spring.restLength};
+    }
+    topology.springEnds.assign(topology.springStarts.begin() + 1, topology.springStarts.end());
+    topology.springNeighbours.resize(entries.size());
+    topology.springRestLengths.resize(entries.size());
+    for (uint32_t i = 0; i < count; i++) {
+        std::sort(entries.begin() + topology.springStarts[i], entries.begin() + topology.springStarts[i + 1]);
+        for (uint32_t entry = topology.springStarts[i]; entry < topology.springStarts[i + 1]; entry++) {
+            topology.springNeighbours[entry] = entries[entry].first;
+            topology.springRestLengths[entry] = entries[entry].second;
+        }
+    }
+
+    //triangles are visited in order, so every row comes out sorted without a second sort
+    topology.triangleStarts.assign(count + 1, 0);
+    for (uint32_t index: topology.indices) topology.triangleStarts[index + 1]++;
+    for (uint32_t i = 0; i < count; i++) topology.triangleStarts[i + 1] += topology.triangleStarts[i];
+    topology.triangleEnds.assign(topology.triangleStarts.begin() + 1, topology.triangleStarts.end());
+    topology.triangleCorners.resize(topology.indices.size());
+    cursors.assign(topology.triangleStarts.begin(), topology.triangleStarts.end() - 1);
+    for (uint32_t corner = 0; corner < topology.indices.size(); corner++) {
+        topology.triangleCorners[cursors[topology.indices[corner]]++] = (corner / 3) << 2 | corner % 3;
+    }
+}
+
+ClothTopology buildGridClothTopology(const ClothParameters &params) {
+    const uint32_t n = params.particleCount;
+    ClothTopology topology;
+    topology.gridSize = n;
+    topology.particleCount = n * n;
+    topology.triangleCount = 2 * (n - 1) * (n - 1);
+    topology.indices.resize(3 * topology.triangleCount);
+    generateClothIndices(n, topology.indices.data());
+    topology.springs = buildClothConstraints(params);
+    buildRows(topology);
+    return topology;
+}
+
+ClothTopology buildMeshClothTopology(const ClothMesh &mesh) {
+    ClothTopology topology;
+    topology.particleCount = mesh.positions.size();
+    topology.triangleCount = mesh.indices.size() / 3;
+    topology.indices = mesh.indices;
+    auto addSpring = [&](uint32_t a, uint32_t b) {
+        topology.springs.push_back(DistanceConstraint{
+            .particleA = a,
+            .particleB = b,
+            .restLength = simd::length(mesh.positions[b] - mesh.positions[a])
+        });
+    };
+
+    //the first triangle to reach an edge adds its spring and leaves its opposite corner for the bending spring of the
+    //second; edges with more than two triangles keep only the first pair
+    std::unordered_map<uint64_t, uint32_t> opposite;
+    for (uint32_t t = 0; t < topology.triangleCount; t++) {
+        for (int v = 0; v < 3; v++) {
+            uint32_t a = mesh.indices[3 * t + v], b = mesh.indices[3 * t + (v + 1) % 3], c = mesh.indices[3 * t + (v + 2) % 3];
+            uint64_t edge = (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+            auto found = opposite.find(edge);
+            if (found == opposite.end()) {
+                opposite[edge] = c;
+                addSpring(std::min(a, b), std::max(a, b));
+            }
+            else if (found->second != UINT32_MAX) {
+                if (found->second != c) addSpring(std::min(found->second, c), std::max(found->second, c));
+                found->second = UINT32_MAX;
+            }
+        }
+    }
+    //sorting by the first particle keeps the list in the same particle order as the rows
+    std::sort(topology.springs.begin(), topology.springs.end(), [](const DistanceConstraint &a, const DistanceConstraint &b) {
+        return a.particleA != b.particleA ? a.particleA < b.particleA : a.particleB < b.particleB;
+    });
+    buildRows(topology);
+    return topology;
+}
+
+ClothParameters makeMeshClothParameters(const ClothMesh &mesh, float unitMass, float springConstant, float dampingConstant) {
+    uint32_t triangleCount = mesh.indices.size() / 3;
+    float area = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        simd::float3 a = mesh.positions[mesh.indices[3 * t]], b = mesh.positions[mesh.indices[3 * t + 1]], c = mesh.positions[mesh.indices[3 * t + 2]];
+        area += simd::length(simd::cross(b - a, c - a)) / 2;
+    }
+    float sideSpringLength = triangleCount > 0 ? sqrtf(2 * area / triangleCount) : 0;
+    return ClothParameters{
+        .particleCount = 0,
+        .particleMass = mesh.positions.empty() ? 0 : area * unitMass / mesh.positions.size(),
+        .springConstant = springConstant,
+        .dampingConstant = dampingConstant,
+        .sideSpringLength = sideSpringLength,
+        .diagonalSpringLength = sqrtf(2) * sideSpringLength
+    };
+}
@@ -1,12 +1,17 @@
 #include "ComputePipelineState.hpp"
 
 ComputePipelineState::ComputePipelineState(MTL::Device *pDevice, MTL::Function *pFunction, MTL::Size contextSize) {
-    NS::Error *pErr;
+    NS::Error *pErr = nullptr;
     this->_pComputePipelineState = pDevice->newComputePipelineState(pFunction, &pErr);
     assertNSError(pErr);
 
     unsigned int threadgroupWidth = this->_pComputePipelineState->threadExecutionWidth();
     unsigned int threadgroupHeight = this->_pComputePipelineState->maxTotalThreadsPerThreadgroup() / threadgroupWidth;
+    //a 1D context gets whole rows, so no thread repeats another's position and a single group spans as much as it can
+    if (contextSize.height == 1 && contextSize.depth == 1) {
+        threadgroupWidth = this->_pComputePipelineState->maxTotalThreadsPerThreadgroup();
+        threadgroupHeight = 1;
+    }
     unsigned int threadgroupDepth = 1;
     this->_threadgroupsPerGrid = MTL::Size::Make(
         (contextSize.width + threadgroupWidth - 1) / threadgroupWidth,
@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include "simulation/ClothKernels.hpp"
+#include "simulation/ClothSleep.hpp"
+#include "simulation/ClothTearing.hpp"
+#include "simulation/CpuCloth.hpp"
+#include "simulation/ImplicitSolver.hpp"
+#include "simulation/SelfCollision.hpp"
+#include "simulation/XpbdSolver.hpp"
+
+//particles per slot of the substep limit reduction on meshes, which have no rows to reduce over, and per sleep block,
+//so a mesh slot covers exactly one block; grids round their sleep blocks to whole rows
+constexpr uint32_t SUBSTEP_LIMIT_BLOCK = 256;
+
+CpuCloth::CpuCloth(ThreadPool *pThreadPool, float size, uint32_t particleCount, float unitMass, float springConstant, float dampingConstant) {
+    this->_parameters = makeClothParameters(size, particleCount, unitMass, springConstant, dampingConstant);
+    this->_size = size;
+    this->_pThreadPool = pThreadPool;
+
+    std::vector<Particle> particles(particleCount * particleCount);
+    pThreadPool->parallelFor(particleCount, [&](uint32_t begin, uint32_t end) {
+        generateClothParticles(size, particleCount, particles.data(), begin, end);
+    });
+    this->initialize(buildGridClothTopology(this->_parameters), particles, generateClothAttachments(particleCount, particles.data()));
+}
+
+CpuCloth::CpuCloth(ThreadPool *pThreadPool, const ClothMesh &mesh, float unitMass, float springConstant, float dampingConstant) {
+    this->_parameters = makeMeshClothParameters(mesh, unitMass, springConstant, dampingConstant);
+    this->_pThreadPool = pThreadPool;
+
+    std::vector<Particle> particles(mesh.positions.size());
+    std::vector<Attachment> attachments;
+    for (uint32_t i = 0; i < particles.size(); i++) {
+        particles[i] = {
+            .normal = simd::float3{0, 0, -1},
+            .position = mesh.positions[i],
+            .velocity = simd::float3{},
+            .acceleration = simd::float3{}
+        };
+        if (!mesh.pinned.empty() && mesh.pinned[i]) {
+            attachments.push_back(Attachment{.localPosition = mesh.positions[i], .particle = (uint32_t)i, .handle = 0, .stiffness = ATTACHMENT_HARD});
+        }
+    }
+    this->initialize(buildMeshClothTopology(mesh), particles, attachments);
+}
+
+void CpuCloth::initialize(ClothTopology topology, const std::vector<Particle> &particles, const std::vector<Attachment> &attachments) {
+    this->_topology = std::move(topology);
+    this->_primitiveData.resize(this->getTriangleCount());
+    this->_state.triangleDrag.resize(this->getTriangleCount());
+    this->_vertices.resize(particles.size());
+    uint32_t gridSize = this->_topology.gridSize;
+    this->_gridKernels = getClothGridKernels(gridSize);
+    this->_substepLimits.resize(gridSize > 0 ? gridSize : (particles.size() + SUBSTEP_LIMIT_BLOCK - 1) / SUBSTEP_LIMIT_BLOCK);
+
+    this->_state.importParticles(particles.data(), particles.size());
+    for (uint32_t i = 0; i < particles.size(); i++) {
+        simd::float3 position = particles[i].position;
+        this->_vertices[i] = pfloat3{position.x, position.y, position.z};
+    }
+    this->_pSelfCollision = new SelfCollision(this->_parameters, this->_topology);
+    this->_pAttachments = new ClothAttachments(particles.size());
+    this->_pAttachments->setAttachments(attachments);
+    this->_pSleep = new ClothSleep(this->_topology, gridSize > 0 ? std::max(1u, SUBSTEP_LIMIT_BLOCK / gridSize) * gridSize : SUBSTEP_LIMIT_BLOCK);
+}
+
+CpuCloth::~CpuCloth() {
+    delete this->_pImplicitSolver;
+    delete this->_pXpbdSolver;
+    delete this->_pSelfCollision;
+    delete this->_pSleep;
+    delete this->_pAttachments;
+    delete this->_pTearing;
+}
+
+void CpuCloth::setWindField(const WindField *pWindField) {
+    this->_pWindField = pWindField;
+}
+
+//only the explicit integrator tracks sleep, so the others start from, and keep, every block awake
+void CpuCloth::setIntegrator(ClothIntegrator integrator) {
+    this->_integrator = integrator;
+    this->_pSleep->wakeAll();
+    if (integrator == INTEGRATOR_IMPLICIT && this->_pImplicitSolver == nullptr) {
+        this->_pImplicitSolver = new ImplicitSolver(this->_parameters, this->_topology);
+    }
+    if (integrator == INTEGRATOR_XPBD && this->_pXpbdSolver == nullptr) {
+        this->_pXpbdSolver = new XpbdSolver(this->_parameters, this->_topology);
+    }
+}
+
+void CpuCloth::update(float dt, simd::float3 moveDirection, bool enable) {
+    auto start = std::chrono::steady_clock::now();
+    unsigned int iterations = 1;
+    //a changing wind field reaches every block, and so does switching the wind; moving handles wake the blocks attached
+    //to them, and the motion spreads from there
+    const ClothAttachments &attachments = *this->_pAttachments;
+    this->_pAttachments->translateHandle(0, dt * moveDirection);
+    if (enable != this->_sleepWind || (enable && this->_pWindField != nullptr)) this->_pSleep->wakeAll();
+    this->_pSleep->wakeAttachments(attachments);
+    this->_sleepWind = enable;
+    this->_pSleep->beginFrame();
+    if (this->_integrator == INTEGRATOR_IMPLICIT) {
+        this->_solverIterations = this->_pImplicitSolver->step(this->_pThreadPool, this->_state, attachments, dt, enable, this->_pWindField);
+        this->collideSelf(dt);
+    }
+    else if (this->_integrator == INTEGRATOR_XPBD) {
+        iterations = getXpbdSubsteps(dt);
+        for (uint32_t i = 0; i < iterations; i++) {
+            this->_pXpbdSolver->step(this->_pThreadPool, this->_state, attachments, dt / iterations, (i + 1.0f) / iterations, enable, this->_pWindField);
+            this->collideSelf(dt / iterations);
+        }
+    }
+    else {
+        iterations = this->getSubsteps(dt, enable);
+        float fdt = dt / iterations;
+        for (uint32_t i = 0; i < iterations; i++) {
+            this->simulate(fdt, (i + 1.0f) / iterations, enable);
+            this->collideSelf(fdt);
+            this->_pSleep->update(this->_pThreadPool, this->_state);
+        }
+        this->tear();
+    }
+    this->finalize();
+    this->_pAttachments->endFrame();
+    this->_lastSubsteps = iterations;
+    this->_particleSubsteps += (uint64_t)iterations * this->_state.size();
+    this->_simulationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//reduce the per-particle substep limits of the current state; rows land in fixed slots, so the minimum does not
+//depend on how rows were split between threads. sleeping blocks do not move, so they set no limit
+uint32_t CpuCloth::getSubsteps(float dt, bool enableWind) {
+    const ClothTopology &topology = this->_topology;
+    const ClothSleep &sleep = *this->_pSleep;
+    float *substepLimits = this->_substepLimits.data();
+    this->_pThreadPool->parallelFor(this->_substepLimits.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t slot = begin; slot < end; slot++) {
+            if (!sleep.isAwake(sleep.getBlock(topology.gridSize > 0 ? slot * topology.gridSize : slot * SUBSTEP_LIMIT_BLOCK))) {
+                substepLimits[slot] = INFINITY;
+            }
+            else if (topology.gridSize > 0) {
+                substepLimits[slot] = this->_gridKernels.getSubstepLimit(this->_parameters, this->_state, slot, enableWind, this->_pWindField);
+            }
+            else {
+                uint32_t last = std::min(topology.particleCount, (slot + 1) * SUBSTEP_LIMIT_BLOCK);
+                substepLimits[slot] = getClothSubstepLimit(this->_parameters, topology, this->_state, slot * SUBSTEP_LIMIT_BLOCK, last, enableWind, this->_pWindField);
+            }
+        }
+    });
+    float substepLimit = *std::min_element(this->_substepLimits.begin(), this->_substepLimits.end());
+    return getAdaptiveClothSubsteps(substepLimit, dt);
+}
+
+void CpuCloth::simulate(float dt, float fraction, bool enableWind) {
+    const ClothParameters &params = this->_parameters;
+    const ClothTopology &topology = this->_topology;
+    const uint32_t n = topology.gridSize;
+    ClothState &state = this->_state;
+    const ClothSleep &sleep = *this->_pSleep;
+    const ClothAttachments &attachments = *this->_pAttachments;
+    const std::vector<uint32_t> &awakeBlocks = sleep.getAwakeBlocks();
+    if (awakeBlocks.empty()) return;
+
+    //accumulate forces from the state left by the previous substep; grids keep the row kernel, which vectorizes
+    //across neighbouring particles instead of gathering. only triangles with an awake corner are needed
+    this->_pThreadPool->parallelFor(topology.triangleCount, [&](uint32_t begin, uint32_t end) {
+        if (sleep.isAllAwake()) {
+            computeClothTriangleDrag(topology, state, begin, end, enableWind, this->_pWindField);
+            return;
+        }
+        for (uint32_t t = begin; t < end; t++) {
+            if (sleep.isTriangleAwake(t)) computeClothTriangleDrag(topology, state, t, t + 1, enableWind, this->_pWindField);
+        }
+    });
+    this->_pThreadPool->parallelFor(awakeBlocks.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t entry = begin; entry < end; entry++) {
+            uint32_t first = sleep.getBlockStart(awakeBlocks[entry]), last = sleep.getBlockEnd(awakeBlocks[entry]);
+            if (n > 0) {
+                for (uint32_t y = first / n; y < last / n; y++) {
+                    this->_gridKernels.accumulateForces(params, state, y);
+                }
+            }
+            else {
+                accumulateClothForces(params, topology, state, first, last);
+            }
+        }
+    });
+
+    //attachments are sorted by particle, so those of a block are found with two searches
+    this->_pThreadPool->parallelFor(awakeBlocks.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t entry = begin; entry < end; entry++) {
+            uint32_t first = sleep.getBlockStart(awakeBlocks[entry]), last = sleep.getBlockEnd(awakeBlocks[entry]);
+            simulateClothMotion(state, first, last, dt);
+            applyClothAttachments(params, attachments, state, attachments.findAttachment(first), attachments.findAttachment(last), dt, fraction);
+        }
+    });
+}
+
+//a fully settled cloth cannot collide with itself any more than it already does
+void CpuCloth::collideSelf(float dt) {
+    if (this->_selfCollision && !this->_pSleep->getAwakeBlocks().empty()) {
+        this->_pSelfCollision->apply(this->_pThreadPool, this->_state, *this->_pAttachments, dt);
+    }
+}
+
+//new particles start where they split from, and the solvers built over the old springs are dropped, so the next
+//setIntegrator builds them over the torn ones
+void CpuCloth::tear() {
+    if (this->_pTearing == nullptr || !this->_pTearing->apply(this->_pThreadPool, this->_state, *this->_pSleep)) return;
+    for (uint32_t i = this->_vertices.size(); i < this->_topology.particleCount; i++) {
+        this->_vertices.push_back(pfloat3{this->_state.positionX[i], this->_state.positionY[i], this->_state.positionZ[i]});
+    }
+    this->_pAttachments->setParticleCount(this->_topology.particleCount);
+    //a grid cloth's first tear moves it to the mesh layout, whose new sleep blocks all start awake
+    if (this->_topology.gridSize > 0) this->layOutForTearing();
+    else this->_pSleep->updateTopology(this->_pTearing->getTornParticles());
+    delete this->_pImplicitSolver;
+    delete this->_pXpbdSolver;
+    this->_pImplicitSolver = nullptr;
+    this->_pXpbdSolver = nullptr;
+}
+
+//the work simulateClothKernel does on its final iteration: collide, then publish normals and vertices
+//blocks that slept through the frame have not moved, so only their normals next to blocks that did need refreshing
+void CpuCloth::finalize() {
+    const ClothParameters &params = this->_parameters;
+    const ClothTopology &topology = this->_topology;
+    const uint32_t n = topology.gridSize;
+    ClothState &state = this->_state;
+    PrimitiveData *primitiveData = this->_primitiveData.data();
+    pfloat3 *vertices = this->_vertices.data();
+    CollisionDelegate *pCollisionDelegate = this->_pCollisionDelegate;
+    const ClothSleep &sleep = *this->_pSleep;
+
+    this->_pThreadPool->parallelFor(sleep.getBlockCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            if (pCollisionDelegate != nullptr && sleep.wasActive(block, false)) {
+                constrainClothCollision(pCollisionDelegate, state, vertices, sleep.getBlockStart(block), sleep.getBlockEnd(block));
+            }
+        }
+    });
+
+    this->_pThreadPool->parallelFor(sleep.getBlockCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            if (!sleep.wasActive(block, true)) continue;
+            uint32_t first = sleep.getBlockStart(block), last = sleep.getBlockEnd(block);
+            if (n > 0) {
+                for (uint32_t y = first / n; y < last / n; y++) {
+                    this->_gridKernels.recalculateNormals(params, state, y, primitiveData);
+                }
+            }
+            else {
+                recalculateClothNormals(topology, state, first, last, primitiveData);
+            }
+        }
+    });
+    this->_pThreadPool->parallelFor(sleep.getBlockCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            if (!sleep.wasActive(block, false)) continue;
+            for (uint32_t index = sleep.getBlockStart(block); index < sleep.getBlockEnd(block); index++) {
+                vertices[index] = pfloat3{state.positionX[index], state.positionY[index], state.positionZ[index]};
+            }
+        }
+    });
+}
+
+void CpuCloth::setCollisionDelegate(CollisionDelegate *pCollisionDelegate) {
+    this->_pCollisionDelegate = pCollisionDelegate;
+    this->_pSleep->wakeAll();
+}
+
+void CpuCloth::setAttachments(const std::vector<Attachment> &attachments) {
+    this->_pAttachments->setAttachments(attachments);
+    this->_pSleep->wakeAll();
+}
+
+//the blocks attached to the handle wake at the start of the next update, once it is known to move
+void CpuCloth::setHandleTransform(uint32_t handle, simd::float4x4 transform) {
+    this->_pAttachments->setHandleTransform(handle, transform);
+}
+
+const ClothAttachments& CpuCloth::getAttachments() {
+    return *this->_pAttachments;
+}
+
+//only the explicit integrator tears, like it is the only one to sleep; a grid cloth stays on the grid layout until
+//tear first changes its topology
+void CpuCloth::setTearing(float strain, uint32_t spareParticles) {
+    delete this->_pTearing;
+    this->_pTearing = nullptr;
+    if (spareParticles == 0) return;
+    uint32_t capacity = this->_topology.particleCount + spareParticles;
+    this->_pTearing = new ClothTearing(this->_topology, strain, capacity);
+    this->_state.reserve(capacity);
+    this->_vertices.reserve(capacity);
+    if (this->_topology.gridSize == 0) this->layOutForTearing();
+}
+
+//the mesh kernels with sleep blocks and substep limit slots laid out for the whole capacity, so blocks past the last
+//particle wait empty until tearing fills them
+void CpuCloth::layOutForTearing() {
+    uint32_t capacity = this->_pTearing->getParticleCapacity();
+    this->_topology.gridSize = 0;
+    this->_substepLimits.resize((capacity + SUBSTEP_LIMIT_BLOCK - 1) / SUBSTEP_LIMIT_BLOCK);
+    delete this->_pSleep;
+    this->_pSleep = new ClothSleep(this->_topology, SUBSTEP_LIMIT_BLOCK, capacity);
+}
+
+void CpuCloth::wake() {
+    this->_pSleep->wakeAll();
+}
+
+void CpuCloth::setSelfCollision(bool enable) {
+    this->_selfCollision = enable;
+}
+
+ClothParameters CpuCloth::getParameters() {
+    return this->_parameters;
+}
+
+uint32_t CpuCloth::getTriangleCount() {
+    return this->_topology.triangleCount;
+}
+
+const ClothTopology& CpuCloth::getTopology() {
+    return this->_topology;
+}
+
+ClothState& CpuCloth::getState() {
+    return this->_state;
+}
+
+void CpuCloth::exportParticles(Particle *particles) {
+    this->_state.exportParticles(particles);
+}
+
+PrimitiveData* CpuCloth::getPrimitiveData() {
+    return this->_primitiveData.data();
+}
+
+pfloat3* CpuCloth::getVertices() {
+    return this->_vertices.data();
+}
+
+const uint32_t* CpuCloth::getIndices() {
+    return this->_topology.indices.data();
+}
+
+uint64_t CpuCloth::getParticleSubsteps() {
+    return this->_particleSubsteps;
+}
+
+double CpuCloth::getSimulationSeconds() {
+    return this->_simulationSeconds;
+}
+
+unsigned int CpuCloth::getSolverIterations() {
+    return this->_solverIterations;
+}
+
+uint32_t CpuCloth::getLastSubsteps() {
+    return this->_lastSubsteps;
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include "pathtracing/CpuPathTracer.hpp"
+
+//everything sampleSceneKernel reads through its buffers and textures, for one frame
+typedef struct TraceFrame {
+    const TraceScene *pScene;
+    const Intersector *pIntersector;
+    const HdriImage *pHdri;
+    simd::float3 origin;
+    simd::float4x4 pvMatInv, prevPvMat;
+    //each geometry's transpose of its inverse transform, which takes its normals to world space
+    const simd::float4x4 *normalTransforms;
+    uint32_t rand;
+    uint32_t width, height, spp, bounces, tilesX;
+    simd::float4 *depthNormal, *motion, *output;
+} TraceFrame;
+
+typedef void (*TileKernel)(const TraceFrame &frame, uint32_t tile);
+
+//the functions below follow Pathtracing.metal line by line, so the two can be compared side by side
+
+static float randUnif(uint32_t x, uint32_t y, uint32_t n) {
+    uint32_t seed = x + y * 57 + n * 241;
+    seed = (seed << 13) ^ seed;
+    return (( 1.f - ( (seed * (seed * seed * 15731 + 789221) + 1376312589) & 2147483647) / 1073741824.0f) + 1.0f) / 2.0f;
+}
+
+//assume normal is UP(Y)
+static float schlickFresnel(simd::float3 incidence, float ior1, float ior2) {
+    float oneMinusCosTheta = 1 - incidence.y;
+    float oneMinusCosThetaSquared = oneMinusCosTheta * oneMinusCosTheta;
+    float r0 = (ior1 - ior2) / (ior1 + ior2);
+    r0 = r0 * r0;
+    return r0 + (1 - r0) * oneMinusCosThetaSquared * oneMinusCosThetaSquared * oneMinusCosTheta;
+}
+
+//assume normal is UP(Y)
+static float smithG1(simd::float3 viewOut, float a2) {
+    return 2 * viewOut.y / (sqrtf(a2 + (1 - a2) * viewOut.y * viewOut.y) + viewOut.y);
+}
+
+//assume normal is UP(Y)
+static float smithG2(simd::float3 lightIn, simd::float3 viewOut, float a2) {
+    return 2 * lightIn.y * viewOut.y / (viewOut.y * sqrtf(a2 + (1 - a2) * lightIn.y * lightIn.y) + lightIn.y * sqrtf(a2 + (1 - a2) * viewOut.y * viewOut.y));
+}
+
+static simd::float3 reflect(simd::float3 incident, simd::float3 normal) {
+    return incident - 2 * simd::dot(normal, incident) * normal;
+}
+
+//adapted from https://jcgt.org/published/0007/04/01/paper.pdf
+//assume normal is UP(Y)
+static simd::float3 sampleGgxVndf(simd::float3 viewOut, float roughness, float rand1, float rand2) {
+    simd::float3 viewHemisphere = simd::normalize(simd::float3{roughness * viewOut.x, viewOut.y, roughness * viewOut.z});
+    float lengthSquared = viewHemisphere.x * viewHemisphere.x + viewHemisphere.z * viewHemisphere.z;
+    simd::float3 b1 = lengthSquared > EPSILON ? simd::float3{-viewHemisphere.z, 0, viewHemisphere.x} / sqrtf(lengthSquared) : simd::float3{1, 0, 0};
+    simd::float3 b2 = simd::cross(viewHemisphere, b1);
+    float r = sqrtf(rand1);
+    float phi = 2 * (float)M_PI * rand2;
+    float t1 = r * cosf(phi);
+    float t2 = r * sinf(phi);
+    float s = 0.5f * (1 + viewHemisphere.y);
+    t2 = (1 - s) * sqrtf(1 - t1 * t1) + s * t2;
+    simd::float3 normHemisphere = t1 * b1 + t2 * b2 + sqrtf(fmaxf(0.0f, 1 - t1 * t1 - t2 * t2)) * viewHemisphere;
+    return simd::normalize(simd::float3{roughness * normHemisphere.x, fmaxf(0.0f, normHemisphere.y), roughness * normHemisphere.z});
+}
+
+static simd::float4 importanceSampleGgxVndf(uint32_t x, uint32_t y, uint32_t rand, simd::float3 normal, simd::float3 direction, float roughness) {
+    float a2 = roughness * roughness;
+    float projY = simd::dot(normal, -direction);
+    simd::float3 b1 = simd::normalize(simd::cross(normal, -direction));
+    simd::float3 b2 = simd::cross(b1, normal);
+    simd::float3 viewOut = simd::float3{sqrtf(1 - projY * projY), projY, 0};
+    simd::float3 ggxNorm = sampleGgxVndf(viewOut, roughness, randUnif(x, y, rand), randUnif(x, y, rand + 1));
+    simd::float3 lightIn = -reflect(viewOut, ggxNorm);
+    simd::float3 world = lightIn.x * b2 + lightIn.y * normal + lightIn.z * b1;
+    return simd::float4{world.x, world.y, world.z, lightIn.y > 0 ? schlickFresnel(-viewOut, 1, 1) * smithG2(lightIn, viewOut, a2) / smithG1(viewOut, a2) : 0};
+}
+
+static float saturate(float x) {
+    return fminf(fmaxf(x, 0), 1);
+}
+
+static simd::float3 acesTonemap(simd::float3 x) {
+    float a = 2.51f;
+    float b = 0.03f;
+    float c = 2.43f;
+    float d = 0.59f;
+    float e = 0.14f;
+    simd::float3 mapped = (x * (a * x + b)) / (x * (c * x + d) + e);
+    return simd::float3{saturate(mapped.x), saturate(mapped.y), saturate(mapped.z)};
+}
+
+static simd::float2 samplePrevUv(const PrimitiveData &data, simd::float2 uv) {
+    float v0x = data.v1CurrUV.x - data.v0CurrUV.x, v0y = data.v1CurrUV.y - data.v0CurrUV.y;
+    float v1x = data.v2CurrUV.x - data.v0CurrUV.x, v1y = data.v2CurrUV.y - data.v0CurrUV.y;
+    float v2x = uv.x - data.v0CurrUV.x, v2y = uv.y - data.v0CurrUV.y;
+    float d00 = v0x * v0x + v0y * v0y;
+    float d01 = v0x * v1x + v0y * v1y;
+    float d11 = v1x * v1x + v1y * v1y;
+    float d20 = v2x * v0x + v2y * v0y;
+    float d21 = v2x * v1x + v2y * v1y;
+    float denominator = d00 * d11 - d01 * d01;
+    float b1 = (d11 * d20 - d01 * d21) / denominator, b2 = (d00 * d21 - d01 * d20) / denominator;
+    float b0 = 1 - b1 - b2;
+    return simd::float2{
+        b0 * data.v0PrevUV.x + b1 * data.v1PrevUV.x + b2 * data.v2PrevUV.x,
+        b0 * data.v0PrevUV.y + b1 * data.v1PrevUV.y + b2 * data.v2PrevUV.y
+    };
+}
+
+static simd::float2 worldToUv(const simd::float4x4 &pvMat, simd::float3 position) {
+    simd::float4 clipCoord = pvMat * simd::float4{position.x, position.y, position.z, 1};
+    return simd::float2{(clipCoord.x / -clipCoord.w + 1) / 2, (clipCoord.y / -clipCoord.w + 1) / 2};
+}
+
+static TraceRay generatePrimaryRay(const simd::float4x4 &pvMatInv, simd::float3 origin, simd::float2 uv) {
+    simd::float4 direction = pvMatInv * simd::float4{2 * uv.x - 1, 2 * uv.y - 1, 1, -1};
+    return TraceRay{origin, simd::normalize(simd::float3{direction.x, direction.y, direction.z}), EPSILON, INFINITY};
+}
+
+//S and B are the samples and bounces the kernel is built for, 0 for those of the frame
+template <uint32_t S, uint32_t B>
+static void samplePixel(const TraceFrame &frame, uint32_t x, uint32_t y) {
+    const uint32_t spp = S ? S : frame.spp;
+    const uint32_t bounces = B ? B : frame.bounces;
+    const TraceScene &scene = *frame.pScene;
+    uint32_t pixel = y * frame.width + x;
+    simd::float3 accumulatedColor = simd::float3{0, 0, 0};
+
+    for (uint32_t i = 0; i < spp; i++) {
+        simd::float2 uv = simd::float2{(float)x / frame.width, (float)y / frame.height};
+        TraceRay ray = generatePrimaryRay(frame.pvMatInv, frame.origin, uv);
+        simd::float3 rayColor = simd::float3{1, 1, 1};
+        bool firstBounceReflect = false;
+
+        for (uint32_t j = 0; j < bounces; j++) {
+            TraceHit intersection;
+            //a miss has no geometry to read, where the kernel reads whatever the intersector left; it reports an
+            //infinite depth and no motion
+            if (!frame.pIntersector->intersect(ray, intersection)) {
+                if (j == 0 || firstBounceReflect) {
+                    frame.depthNormal[pixel] = simd::float4{INFINITY, 0, 0, 0};
+                    frame.motion[pixel] = simd::float4{0, 0, 0, 1};
+                }
+                rayColor *= frame.pHdri->sample(ray.direction);
+                accumulatedColor += rayColor / spp;
+                break;
+            }
+
+            const TraceGeometry &geometry = scene.geometries[intersection.geometryId];
+            const Material &mat = scene.materials[scene.geometryMaterials[intersection.geometryId]];
+            const PrimitiveData &data = geometry.primitiveData[intersection.primitiveId];
+            simd::float3 barycentricCoords = simd::float3{1 - intersection.barycentricCoord.x - intersection.barycentricCoord.y, intersection.barycentricCoord.x, intersection.barycentricCoord.y};
+            simd::float3 hitPosition = ray.origin + intersection.distance * ray.direction;
+            simd::float2 prevUv = geometry.dynamic ? samplePrevUv(data, uv) : worldToUv(frame.prevPvMat, hitPosition);
+            simd::float2 dUv = simd::float2{uv.x - prevUv.x, uv.y - prevUv.y};
+            simd::float3 objectNormal = barycentricCoords.x * data.v0Normal + barycentricCoords.y * data.v1Normal + barycentricCoords.z * data.v2Normal;
+            simd::float4 worldNormal = frame.normalTransforms[intersection.geometryId] * simd::float4{objectNormal.x, objectNormal.y, objectNormal.z, 0};
+            simd::float3 surfaceNormal = simd::normalize(simd::float3{worldNormal.x, worldNormal.y, worldNormal.z});
+            surfaceNormal = simd::dot(surfaceNormal, ray.direction) < 0 ? surfaceNormal : -surfaceNormal;
+
+            simd::float4 ggxSample = importanceSampleGgxVndf(x, y, frame.rand * (i + 1) * (j + 1), surfaceNormal, ray.direction, mat.roughness);
+
+            if (j == 0 || firstBounceReflect) {
+                firstBounceReflect = mat.roughness < 0.2;
+                frame.depthNormal[pixel] = simd::float4{intersection.distance, surfaceNormal.x, surfaceNormal.y, surfaceNormal.z};
+                frame.motion[pixel] = simd::float4{dUv.x, dUv.y, 0, 1};
+            }
+
+            rayColor *= mat.color;
+            ray.origin += intersection.distance * ray.direction;
+            ray.direction = simd::float3{ggxSample.x, ggxSample.y, ggxSample.z};
+        }
+    }
+    simd::float3 color = acesTonemap(accumulatedColor);
+    frame.output[pixel] = simd::float4{color.x, color.y, color.z, 1};
+}
+
+template <uint32_t S, uint32_t B>
+static void sampleTile(const TraceFrame &frame, uint32_t tile) {
+    uint32_t x0 = tile % frame.tilesX * TILE_SIZE, y0 = tile / frame.tilesX * TILE_SIZE;
+    uint32_t x1 = std::min(x0 + TILE_SIZE, frame.width), y1 = std::min(y0 + TILE_SIZE, frame.height);
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = x0; x < x1; x++) {
+            samplePixel<S, B>(frame, x, y);
+        }
+    }
+}
+
+//the Renderer's 32 samples and 8 bounces, and the single sample the denoiser can work from, get their own kernels
+static TileKernel getTileKernel(uint32_t spp, uint32_t bounces) {
+    if (bounces == 8) {
+        switch (spp) {
+            case 1: return sampleTile<1, 8>;
+            case 32: return sampleTile<32, 8>;
+        }
+    }
+    return sampleTile<0, 0>;
+}
+
+CpuPathTracer::CpuPathTracer(ThreadPool *pThreadPool, uint32_t width, uint32_t height, uint32_t spp, uint32_t bounces) : _scheduler(pThreadPool) {
+    this->_width = width;
+    this->_height = height;
+    this->_spp = spp;
+    this->_bounces = bounces;
+    this->_depthNormal.resize(width * height);
+    this->_motion.resize(width * height);
+    this->_output.resize(width * height);
+}
+
+void CpuPathTracer::render(const TraceScene &scene, const Intersector &intersector, const HdriImage &hdri, simd::float3 origin, simd::float4x4 pvMatInv, simd::float4x4 prevPvMat, uint32_t rand) {
+    this->_normalTransforms.resize(scene.geometries.size());
+    for (uint32_t i = 0; i < scene.geometries.size(); i++) {
+        this->_normalTransforms[i] = simd_transpose(simd_inverse(scene.geometries[i].transform));
+    }
+    TraceFrame frame = {
+        .pScene = &scene,
+        .pIntersector = &intersector,
+        .pHdri = &hdri,
+        .origin = origin,
+        .pvMatInv = pvMatInv,
+        .prevPvMat = prevPvMat,
+        .normalTransforms = this->_normalTransforms.data(),
+        .rand = rand,
+        .width = this->_width,
+        .height = this->_height,
+        .spp = this->_spp,
+        .bounces = this->_bounces,
+        .tilesX = (this->_width + TILE_SIZE - 1) / TILE_SIZE,
+        .depthNormal = this->_depthNormal.data(),
+        .motion = this->_motion.data(),
+        .output = this->_output.data()
+    };
+    TileKernel kernel = getTileKernel(this->_spp, this->_bounces);
+    this->_scheduler.run(this->getTileCount(), [&](uint32_t tile, unsigned int) {
+        kernel(frame, tile);
+    });
+}
+
+uint32_t CpuPathTracer::getWidth() {
+    return this->_width;
+}
+
+uint32_t CpuPathTracer::getHeight() {
+    return this->_height;
+}
+
+const std::vector<simd::float4>& CpuPathTracer::getDepthNormal() {
+    return this->_depthNormal;
+}
+
+const std::vector<simd::float4>& CpuPathTracer::getMotion() {
+    return this->_motion;
+}
+
+const std::vector<simd::float4>& CpuPathTracer::getOutput() {
+    return this->_output;
+}
+
+uint32_t CpuPathTracer::getTileCount() {
+    return ((this->_width + TILE_SIZE - 1) / TILE_SIZE) * ((this->_height + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+uint32_t CpuPathTracer::getLastStolenTiles() {
+    return this->_scheduler.getLastStolen();
+}
@@ -0,0 +1,111 @@
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include "HdriImage.hpp"
+
+HdriImage::HdriImage(const char *fileName) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) throw std::runtime_error("could not open hdri");
+
+    char sign, coord;
+    std::string line;
+
+    file >> line;
+    if (line != "#?RADIANCE") throw std::runtime_error("not a radiance hdri");
+
+    file >> line;
+    if (line != "FORMAT=32-bit_rle_rgbe") throw std::runtime_error("hdri is not 32-bit rle rgbe");
+
+    file >> sign >> coord >> this->_sizeY;
+    if (coord != 'Y') throw std::runtime_error("hdri is not stored by rows");
+    this->_flipY = sign == '-';
+
+    file >> sign >> coord >> this->_sizeX;
+    if (coord != 'X') throw std::runtime_error("hdri is not stored by rows");
+    this->_flipX = sign == '-';
+
+    unsigned char mode = 0, last = 0, ctr = 0;
+    std::vector<uint32_t> workBuffer(this->_sizeX * this->_sizeY, 0);
+
+    file.get();
+    for (uint32_t i = 0; i < this->_sizeY; i++) {
+        file.get();
+        file.get();
+        file.get();
+        file.get();
+        for (int _ = 0; _ < 4; _++) {
+            for (uint32_t j = 0; j < this->_sizeX; j++) {
+                if (!ctr) {
+                    ctr = file.get();
+                    mode = ctr > 128;
+                    last = mode ? file.get() : 0;
+                    ctr = mode ? ctr - 128 : ctr;
+                }
+                ctr--;
+                uint32_t data = workBuffer[i * this->_sizeX + j];
+                data <<= 8;
+                data += mode ? last : file.get();
+                workBuffer[i * this->_sizeX + j] = data;
+            }
+        }
+    }
+    this->_data.resize(this->_sizeX * this->_sizeY);
+    for (uint32_t i = 0; i < this->_sizeY; i++) {
+        for (uint32_t j = 0; j < this->_sizeX; j++) {
+            uint32_t data = workBuffer[(this->_flipY ? this->_sizeY - i - 1 : i) * this->_sizeX + (this->_flipX ? this->_sizeX - j - 1 : j)];
+            unsigned char r = (data >> 24) & 0xff;
+            unsigned char g = (data >> 16) & 0xff;
+            unsigned char b = (data >> 8) & 0xff;
+            unsigned char e = data & 0xff;
+            float mul = pow(2, e - 128) / 256;
+            this->_data[i * this->_sizeX + j] = simd::float4{mul * (r + 0.5f), mul * (g + 0.5f), mul * (b + 0.5f), 1};
+        }
+    }
+}
+
+HdriImage::HdriImage(simd::float3 color) {
+    this->_sizeX = 1;
+    this->_sizeY = 1;
+    this->_data.push_back(simd::float4{color.x, color.y, color.z, 1});
+}
+
+bool HdriImage::getFlipX() const {
+    return this->_flipX;
+}
+
+bool HdriImage::getFlipY() const {
+    return this->_flipY;
+}
+
+uint32_t HdriImage::getSizeX() const {
+    return this->_sizeX;
+}
+
+uint32_t HdriImage::getSizeY() const {
+    return this->_sizeY;
+}
+
+const simd::float4* HdriImage::getData() const {
+    return this->_data.data();
+}
+
+simd::float4 HdriImage::getTexel(int32_t x, int32_t y) const {
+    x = x < 0 ? 0 : (x >= (int32_t)this->_sizeX ? this->_sizeX - 1 : x);
+    y = y < 0 ? 0 : (y >= (int32_t)this->_sizeY ? this->_sizeY - 1 : y);
+    return this->_data[y * this->_sizeX + x];
+}
+
+simd::float3 HdriImage::sample(simd::float3 direction) const {
+    float xzLength = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    float u = atan2f(direction.z / xzLength, direction.x / xzLength) / 2 / M_PI + 0.5f;
+    float v = asinf(direction.y) / M_PI + 0.5f;
+
+    //texel centres sit at half coordinates, as on the GPU
+    float x = u * this->_sizeX - 0.5f, y = v * this->_sizeY - 0.5f;
+    float x0 = floorf(x), y0 = floorf(y);
+    float fx = x - x0, fy = y - y0;
+    simd::float4 top = simd::mix(this->getTexel(x0, y0), this->getTexel(x0 + 1, y0), fx);
+    simd::float4 bottom = simd::mix(this->getTexel(x0, y0 + 1), this->getTexel(x0 + 1, y0 + 1), fx);
+    simd::float4 color = simd::mix(top, bottom, fy);
+    return simd::float3{color.x, color.y, color.z};
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include "simulation/ClothKernels.hpp"
+#include "simulation/ImplicitSolver.hpp"
+
+//rows are reduced in fixed blocks rather than per thread, so dot products sum in the same order for any thread count
+constexpr uint32_t REDUCTION_BLOCK = 256;
+
+ImplicitSolver::ImplicitSolver(const ClothParameters &params, const ClothTopology &topology) {
+    this->_parameters = params;
+    this->_pTopology = &topology;
+
+    //one block per particle plus one per spring of its row; the rows are already sorted, so the diagonal only needs
+    //slotting in before the first larger neighbour
+    std::vector<uint32_t> rowStarts = {0}, columns;
+    std::vector<float> restLengths;
+    for (uint32_t i = 0; i < topology.particleCount; i++) {
+        bool diagonal = false;
+        for (uint32_t spring = topology.getSpringStart(i); spring < topology.getSpringEnd(i); spring++) {
+            if (!diagonal && topology.springNeighbours[spring] > i) {
+                columns.push_back(i);
+                restLengths.push_back(0);
+                diagonal = true;
+            }
+            columns.push_back(topology.springNeighbours[spring]);
+            restLengths.push_back(topology.springRestLengths[spring]);
+        }
+        if (!diagonal) {
+            columns.push_back(i);
+            restLengths.push_back(0);
+        }
+        rowStarts.push_back(columns.size());
+    }
+    this->_matrix.setPattern(rowStarts, columns);
+    this->_restLengths = restLengths;
+
+    uint32_t count = topology.particleCount;
+    this->_preconditioner.resize(count);
+    for (std::vector<simd::float3> *pVector: {&this->_rhs, &this->_dv, &this->_residual, &this->_preconditioned, &this->_direction, &this->_product}) {
+        pVector->resize(count);
+    }
+    this->_partialSums[0].resize((count + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK);
+    this->_partialSums[1].resize(this->_partialSums[0].size());
+}
+
+void ImplicitSolver::setTolerance(float tolerance) {
+    this->_tolerance = tolerance;
+}
+
+void ImplicitSolver::setMaxIterations(unsigned int maxIterations) {
+    this->_maxIterations = maxIterations;
+}
+
+unsigned int ImplicitSolver::step(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt, bool enableWind, const WindField *pWindField) {
+    const ClothTopology &topology = *this->_pTopology;
+    pThreadPool->parallelFor(topology.triangleCount, [&](uint32_t begin, uint32_t end) {
+        computeClothTriangleDrag(topology, state, begin, end, enableWind, pWindField);
+    });
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        accumulateClothForces(this->_parameters, topology, state, begin, end);
+    });
+
+    pThreadPool->parallelFor(attachments.getAttachmentCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t a = begin; a < end; a++) {
+            const Attachment &attachment = attachments.getAttachments()[a];
+            if (attachments.isHard(attachment.particle)) {
+                state.setVelocity(attachment.particle, (attachments.getTarget(attachment, 1) - state.getPosition(attachment.particle)) / dt);
+            }
+        }
+    });
+    this->assemble(pThreadPool, state, attachments, dt);
+    unsigned int iterations = this->solve(pThreadPool);
+
+    //the velocity change is applied directly, so motion runs with the accelerations cleared and only advances positions
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            state.setVelocity(i, state.getVelocity(i) + this->_dv[i]);
+            state.setAcceleration(i, simd::float3{});
+        }
+        simulateClothMotion(state, begin, end, dt);
+    });
+    pThreadPool->parallelFor(attachments.getAttachmentCount(), [&](uint32_t begin, uint32_t end) {
+        applyClothAttachments(this->_parameters, attachments, state, begin, end, dt, 1);
+    });
+    return iterations;
+}
+
+//(I - h dA/dv - h^2 dA/dx) dv = h (a + h dA/dx v), written per particle so rows assemble independently
+void ImplicitSolver::assemble(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt) {
+    const float springScale = this->_parameters.springConstant / this->_parameters.particleMass / 2;
+    const float damperScale = this->_parameters.dampingConstant / this->_parameters.particleMass / 2;
+    BlockSparseMatrix &matrix = this->_matrix;
+
+    pThreadPool->parallelFor(matrix.getRowCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            Block3 &diagonal = matrix.getBlock(matrix.getDiagonal(i));
+            diagonal = Block3::identity();
+            simd::float3 rhs = dt * state.getAcceleration(i);
+            simd::float3 position = state.getPosition(i), velocity = state.getVelocity(i);
+
+            for (uint32_t block = matrix.getRowStart(i); block < matrix.getRowEnd(i); block++) {
+                uint32_t j = matrix.getColumn(block);
+                if (j == i) continue;
+                Block3 &offDiagonal = matrix.getBlock(block);
+                simd::float3 displacement = state.getPosition(j) - position;
+                float distance = simd::length(displacement);
+                if (!(distance > 0)) {
+                    offDiagonal = Block3::zero();
+                    continue;
+                }
+
+                //compressed springs drop their geometric stiffness so the system stays positive definite
+                simd::float3 direction = displacement / distance;
+                Block3 axial = Block3::outer(direction, direction);
+                float transverse = std::max(0.0f, 1 - this->_restLengths[block] / distance);
+                Block3 stiffness = (axial + (Block3::identity() - axial) * transverse) * springScale;
+                Block3 coupling = axial * (dt * damperScale) + stiffness * (dt * dt);
+
+                diagonal += coupling;
+                rhs += dt * dt * (stiffness * (state.getVelocity(j) - velocity));
+                offDiagonal = attachments.isHard(i) || attachments.isHard(j) ? Block3::zero() : coupling * -1;
+            }
+
+            //hard attached particles already move with their handle, so their velocity change is held at zero
+            if (attachments.isHard(i)) {
+                diagonal = Block3::identity();
+                rhs = simd::float3{};
+            }
+            this->_rhs[i] = rhs;
+            this->_preconditioner[i] = diagonal.inverse();
+        }
+    });
+}
+
+unsigned int ImplicitSolver::solve(ThreadPool *pThreadPool) {
+    const uint32_t count = this->_matrix.getRowCount();
+    const uint32_t blocks = this->_partialSums[0].size();
+    simd::float3 *dv = this->_dv.data(), *rhs = this->_rhs.data(), *residual = this->_residual.data();
+    simd::float3 *preconditioned = this->_preconditioned.data(), *direction = this->_direction.data(), *product = this->_product.data();
+    float *partialA = this->_partialSums[0].data(), *partialB = this->_partialSums[1].data();
+    auto sumPartials = [&](float *partial) {
+        float sum = 0;
+        for (uint32_t i = 0; i < blocks; i++) sum += partial[i];
+        return sum;
+    };
+
+    //dv = 0, r = b, z = Pr, p = z
+    pThreadPool->parallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            float rz = 0, bb = 0;
+            for (uint32_t i = block * REDUCTION_BLOCK; i < std::min(count, (block + 1) * REDUCTION_BLOCK); i++) {
+                dv[i] = simd::float3{};
+                residual[i] = rhs[i];
+                preconditioned[i] = this->_preconditioner[i] * residual[i];
+                direction[i] = preconditioned[i];
+                rz += simd::dot(residual[i], preconditioned[i]);
+                bb += simd::dot(rhs[i], rhs[i]);
+            }
+            partialA[block] = rz;
+            partialB[block] = bb;
+        }
+    });
+    float rz = sumPartials(partialA);
+    float threshold = this->_tolerance * this->_tolerance * sumPartials(partialB);
+    if (threshold == 0) return 0;
+
+    unsigned int iteration = 0;
+    while (iteration < this->_maxIterations) {
+        iteration++;
+
+        //q = Ap
+        pThreadPool->parallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t block = begin; block < end; block++) {
+                uint32_t first = block * REDUCTION_BLOCK, last = std::min(count, (block + 1) * REDUCTION_BLOCK);
+                this->_matrix.multiply(direction, product, first, last);
+                float pq = 0;
+                for (uint32_t i = first; i < last; i++) pq += simd::dot(direction[i], product[i]);
+                partialA[block] = pq;
+            }
+        });
+        float pq = sumPartials(partialA);
+        if (!(pq > 0)) break;
+        float alpha = rz / pq;
+
+        //dv += alpha p, r -= alpha q, z = Pr
+        pThreadPool->parallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t block = begin; block < end; block++) {
+                float rr = 0, rzNext = 0;
+                for (uint32_t i = block * REDUCTION_BLOCK; i < std::min(count, (block + 1) * REDUCTION_BLOCK); i++) {
+                    dv[i] += alpha * direction[i];
+                    residual[i] -= alpha * product[i];
+                    preconditioned[i] = this->_preconditioner[i] * residual[i];
+                    rr += simd::dot(residual[i], residual[i]);
+                    rzNext += simd::dot(residual[i], preconditioned[i]);
+                }
+                partialA[block] = rr;
+                partialB[block] = rzNext;
+            }
+        });
+        if (sumPartials(partialA) <= threshold) break;
+        float rzNext = sumPartials(partialB);
+        float beta = rzNext / rz;
+        rz = rzNext;
+
+        //p = z + beta p
+        pThreadPool->parallelFor(count, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                direction[i] = preconditioned[i] + beta * direction[i];
+            }
+        });
+    }
+    return iteration;
+}
@@ -0,0 +1,82 @@
+#include <cstring>
+#include <stdexcept>
+#include "InputRecording.hpp"
+
+constexpr size_t INPUT_FRAME_BYTES = 32;
+
+//field by field, so the file has no padding and does not depend on how the compiler lays out InputFrame
+static void packFrame(const InputFrame &frame, uint8_t *bytes) {
+    float floats[6] = {frame.dt, frame.pitch, frame.yaw, frame.position.x, frame.position.y, frame.position.z};
+    memcpy(bytes, floats, sizeof(floats));
+    bytes[24] = (uint8_t)(int8_t)frame.clothDirection.x;
+    bytes[25] = (uint8_t)(int8_t)frame.clothDirection.y;
+    bytes[26] = (uint8_t)(int8_t)frame.clothDirection.z;
+    bytes[27] = frame.wind;
+    memcpy(bytes + 28, &frame.seed, sizeof(uint32_t));
+}
+
+static void unpackFrame(const uint8_t *bytes, InputFrame &frame) {
+    float floats[6];
+    memcpy(floats, bytes, sizeof(floats));
+    frame.dt = floats[0];
+    frame.pitch = floats[1];
+    frame.yaw = floats[2];
+    frame.position = simd::float3{floats[3], floats[4], floats[5]};
+    frame.clothDirection = simd::float3{(float)(int8_t)bytes[24], (float)(int8_t)bytes[25], (float)(int8_t)bytes[26]};
+    frame.wind = bytes[27] != 0;
+    memcpy(&frame.seed, bytes + 28, sizeof(uint32_t));
+}
+
+InputWriter::InputWriter(const char *fileName) {
+    this->_pFile = fopen(fileName, "wb");
+    if (this->_pFile == nullptr) throw std::runtime_error("could not open input recording for writing");
+
+    InputHeader header = {.magic = {'M', 'C', 'I', 'R'}, .version = INPUT_VERSION};
+    fwrite(&header, sizeof(InputHeader), 1, this->_pFile);
+}
+
+InputWriter::~InputWriter() {
+    fclose(this->_pFile);
+}
+
+void InputWriter::addFrame(const InputFrame &frame) {
+    uint8_t bytes[INPUT_FRAME_BYTES];
+    packFrame(frame, bytes);
+    fwrite(bytes, INPUT_FRAME_BYTES, 1, this->_pFile);
+    this->_frameCount++;
+}
+
+uint32_t InputWriter::getFrameCount() {
+    return this->_frameCount;
+}
+
+InputReader::InputReader(const char *fileName) {
+    this->_pFile = fopen(fileName, "rb");
+    if (this->_pFile == nullptr) throw std::runtime_error("could not open input recording");
+
+    InputHeader header;
+    if (fread(&header, sizeof(InputHeader), 1, this->_pFile) != 1 || memcmp(header.magic, "MCIR", 4) != 0 || header.version != INPUT_VERSION) {
+        fclose(this->_pFile);
+        throw std::runtime_error("not an input recording of this version");
+    }
+    //a recording cut off mid-frame keeps its whole frames
+    fseek(this->_pFile, 0, SEEK_END);
+    this->_frameCount = (ftell(this->_pFile) - sizeof(InputHeader)) / INPUT_FRAME_BYTES;
+    fseek(this->_pFile, sizeof(InputHeader), SEEK_SET);
+}
+
+InputReader::~InputReader() {
+    fclose(this->_pFile);
+}
+
+uint32_t InputReader::getFrameCount() {
+    return this->_frameCount;
+}
+
+bool InputReader::readFrame(InputFrame &frame) {
+    uint8_t bytes[INPUT_FRAME_BYTES];
+    if (this->_readFrames == this->_frameCount || fread(bytes, INPUT_FRAME_BYTES, 1, this->_pFile) != 1) return false;
+    unpackFrame(bytes, frame);
+    this->_readFrames++;
+    return true;
+}
@@ -0,0 +1,35 @@
+#include "pathtracing/Intersector.hpp"
+
+void TriangleListIntersector::build(const TraceScene &scene) {
+    this->_geometries = scene.geometries;
+    this->_lowerBounds.assign(scene.geometries.size(), simd::float3{INFINITY, INFINITY, INFINITY});
+    this->_upperBounds.assign(scene.geometries.size(), simd::float3{-INFINITY, -INFINITY, -INFINITY});
+    for (uint32_t i = 0; i < scene.geometries.size(); i++) {
+        const TraceGeometry &geometry = scene.geometries[i];
+        for (uint32_t j = 0; j < 3 * geometry.triangleCount; j++) {
+            simd::float3 vertex = geometry.getVertex(geometry.indices[j]);
+            this->_lowerBounds[i] = simd::min(this->_lowerBounds[i], vertex);
+            this->_upperBounds[i] = simd::max(this->_upperBounds[i], vertex);
+        }
+    }
+}
+
+bool TriangleListIntersector::intersect(const TraceRay &ray, TraceHit &hit) const {
+    simd::float3 inverseDirection = 1 / ray.direction;
+    TraceRay closest = ray;
+    bool found = false;
+    for (uint32_t i = 0; i < this->_geometries.size(); i++) {
+        if (!intersectBounds(closest, inverseDirection, this->_lowerBounds[i], this->_upperBounds[i], closest.maxDistance)) continue;
+        const TraceGeometry &geometry = this->_geometries[i];
+        for (uint32_t j = 0; j < geometry.triangleCount; j++) {
+            const uint32_t *indices = geometry.indices + 3 * j;
+            float distance;
+            simd::float2 barycentricCoord;
+            if (!intersectTriangle(closest, geometry.getVertex(indices[0]), geometry.getVertex(indices[1]), geometry.getVertex(indices[2]), distance, barycentricCoord)) continue;
+            closest.maxDistance = distance;
+            hit = TraceHit{.distance = distance, .barycentricCoord = barycentricCoord, .geometryId = i, .primitiveId = j};
+            found = true;
+        }
+    }
+    return found;
+}
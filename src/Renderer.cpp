@@ -45,15 +45,18 @@ Renderer::Renderer(MTL::Device *pDevice, EventView *pView) {
     this->_pOutputTexture = this->_pDevice->newTexture(pFrameDescriptor);
     
 
-    this->_projectionMatrix = simd::float4x4{
-        simd::float4{1 / tan(FOV), 0, 0, 0},
-        simd::float4{0, 1 / (aspectRatio * tan(FOV)), 0, 0},
-        simd::float4{0, 0, 1, -1},
-        simd::float4{0, 0, -2, 0}
-    };
+    this->_projectionMatrix = getProjectionMatrix(aspectRatio);
     
     this->loadScene(new TestScene(this->_pDevice));
 
+    if (const char *pFileName = getenv("METALCLOTH_REPLAY")) {
+        this->_pInputReader = new InputReader(pFileName);
+        this->_replayStart = std::chrono::steady_clock::now();
+    }
+    else if (const char *pFileName = getenv("METALCLOTH_RECORD")) {
+        this->_pInputWriter = new InputWriter(pFileName);
+    }
+
     pFunctionConstants->release();
     pLibrary->release();
     pMotionFunction->release();
@@ -76,25 +79,26 @@ Renderer::~Renderer() {
     this->_pDepthNormalTextures[1]->release();
     this->_pMotionTexture->release();
     this->_pOutputTexture->release();
-    this->_pGeometryMaterialBuffer->release();
+    this->_pInstanceDataBuffer->release();
     this->_pMaterialBuffer->release();
-    this->_pScratchBuffer->release();
-    this->_pAccelerationStructure->release();
+    delete this->_pAccelerationStructure;
     delete this->_pScene;
+    delete this->_pInputWriter;
+    delete this->_pInputReader;
 }
 
 void Renderer::loadScene(Scene *pScene) {
     if (this->_pScene != nullptr) {
         this->_pHdriTexture->release();
-        this->_pGeometryMaterialBuffer->release();
+        this->_pInstanceDataBuffer->release();
         this->_pMaterialBuffer->release();
-        this->_pScratchBuffer->release();
-        this->_pAccelerationStructure->release();
+        delete this->_pAccelerationStructure;
         delete this->_pScene;
     }
 
     this->_pScene = pScene;
     this->_camera = this->_pScene->getInitialCamera();
+    this->_prevPvMat = this->_projectionMatrix * simd_inverse(getCameraMatrix(this->_camera));
 
     uint32_t hdriWidth = this->_pScene->getHdri()->getSizeX();
     uint32_t hdriHeight = this->_pScene->getHdri()->getSizeY();
@@ -119,50 +123,72 @@ void Renderer::loadScene(Scene *pScene) {
         MTL::Origin::Make(0, 0, 0)
     );
     pBCEnc->endEncoding();
+    this->_pAccelerationStructure = new SceneAccelerationStructure(this->_pDevice, pCmd, this->_pScene->getSceneObjects(), this->_pScene->getInstances());
     pCmd->commit();
 
-    std::vector<uint16_t> geometryMaterials = this->_pScene->getGeometryMaterials();
+    std::vector<InstanceData> instanceData = this->_pScene->getInstanceData();
     std::vector<Material> materials = this->_pScene->getMaterials();
-    MTL::AccelerationStructureSizes sizes = this->_pDevice->accelerationStructureSizes(this->_pScene->getDescriptor());
 
-    this->_pGeometryMaterialBuffer = this->_pDevice->newBuffer(geometryMaterials.size() * sizeof(uint16_t), MTL::ResourceStorageModeManaged);
+    this->_pInstanceDataBuffer = this->_pDevice->newBuffer(instanceData.size() * sizeof(InstanceData), MTL::ResourceStorageModeManaged);
     this->_pMaterialBuffer = this->_pDevice->newBuffer(materials.size() * sizeof(Material), MTL::ResourceStorageModeManaged);
-    this->_pScratchBuffer = this->_pDevice->newBuffer(sizes.buildScratchBufferSize, MTL::ResourceStorageModePrivate);
-    this->_pAccelerationStructure = this->_pDevice->newAccelerationStructure(sizes.accelerationStructureSize);
 
-    memcpy(this->_pGeometryMaterialBuffer->contents(), geometryMaterials.data(), this->_pGeometryMaterialBuffer->length());
+    memcpy(this->_pInstanceDataBuffer->contents(), instanceData.data(), this->_pInstanceDataBuffer->length());
     memcpy(this->_pMaterialBuffer->contents(), materials.data(), this->_pMaterialBuffer->length());
-    this->_pGeometryMaterialBuffer->didModifyRange(NS::Range::Make(0, this->_pGeometryMaterialBuffer->length()));
+    this->_pInstanceDataBuffer->didModifyRange(NS::Range::Make(0, this->_pInstanceDataBuffer->length()));
     this->_pMaterialBuffer->didModifyRange(NS::Range::Make(0, this->_pMaterialBuffer->length()));
 }
 
-void Renderer::draw(MTK::View *pView) {
+//the frame's time, camera and cloth input from the recording being replayed, or else from the clock and the keys, with
+//the camera moved on by the frame; false once a replay has run out of frames
+bool Renderer::getFrameInput(InputFrame &input) {
     auto thisFrame = std::chrono::system_clock::now();
     float dt = (thisFrame - this->_lastFrame).count() / 1e6;
     printf("FPS: %f\n", 1 / dt);
     this->_lastFrame = thisFrame;
 
-    float cosPitch = cos(this->_camera.pitch), sinPitch = sin(this->_camera.pitch);
-    float cosYaw = cos(this->_camera.yaw), sinYaw = sin(this->_camera.yaw);
-    simd::float4x4 camMat = simd::float4x4{
-        simd::float4{cosPitch, 0, -sinPitch, 0},
-        simd::float4{sinPitch * sinYaw, cosYaw, cosPitch * sinYaw, 0},
-        simd::float4{sinPitch * cosYaw, -sinYaw, cosPitch * cosYaw, 0},
-        simd::float4{this->_camera.position[0], this->_camera.position[1], this->_camera.position[2], 1}
+    if (this->_pInputReader != nullptr) {
+        if (this->_pInputReader->readFrame(input)) {
+            input.dt = REPLAY_FRAME_TIME;
+            return true;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_replayStart).count();
+        uint32_t frameCount = this->_pInputReader->getFrameCount();
+        printf("replayed %u frames in %f s, %f ms per frame\n", frameCount, seconds, 1000 * seconds / frameCount);
+        NS::Application::sharedApplication()->terminate(nullptr);
+        return false;
+    }
+
+    simd::float4 worldMoveDirection4 = getCameraMatrix(this->_camera) * simd_make_float4(this->_moveDirection);
+    this->_camera.position += dt * simd_make_float3(worldMoveDirection4);
+    input = InputFrame{
+        .dt = dt,
+        .pitch = this->_camera.pitch,
+        .yaw = this->_camera.yaw,
+        .position = this->_camera.position,
+        .clothDirection = this->_clothDirection,
+        .wind = this->_wind,
+        .seed = (uint32_t)rand()
     };
+    if (this->_pInputWriter != nullptr) this->_pInputWriter->addFrame(input);
+    return true;
+}
+
+void Renderer::draw(MTK::View *pView) {
+    InputFrame input;
+    if (!this->getFrameInput(input)) return;
+    this->_camera = Camera{.pitch = input.pitch, .yaw = input.yaw, .position = input.position};
+
+    simd::float4x4 camMat = getCameraMatrix(this->_camera);
     simd::float4x4 viewMat = simd_inverse(camMat);
     simd::float4x4 pvMat = this->_projectionMatrix * viewMat;
     simd::float4x4 pvMatInv = simd_inverse(pvMat);
 
-    simd::float4 moveDirection4 = simd_make_float4(this->_moveDirection);
-    simd::float4 worldMoveDirection4 = camMat * moveDirection4;
-    this->_camera.position += dt * simd_make_float3(worldMoveDirection4);
-
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
 
     //Simulate scene and update geometry
     MTL::CommandBuffer *pCmd = this->_pCommandQueue->commandBuffer();
-    this->_pScene->update(pCmd, this->_pAccelerationStructure, dt, this->_clothDirection, this->_wind);
+    this->_pScene->update(pCmd, this->_pAccelerationStructure, input.dt, input.clothDirection, input.wind);
+    this->_pAccelerationStructure->encodeBounds(pCmd);
     pCmd->commit();
     pCmd->waitUntilCompleted();
     this->_pScene->updateGeometry();
@@ -172,24 +198,18 @@ void Renderer::draw(MTK::View *pView) {
     //update primitive motion data
     this->_pScene->updatePrimitiveMotion(this->_pComputeMotionPipelineState, pCmd, pvMat);
 
-    //rebuild acceleration structure
-    MTL::AccelerationStructureCommandEncoder *pASEnc = pCmd->accelerationStructureCommandEncoder();
-    pASEnc->buildAccelerationStructure(
-        this->_pAccelerationStructure,
-        this->_pScene->getDescriptor(),
-        this->_pScratchBuffer,
-        0
-    );
-    pASEnc->endEncoding();
+    //refit the moving objects' acceleration structures in place, or rebuild them, and the instances over them
+    if (this->_pAccelerationStructure->encodeUpdate(pCmd, this->_refitCount >= MAX_REFITS)) this->_refitCount = 0;
+    else this->_refitCount++;
 
     MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
-    uint32_t r = rand();
-    pCEnc->setBytes(&r, sizeof(uint32_t), 0);
-    pCEnc->setAccelerationStructure(this->_pAccelerationStructure, 1);
-    pCEnc->setBuffer(this->_pGeometryMaterialBuffer, 0, 2);
+    pCEnc->setBytes(&input.seed, sizeof(uint32_t), 0);
+    this->_pAccelerationStructure->bind(pCEnc, 1);
+    pCEnc->setBuffer(this->_pInstanceDataBuffer, 0, 2);
     pCEnc->setBuffer(this->_pMaterialBuffer, 0, 3);
     pCEnc->setBytes(&this->_camera.position, sizeof(simd::float3), 4);
     pCEnc->setBytes(&pvMatInv, sizeof(simd::float4x4), 5);
+    pCEnc->setBytes(&this->_prevPvMat, sizeof(simd::float4x4), 6);
     pCEnc->setTexture(this->_pDepthNormalTextures[0], 0);
     pCEnc->setTexture(this->_pMotionTexture, 1);
     pCEnc->setTexture(this->_pOutputTexture, 2);
@@ -222,6 +242,7 @@ void Renderer::draw(MTK::View *pView) {
     pCmd->commit();
 
     std::swap(this->_pDepthNormalTextures[0], this->_pDepthNormalTextures[1]);
+    this->_prevPvMat = pvMat;
 
     pPool->release();
 }
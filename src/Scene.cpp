@@ -4,35 +4,83 @@ Scene::~Scene() {
     for (SceneObject *pSceneObject: this->_sceneObjects) {
         delete pSceneObject;
     }
-    this->_pDescriptor->release();
+    delete this->_pWindField;
 }
 
-void Scene::addObject(SceneObject *pSceneObject) {
+uint32_t Scene::addObject(SceneObject *pSceneObject) {
     this->_sceneObjects.push_back(pSceneObject);
-    this->updateGeometry();
+    pSceneObject->updateGeometry();
+    return this->_sceneObjects.size() - 1;
+}
+
+void Scene::addInstance(uint32_t object, uint16_t material, simd::float4x4 transform) {
+    this->_instances.push_back(SceneInstance{.object = object, .material = material, .transform = transform});
+}
+
+std::vector<InstanceData> Scene::getInstanceData() {
+    std::vector<InstanceData> instanceData;
+    for (const SceneInstance &instance: this->_instances) {
+        instanceData.push_back(InstanceData{.material = instance.material, .dynamic = this->_sceneObjects[instance.object]->isDynamic()});
+    }
+    return instanceData;
 }
 
 void Scene::loadHdri(MTL::Device *pDevice, const char *fileName) {
     this->_pHdri = new Hdri(pDevice, fileName);
 }
 
+void Scene::setWindField(WindField *pWindField) {
+    delete this->_pWindField;
+    this->_pWindField = pWindField;
+}
+
 Hdri* Scene::getHdri() {
     return this->_pHdri;
 }
 
-void Scene::update(MTL::CommandBuffer *pCmd, MTL::AccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+TraceScene Scene::getTraceScene() {
+    TraceScene traceScene;
+    for (const SceneInstance &instance: this->_instances) {
+        MTL::AccelerationStructureTriangleGeometryDescriptor *pDescriptor = this->_sceneObjects[instance.object]->getDescriptor();
+        uint8_t *pVertices = (uint8_t*)pDescriptor->vertexBuffer()->contents();
+        uint8_t *pIndices = (uint8_t*)pDescriptor->indexBuffer()->contents();
+        uint8_t *pPrimitiveData = (uint8_t*)pDescriptor->primitiveDataBuffer()->contents();
+        bool readable = pVertices != nullptr && pIndices != nullptr && pPrimitiveData != nullptr;
+        traceScene.geometries.push_back(TraceGeometry{
+            .vertices = (const pfloat3*)(pVertices + pDescriptor->vertexBufferOffset()),
+            .indices = (const uint32_t*)(pIndices + pDescriptor->indexBufferOffset()),
+            .primitiveData = (PrimitiveData*)(pPrimitiveData + pDescriptor->primitiveDataBufferOffset()),
+            .triangleCount = readable ? (uint32_t)pDescriptor->triangleCount() : 0,
+            .transform = instance.transform,
+            .dynamic = this->_sceneObjects[instance.object]->isDynamic()
+        });
+        traceScene.geometryMaterials.push_back(instance.material);
+    }
+    traceScene.materials = this->getMaterials();
+    return traceScene;
+}
+
+void Scene::synchronizeGeometry(MTL::CommandBuffer *pCmd) {
+    MTL::BlitCommandEncoder *pBCEnc = pCmd->blitCommandEncoder();
+    for (SceneObject *pSceneObject: this->_sceneObjects) {
+        MTL::AccelerationStructureTriangleGeometryDescriptor *pDescriptor = pSceneObject->getDescriptor();
+        if (pDescriptor->vertexBuffer()->storageMode() == MTL::StorageModeManaged) pBCEnc->synchronizeResource(pDescriptor->vertexBuffer());
+        if (pDescriptor->primitiveDataBuffer()->storageMode() == MTL::StorageModeManaged) pBCEnc->synchronizeResource(pDescriptor->primitiveDataBuffer());
+    }
+    pBCEnc->endEncoding();
+}
+
+void Scene::update(MTL::CommandBuffer *pCmd, SceneAccelerationStructure *pAccelerationStructure, float dt, simd::float3 moveDirection, bool enable) {
+    if (this->_pWindField) this->_pWindField->advance(dt);
     for (SceneObject *pSceneObject: this->_sceneObjects) {
         pSceneObject->update(pCmd, pAccelerationStructure, dt, moveDirection, enable);
     }
 }
 
 void Scene::updateGeometry() {
-    const NS::Object *pGeometryDescriptors[this->_sceneObjects.size()];
-    for (int i = 0; i < this->_sceneObjects.size(); i++) {
-        pGeometryDescriptors[i] = _sceneObjects.at(i)->getDescriptor();
+    for (SceneObject *pSceneObject: this->_sceneObjects) {
+        pSceneObject->updateGeometry();
     }
-
-    this->_pDescriptor->setGeometryDescriptors(NS::Array::alloc()->init(pGeometryDescriptors, this->_sceneObjects.size()));
 }
 
 void Scene::updatePrimitiveMotion(MTL::ComputePipelineState *pComputeMotionPipelineState, MTL::CommandBuffer *pCmd, simd::float4x4 vpMat) {
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstring>
+#include "SceneAccelerationStructure.hpp"
+
+//inverse of the kernel's getOrderedBits
+static float fromOrderedBits(uint32_t bits) {
+    bits = bits & 0x80000000 ? bits & 0x7FFFFFFF : ~bits;
+    float value;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+SceneAccelerationStructure::SceneAccelerationStructure(MTL::Device *pDevice, MTL::CommandBuffer *pCmd, const std::vector<SceneObject*> &sceneObjects, const std::vector<SceneInstance> &instances) {
+    this->_pDevice = pDevice;
+    this->_sceneObjects = sceneObjects;
+    this->_builtAreas = std::vector<float>(sceneObjects.size(), 0);
+
+    NS::Error *err = nullptr;
+    MTL::Library *pLibrary = pDevice->newDefaultLibrary();
+    MTL::Function *pBoundsFunction = pLibrary->newFunction(NS::String::string("reduceVertexBoundsKernel", NS::UTF8StringEncoding));
+    this->_pBoundsPipelineState = pDevice->newComputePipelineState(pBoundsFunction, &err);
+    pBoundsFunction->release();
+    pLibrary->release();
+    this->_pBoundsBuffer = pDevice->newBuffer(6 * sizeof(uint32_t) * sceneObjects.size(), MTL::ResourceStorageModeShared);
+
+    MTL::AccelerationStructureCommandEncoder *pASEnc = pCmd->accelerationStructureCommandEncoder();
+    for (uint32_t i = 0; i < sceneObjects.size(); i++) {
+        const NS::Object *pGeometryDescriptor = sceneObjects[i]->getDescriptor();
+        NS::Array *pGeometryDescriptors = NS::Array::alloc()->init(&pGeometryDescriptor, 1);
+        MTL::PrimitiveAccelerationStructureDescriptor *pDescriptor = MTL::PrimitiveAccelerationStructureDescriptor::alloc()->init();
+        pDescriptor->setGeometryDescriptors(pGeometryDescriptors);
+        if (sceneObjects[i]->isDynamic()) pDescriptor->setUsage(MTL::AccelerationStructureUsageRefit);
+        pGeometryDescriptors->release();
+
+        this->_pPrimitiveDescriptors.push_back(pDescriptor);
+        this->_pPrimitiveAccelerationStructures.push_back(nullptr);
+        this->_pScratchBuffers.push_back(nullptr);
+        this->_triangleCounts.push_back(0);
+        this->allocatePrimitiveAccelerationStructure(i);
+        if (sceneObjects[i]->isDynamic()) continue;
+
+        //the command buffer keeps the scratch space alive until the build is done with it
+        pASEnc->buildAccelerationStructure(this->_pPrimitiveAccelerationStructures[i], pDescriptor, this->_pScratchBuffers[i], 0);
+        this->_pScratchBuffers[i]->release();
+        this->_pScratchBuffers[i] = nullptr;
+    }
+    pASEnc->endEncoding();
+
+    //the instance id is the instance's index, and the transform's last row, always 0 0 0 1, is left out
+    this->_instanceIds = std::vector<uint32_t>(sceneObjects.size(), UINT32_MAX);
+    this->_pInstanceBuffer = this->_pDevice->newBuffer(instances.size() * sizeof(MTL::AccelerationStructureInstanceDescriptor), MTL::ResourceStorageModeManaged);
+    MTL::AccelerationStructureInstanceDescriptor *pInstances = (MTL::AccelerationStructureInstanceDescriptor*)this->_pInstanceBuffer->contents();
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        for (int column = 0; column < 4; column++) {
+            simd::float4 transformColumn = instances[i].transform.columns[column];
+            pInstances[i].transformationMatrix[column] = MTL::PackedFloat3(transformColumn.x, transformColumn.y, transformColumn.z);
+        }
+        pInstances[i].options = MTL::AccelerationStructureInstanceOptionNone;
+        pInstances[i].mask = 0xFF;
+        pInstances[i].intersectionFunctionTableOffset = 0;
+        pInstances[i].accelerationStructureIndex = instances[i].object;
+        if (this->_instanceIds[instances[i].object] == UINT32_MAX) this->_instanceIds[instances[i].object] = i;
+    }
+    this->_pInstanceBuffer->didModifyRange(NS::Range::Make(0, this->_pInstanceBuffer->length()));
+
+    this->_pInstanceDescriptor = MTL::InstanceAccelerationStructureDescriptor::alloc()->init();
+    this->_pInstanceDescriptor->setInstanceDescriptorBuffer(this->_pInstanceBuffer);
+    this->_pInstanceDescriptor->setInstanceCount(instances.size());
+    this->setInstancedAccelerationStructures();
+    MTL::AccelerationStructureSizes sizes = this->_pDevice->accelerationStructureSizes(this->_pInstanceDescriptor);
+    this->_pInstanceAccelerationStructure = this->_pDevice->newAccelerationStructure(sizes.accelerationStructureSize);
+    this->_pInstanceScratchBuffer = this->_pDevice->newBuffer(sizes.buildScratchBufferSize, MTL::ResourceStorageModePrivate);
+}
+
+SceneAccelerationStructure::~SceneAccelerationStructure() {
+    for (uint32_t i = 0; i < this->_sceneObjects.size(); i++) {
+        this->_pPrimitiveDescriptors[i]->release();
+        this->_pPrimitiveAccelerationStructures[i]->release();
+        if (this->_pScratchBuffers[i] != nullptr) this->_pScratchBuffers[i]->release();
+    }
+    this->_pInstanceDescriptor->release();
+    this->_pInstanceBuffer->release();
+    this->_pInstanceAccelerationStructure->release();
+    this->_pInstanceScratchBuffer->release();
+    this->_pBoundsPipelineState->release();
+    this->_pBoundsBuffer->release();
+}
+
+//sizes the object's structure and its scratch space, for refits too, for its triangles as they are now
+void SceneAccelerationStructure::allocatePrimitiveAccelerationStructure(uint32_t object) {
+    if (this->_pPrimitiveAccelerationStructures[object] != nullptr) this->_pPrimitiveAccelerationStructures[object]->release();
+    if (this->_pScratchBuffers[object] != nullptr) this->_pScratchBuffers[object]->release();
+    MTL::AccelerationStructureSizes sizes = this->_pDevice->accelerationStructureSizes(this->_pPrimitiveDescriptors[object]);
+    this->_pPrimitiveAccelerationStructures[object] = this->_pDevice->newAccelerationStructure(sizes.accelerationStructureSize);
+    this->_pScratchBuffers[object] = this->_pDevice->newBuffer(std::max(sizes.buildScratchBufferSize, sizes.refitScratchBufferSize), MTL::ResourceStorageModePrivate);
+    this->_triangleCounts[object] = this->_sceneObjects[object]->getDescriptor()->triangleCount();
+}
+
+float SceneAccelerationStructure::getBoundsArea(uint32_t object) {
+    const uint32_t *bounds = (const uint32_t*)this->_pBoundsBuffer->contents() + 6 * object;
+    float extent[3];
+    for (int axis = 0; axis < 3; axis++) extent[axis] = std::max(fromOrderedBits(bounds[3 + axis]) - fromOrderedBits(bounds[axis]), 0.0f);
+    return 2 * (extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0]);
+}
+
+void SceneAccelerationStructure::encodeBounds(MTL::CommandBuffer *pCmd) {
+    MTL::ComputeCommandEncoder *pCEnc = pCmd->computeCommandEncoder();
+    pCEnc->setComputePipelineState(this->_pBoundsPipelineState);
+    unsigned int boundsGroupWidth = this->_pBoundsPipelineState->threadExecutionWidth();
+    uint32_t *bounds = (uint32_t*)this->_pBoundsBuffer->contents();
+    for (uint32_t i = 0; i < this->_sceneObjects.size(); i++) {
+        if (!this->_sceneObjects[i]->isDynamic()) continue;
+        //empty bounds, which every vertex grows
+        for (int axis = 0; axis < 3; axis++) {
+            bounds[6 * i + axis] = UINT32_MAX;
+            bounds[6 * i + 3 + axis] = 0;
+        }
+        MTL::AccelerationStructureTriangleGeometryDescriptor *pDescriptor = this->_sceneObjects[i]->getDescriptor();
+        uint32_t vertexCount = (pDescriptor->vertexBuffer()->length() - pDescriptor->vertexBufferOffset()) / sizeof(MTL::PackedFloat3);
+        pCEnc->setBuffer(pDescriptor->vertexBuffer(), pDescriptor->vertexBufferOffset(), 0);
+        pCEnc->setBytes(&vertexCount, sizeof(uint32_t), 1);
+        pCEnc->setBuffer(this->_pBoundsBuffer, 6 * sizeof(uint32_t) * i, 2);
+        pCEnc->dispatchThreadgroups(
+            MTL::Size::Make((vertexCount + boundsGroupWidth - 1) / boundsGroupWidth, 1, 1),
+            MTL::Size::Make(boundsGroupWidth, 1, 1)
+        );
+    }
+    pCEnc->endEncoding();
+}
+
+void SceneAccelerationStructure::setInstancedAccelerationStructures() {
+    NS::Array *pAccelerationStructures = NS::Array::alloc()->init((const NS::Object* const*)this->_pPrimitiveAccelerationStructures.data(), this->_pPrimitiveAccelerationStructures.size());
+    this->_pInstanceDescriptor->setInstancedAccelerationStructures(pAccelerationStructures);
+    pAccelerationStructures->release();
+}
+
+bool SceneAccelerationStructure::encodeUpdate(MTL::CommandBuffer *pCmd, bool rebuild) {
+    bool dynamic = std::any_of(this->_sceneObjects.begin(), this->_sceneObjects.end(), [](SceneObject *pSceneObject) {
+        return pSceneObject->isDynamic();
+    });
+    if (this->_built && !dynamic) return false;
+
+    bool rebuilt = false;
+    MTL::AccelerationStructureCommandEncoder *pASEnc = pCmd->accelerationStructureCommandEncoder();
+    for (uint32_t i = 0; i < this->_sceneObjects.size(); i++) {
+        if (!this->_sceneObjects[i]->isDynamic()) continue;
+        //a refit keeps the triangles the structure was built with, and more of them need a bigger one
+        bool resized = this->_sceneObjects[i]->getDescriptor()->triangleCount() != this->_triangleCounts[i];
+        if (resized) {
+            this->allocatePrimitiveAccelerationStructure(i);
+            this->setInstancedAccelerationStructures();
+        }
+        float area = this->getBoundsArea(i);
+        if (!this->_built || rebuild || resized || area > REBUILD_AREA_RATIO * this->_builtAreas[i]) {
+            pASEnc->buildAccelerationStructure(this->_pPrimitiveAccelerationStructures[i], this->_pPrimitiveDescriptors[i], this->_pScratchBuffers[i], 0);
+            this->_builtAreas[i] = area;
+            rebuilt = true;
+        }
+        else {
+            pASEnc->refitAccelerationStructure(
+                this->_pPrimitiveAccelerationStructures[i],
+                this->_pPrimitiveDescriptors[i],
+                nullptr,
+                this->_pScratchBuffers[i],
+                0
+            );
+        }
+    }
+    pASEnc->endEncoding();
+
+    //in an encoder of its own, so it reads the primitive structures once their builds and refits are done
+    pASEnc = pCmd->accelerationStructureCommandEncoder();
+    pASEnc->buildAccelerationStructure(this->_pInstanceAccelerationStructure, this->_pInstanceDescriptor, this->_pInstanceScratchBuffer, 0);
+    pASEnc->endEncoding();
+    this->_built = true;
+    return rebuilt;
+}
+
+void SceneAccelerationStructure::bind(MTL::ComputeCommandEncoder *pCEnc, NS::UInteger index) {
+    pCEnc->setAccelerationStructure(this->_pInstanceAccelerationStructure, index);
+    for (MTL::AccelerationStructure *pAccelerationStructure: this->_pPrimitiveAccelerationStructures) {
+        pCEnc->useResource(pAccelerationStructure, MTL::ResourceUsageRead);
+    }
+}
+
+uint32_t SceneAccelerationStructure::getInstanceId(SceneObject *pSceneObject) {
+    auto found = std::find(this->_sceneObjects.begin(), this->_sceneObjects.end(), pSceneObject);
+    return found == this->_sceneObjects.end() ? UINT32_MAX : this->_instanceIds[found - this->_sceneObjects.begin()];
+}
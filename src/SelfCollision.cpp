@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "simulation/SelfCollision.hpp"
+
+//buckets are prefix-summed in fixed blocks, so the scan splits the same way for any thread count
+constexpr uint32_t SCAN_BLOCK = 4096;
+
+static uint32_t hashCell(int x, int y, int z, uint32_t tableSize) {
+    return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u) & (tableSize - 1);
+}
+
+SelfCollision::SelfCollision(const ClothParameters &params, const ClothTopology &topology) {
+    const uint32_t triangleCount = topology.triangleCount;
+    this->_parameters = params;
+    this->_pTopology = &topology;
+    this->_triangleCount = triangleCount;
+    this->setThickness(params.sideSpringLength / 2);
+    this->_counts = std::vector<std::atomic<uint32_t>>(this->_hash.tableSize);
+    this->_bucketStarts.resize(this->_hash.tableSize + 1);
+    this->_blockSums.resize((this->_hash.tableSize + SCAN_BLOCK - 1) / SCAN_BLOCK);
+    this->_entries.resize(4 * triangleCount);
+    this->_lowerBounds.resize(triangleCount);
+    this->_upperBounds.resize(triangleCount);
+    this->_normals.resize(triangleCount);
+    this->_areas.resize(triangleCount);
+    this->_positionCorrections.resize(topology.particleCount);
+    this->_velocityCorrections.resize(topology.particleCount);
+}
+
+void SelfCollision::setThickness(float thickness) {
+    this->_hash = makeSelfCollisionParameters(this->_parameters, this->_triangleCount, thickness);
+}
+
+void SelfCollision::apply(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt) {
+    this->build(pThreadPool, state);
+    this->respond(pThreadPool, state, attachments, dt);
+}
+
+void SelfCollision::build(ThreadPool *pThreadPool, const ClothState &state) {
+    const uint32_t *indices = this->_pTopology->indices.data();
+    const float cellSize = this->_hash.cellSize, thickness = this->_hash.thickness;
+    const uint32_t tableSize = this->_hash.tableSize;
+    auto forEachCell = [&](uint32_t t, auto &&visit) {
+        simd::float3 lower = this->_lowerBounds[t], upper = this->_upperBounds[t];
+        int lowerX = floorf(lower.x / cellSize), lowerY = floorf(lower.y / cellSize), lowerZ = floorf(lower.z / cellSize);
+        int upperX = floorf(upper.x / cellSize), upperY = floorf(upper.y / cellSize), upperZ = floorf(upper.z / cellSize);
+        for (int z = lowerZ; z <= upperZ; z++) {
+            for (int y = lowerY; y <= upperY; y++) {
+                for (int x = lowerX; x <= upperX; x++) {
+                    visit(hashCell(x, y, z, tableSize));
+                }
+            }
+        }
+    };
+
+    //count: a triangle takes a slot in every cell its thickened bounding box overlaps; the box and plane are kept
+    //so the response can reject most candidates before touching the vertices
+    pThreadPool->parallelFor(this->_triangleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            simd::float3 a = state.getPosition(indices[3 * t]), b = state.getPosition(indices[3 * t + 1]), c = state.getPosition(indices[3 * t + 2]);
+            this->_lowerBounds[t] = simd::min(a, simd::min(b, c)) - thickness;
+            this->_upperBounds[t] = simd::max(a, simd::max(b, c)) + thickness;
+            simd::float3 normal = simd::cross(b - a, c - a);
+            this->_areas[t] = simd::length(normal);
+            this->_normals[t] = normal / this->_areas[t];
+            forEachCell(t, [&](uint32_t bucket) {
+                this->_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    });
+
+    //scan: block totals, an exclusive scan over the blocks, then each block's buckets
+    const uint32_t blocks = this->_blockSums.size();
+    pThreadPool->parallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            uint32_t sum = 0;
+            for (uint32_t bucket = block * SCAN_BLOCK; bucket < std::min(tableSize, (block + 1) * SCAN_BLOCK); bucket++) {
+                sum += this->_counts[bucket].load(std::memory_order_relaxed);
+            }
+            this->_blockSums[block] = sum;
+        }
+    });
+    uint32_t total = 0;
+    for (uint32_t block = 0; block < blocks; block++) {
+        uint32_t sum = this->_blockSums[block];
+        this->_blockSums[block] = total;
+        total += sum;
+    }
+    pThreadPool->parallelFor(blocks, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; block++) {
+            uint32_t start = this->_blockSums[block];
+            for (uint32_t bucket = block * SCAN_BLOCK; bucket < std::min(tableSize, (block + 1) * SCAN_BLOCK); bucket++) {
+                this->_bucketStarts[bucket] = start;
+                start += this->_counts[bucket].load(std::memory_order_relaxed);
+                this->_counts[bucket].store(this->_bucketStarts[bucket], std::memory_order_relaxed);
+            }
+        }
+    });
+    this->_bucketStarts[tableSize] = total;
+    if (this->_entries.size() < total) this->_entries.resize(total);
+
+    //scatter: counts now hold each bucket's write cursor; the order inside a bucket depends on timing, so the
+    //response never relies on it
+    pThreadPool->parallelFor(this->_triangleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            forEachCell(t, [&](uint32_t bucket) {
+                this->_entries[this->_counts[bucket].fetch_add(1, std::memory_order_relaxed)] = t;
+            });
+        }
+    });
+    pThreadPool->parallelFor(tableSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t bucket = begin; bucket < end; bucket++) {
+            this->_counts[bucket].store(0, std::memory_order_relaxed);
+        }
+    });
+}
+
+//corrections are gathered from the state the hash was built on and applied afterwards, like the force pass
+void SelfCollision::respond(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt) {
+    const ClothTopology &topology = *this->_pTopology;
+    const uint32_t n = topology.gridSize;
+    const uint32_t *indices = topology.indices.data();
+    const float cellSize = this->_hash.cellSize, thickness = this->_hash.thickness;
+    const uint32_t tableSize = this->_hash.tableSize;
+    //tearing can add particles since the last substep
+    this->_positionCorrections.resize(topology.particleCount);
+    this->_velocityCorrections.resize(topology.particleCount);
+
+    //the 1-ring is the 3x3 block around a grid particle, and the particle's spring neighbours on a mesh; particles torn
+    //from the same one start on top of each other and are left to their springs to part
+    auto isNearby = [&](uint32_t i, uint32_t v) {
+        if (n > 0) return abs((int)(v % n) - (int)(i % n)) <= 1 && abs((int)(v / n) - (int)(i / n)) <= 1;
+        const uint32_t *neighbours = topology.springNeighbours.data();
+        if (topology.origins.empty()) return v == i || std::binary_search(neighbours + topology.getSpringStart(i), neighbours + topology.getSpringEnd(i), v);
+        const uint32_t *origins = topology.origins.data();
+        if (origins[v] == origins[i]) return true;
+        for (uint32_t s = topology.getSpringStart(i); s < topology.getSpringEnd(i); s++) if (origins[neighbours[s]] == origins[v]) return true;
+        return false;
+    };
+
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            this->_positionCorrections[i] = simd::float3{};
+            this->_velocityCorrections[i] = simd::float3{};
+            if (attachments.isHard(i)) continue;
+            simd::float3 position = state.getPosition(i), velocity = state.getVelocity(i);
+            simd::float3 previousPosition = position - dt * velocity;
+
+            //the deepest contact wins, ties going to the lower triangle, so bucket order cannot change the result
+            float deepest = 0;
+            uint32_t deepestTriangle = UINT32_MAX;
+            uint32_t bucket = hashCell(floorf(position.x / cellSize), floorf(position.y / cellSize), floorf(position.z / cellSize), tableSize);
+            for (uint32_t entry = this->_bucketStarts[bucket]; entry < this->_bucketStarts[bucket + 1]; entry++) {
+                uint32_t t = this->_entries[entry];
+                simd::float3 lower = this->_lowerBounds[t], upper = this->_upperBounds[t];
+                if (position.x < lower.x || position.y < lower.y || position.z < lower.z) continue;
+                if (position.x > upper.x || position.y > upper.y || position.z > upper.z) continue;
+                float area = this->_areas[t];
+                if (!(area > 0)) continue;
+
+                const uint32_t *triangle = &indices[3 * t];
+                bool nearby = false;
+                for (int v = 0; v < 3; v++) {
+                    nearby |= isNearby(i, triangle[v]);
+                }
+                if (nearby) continue;
+
+                simd::float3 a = state.getPosition(triangle[0]), b = state.getPosition(triangle[1]), c = state.getPosition(triangle[2]);
+                simd::float3 normal = this->_normals[t];
+
+                //keep the particle on the side of the plane it started the substep on
+                float side = simd::dot(previousPosition - a, normal) >= 0 ? 1 : -1;
+                float height = side * simd::dot(position - a, normal);
+                float depth = thickness - height;
+                if (depth <= 0 || height < -thickness) continue;
+
+                //barycentric coordinates of the particle projected onto the triangle
+                simd::float3 projected = position - simd::dot(position - a, normal) * normal;
+                float weightA = simd::dot(simd::cross(b - projected, c - projected), normal) / area;
+                float weightB = simd::dot(simd::cross(c - projected, a - projected), normal) / area;
+                float weightC = 1 - weightA - weightB;
+                if (weightA < 0 || weightB < 0 || weightC < 0) continue;
+                if (depth < deepest || (depth == deepest && t > deepestTriangle)) continue;
+
+                deepest = depth;
+                deepestTriangle = t;
+                simd::float3 direction = side * normal;
+                simd::float3 surfaceVelocity = weightA * state.getVelocity(triangle[0]) + weightB * state.getVelocity(triangle[1]) + weightC * state.getVelocity(triangle[2]);
+                float approach = simd::dot(velocity - surfaceVelocity, direction);
+                this->_positionCorrections[i] = depth * direction;
+                this->_velocityCorrections[i] = approach < 0 ? -approach * direction : simd::float3{};
+            }
+        }
+    });
+
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            state.setPosition(i, state.getPosition(i) + this->_positionCorrections[i]);
+            state.setVelocity(i, state.getVelocity(i) + this->_velocityCorrections[i]);
+        }
+    });
+}
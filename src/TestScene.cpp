@@ -1,9 +1,5 @@
 #include "scenes/TestScene.hpp"
 
-const uint16_t geoMats[3] = {
-    0, 1, 2
-};
-
 const Material mats[3] = {
     Material{.color = {0.5f, 1.0f, 0.5f}, .roughness = .25},
     Material{.color = {0.5f, 0.5f, 1.0f}, .roughness = 0},
@@ -11,10 +7,15 @@ const Material mats[3] = {
 };
 
 TestScene::TestScene(MTL::Device *pDevice) {
-    this->_pDescriptor = MTL::PrimitiveAccelerationStructureDescriptor::alloc()->init();
-    this->addObject(new Cloth(pDevice, 2, 20, 1, 20, 1));
-    //this->addObject(new Cube(pDevice, 1));
-    this->addObject(new FloorPlane(pDevice, 5));
+    //gusts of a metre a second around the breeze, sampled from a 16^3 volume tiling every 4 metres
+    WindField *pWindField = new WindField(16, 4, simd::float3{0, 0, 2}, 1, 2);
+    this->setWindField(pWindField);
+    Cloth *pCloth = new Cloth(pDevice, 2, 20, 1, 20, 1);
+    pCloth->setWindField(pWindField);
+    this->addInstance(this->addObject(pCloth), 0);
+    //uint32_t cube = this->addObject(new Cube(pDevice, 1));
+    //this->addInstance(cube, 2, simd_matrix(simd_make_float4(1, 0, 0, 0), simd_make_float4(0, 1, 0, 0), simd_make_float4(0, 0, 1, 0), simd_make_float4(1.5f, 0.5f, 0, 1)));
+    this->addInstance(this->addObject(new FloorPlane(pDevice, 5)), 1);
     this->loadHdri(pDevice, "clarens_night_02_4k.hdr");
 }
 
@@ -22,10 +23,6 @@ Camera TestScene::getInitialCamera() {
     return Camera{0, M_PI / 4, simd::float3{0, 5, -5}};
 }
 
-std::vector<uint16_t> TestScene::getGeometryMaterials() {
-    return std::vector<uint16_t>(std::begin(geoMats), std::end(geoMats));
-}
-
 std::vector<Material> TestScene::getMaterials() {
     return std::vector<Material>(std::begin(mats), std::end(mats));
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+
+    //the calling thread always takes chunk 0
+    for (unsigned int i = 1; i < threadCount; i++) {
+        this->_workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_stopping = true;
+    }
+    this->_startCondition.notify_all();
+    for (std::thread &worker: this->_workers) {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::getThreadCount() {
+    return this->_workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)> &task) {
+    if (count == 0) return;
+    if (this->_workers.empty() || count == 1) {
+        task(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_pTask = &task;
+        this->_count = count;
+        this->_pending = this->_workers.size();
+        this->_generation++;
+    }
+    this->_startCondition.notify_all();
+
+    this->runChunk(0);
+
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_doneCondition.wait(lock, [this]{return this->_pending == 0;});
+    this->_pTask = nullptr;
+}
+
+void ThreadPool::runChunk(unsigned int chunk) {
+    uint64_t threadCount = this->getThreadCount();
+    uint32_t begin = (uint64_t)this->_count * chunk / threadCount;
+    uint32_t end = (uint64_t)this->_count * (chunk + 1) / threadCount;
+    if (begin < end) (*this->_pTask)(begin, end);
+}
+
+void ThreadPool::work(unsigned int chunk) {
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->_mutex);
+            this->_startCondition.wait(lock, [&]{return this->_stopping || this->_generation != generation;});
+            if (this->_stopping) return;
+            generation = this->_generation;
+        }
+
+        this->runChunk(chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_pending--;
+        }
+        this->_doneCondition.notify_one();
+    }
+}
@@ -0,0 +1,21 @@
+#include "pathtracing/TraceScene.hpp"
+
+static simd::float2 worldToUv(simd::float4x4 vpMat, simd::float3 v) {
+    simd::float4 clipCoord = vpMat * simd::float4{v.x, v.y, v.z, 1};
+    return simd::float2{(clipCoord.x / -clipCoord.w + 1) / 2, (clipCoord.y / -clipCoord.w + 1) / 2};
+}
+
+void TraceScene::updatePrimitiveMotion(simd::float4x4 vpMat) {
+    for (TraceGeometry &geometry: this->geometries) {
+        if (!geometry.dynamic) continue;
+        for (uint32_t i = 0; i < geometry.triangleCount; i++) {
+            PrimitiveData &data = geometry.primitiveData[i];
+            data.v0PrevUV = data.v0CurrUV;
+            data.v1PrevUV = data.v1CurrUV;
+            data.v2PrevUV = data.v2CurrUV;
+            data.v0CurrUV = worldToUv(vpMat, geometry.getVertex(geometry.indices[3 * i]));
+            data.v1CurrUV = worldToUv(vpMat, geometry.getVertex(geometry.indices[3 * i + 1]));
+            data.v2CurrUV = worldToUv(vpMat, geometry.getVertex(geometry.indices[3 * i + 2]));
+        }
+    }
+}
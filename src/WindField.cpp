@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+#include "simulation/WindField.hpp"
+
+//noise lattice cells across one tile for the coarsest octave, and the octaves summed on top of it; octaves with fewer
+//than four samples a cell are left out, as the curl could not resolve them
+constexpr uint32_t WIND_BASE_CELLS = 4;
+constexpr uint32_t WIND_OCTAVES = 3;
+
+static const simd::float3 gradients[12] = {
+    {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+    {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+    {0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
+};
+
+static inline uint32_t hashLattice(uint32_t x, uint32_t y, uint32_t z, uint32_t seed) {
+    uint32_t hash = seed * 0x9e3779b9u ^ x * 0x85ebca6bu ^ y * 0xc2b2ae35u ^ z * 0x27d4eb2fu;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline float fade(float t) {
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+//gradient noise over a lattice that repeats every period cells, so the volume wraps without a seam
+static float getGradientNoise(simd::float3 position, uint32_t period, uint32_t seed) {
+    simd::float3 cell = simd::floor(position);
+    simd::float3 offset = position - cell;
+    uint32_t x0 = (uint32_t)cell.x % period, y0 = (uint32_t)cell.y % period, z0 = (uint32_t)cell.z % period;
+    uint32_t x1 = (x0 + 1) % period, y1 = (y0 + 1) % period, z1 = (z0 + 1) % period;
+    auto corner = [&](uint32_t x, uint32_t y, uint32_t z, simd::float3 d) {
+        return simd::dot(gradients[hashLattice(x, y, z, seed) % 12], d);
+    };
+    float u = fade(offset.x), v = fade(offset.y), w = fade(offset.z);
+    float x00 = corner(x0, y0, z0, offset) + u * (corner(x1, y0, z0, offset - simd::float3{1, 0, 0}) - corner(x0, y0, z0, offset));
+    float x10 = corner(x0, y1, z0, offset - simd::float3{0, 1, 0}) + u * (corner(x1, y1, z0, offset - simd::float3{1, 1, 0}) - corner(x0, y1, z0, offset - simd::float3{0, 1, 0}));
+    float x01 = corner(x0, y0, z1, offset - simd::float3{0, 0, 1}) + u * (corner(x1, y0, z1, offset - simd::float3{1, 0, 1}) - corner(x0, y0, z1, offset - simd::float3{0, 0, 1}));
+    float x11 = corner(x0, y1, z1, offset - simd::float3{0, 1, 1}) + u * (corner(x1, y1, z1, offset - simd::float3{1, 1, 1}) - corner(x0, y1, z1, offset - simd::float3{0, 1, 1}));
+    float y0Value = x00 + v * (x10 - x00);
+    float y1Value = x01 + v * (x11 - x01);
+    return y0Value + w * (y1Value - y0Value);
+}
+
+WindField::WindField(uint32_t resolution, float tileSize, simd::float3 meanWind, float turbulence, float period) {
+    this->_resolution = std::max(resolution, 1u);
+    this->_tileSize = tileSize;
+    this->_meanWind = meanWind;
+    this->_turbulence = turbulence;
+    this->_period = period;
+    uint32_t sampleCount = this->_resolution * this->_resolution * this->_resolution;
+    for (std::vector<simd::float4> &volume: this->_volumes) volume.resize(sampleCount);
+    this->_potential.resize(sampleCount);
+
+    //the first two keyframes are needed right away; every later one is built while the previous pair is blended
+    this->buildKeyframe(0, 0);
+    this->buildKeyframe(1, 1);
+    this->_builder = std::thread(&WindField::build, this);
+}
+
+WindField::~WindField() {
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_stopping = true;
+    }
+    this->_condition.notify_one();
+    this->_builder.join();
+}
+
+void WindField::advance(float dt) {
+    this->_time += this->_period > 0 ? dt / this->_period : 1;
+    if (this->_time < 1) return;
+
+    //the build is almost always done long before the period is; waiting for it rather than holding the blend keeps the
+    //wind from depending on how the builder was scheduled
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_condition.wait(lock, [&]() {return !this->_building;});
+    this->_current = (this->_current + 1) % 3;
+    this->_time = std::min(this->_time - 1, 1.0f);
+    this->_generation++;
+    this->_nextKeyframe++;
+    this->_building = true;
+    this->_condition.notify_one();
+}
+
+simd::float3 WindField::sample(simd::float3 position) const {
+    const uint32_t r = this->_resolution;
+    const simd::float4 *from = this->getVolume(0), *to = this->getVolume(1);
+    const float blend = this->getParameters().blend;
+
+    //sample centers sit half a cell in, like texels of the textures the GPU samples
+    simd::float3 coordinate = position / this->_tileSize * r - 0.5f;
+    simd::float3 cell = simd::floor(coordinate);
+    simd::float3 offset = coordinate - cell;
+    auto wrap = [r](float c) {
+        int64_t i = (int64_t)c % (int64_t)r;
+        return (uint32_t)(i < 0 ? i + r : i);
+    };
+    uint32_t x[2] = {wrap(cell.x), wrap(cell.x + 1)};
+    uint32_t y[2] = {wrap(cell.y), wrap(cell.y + 1)};
+    uint32_t z[2] = {wrap(cell.z), wrap(cell.z + 1)};
+
+    simd::float3 wind = simd::float3{};
+    for (int k = 0; k < 2; k++) {
+        for (int j = 0; j < 2; j++) {
+            for (int i = 0; i < 2; i++) {
+                float weight = (i ? offset.x : 1 - offset.x) * (j ? offset.y : 1 - offset.y) * (k ? offset.z : 1 - offset.z);
+                uint32_t index = (z[k] * r + y[j]) * r + x[i];
+                simd::float3 fromWind = simd_make_float3(from[index]), toWind = simd_make_float3(to[index]);
+                wind += weight * (fromWind + blend * (toWind - fromWind));
+            }
+        }
+    }
+    return wind;
+}
+
+//trilinear samples and blends are weighted averages, so no wind in the field strays further from the mean than the
+//samples of the two keyframes do
+WindParameters WindField::getParameters() const {
+    float t = this->_time;
+    return WindParameters{
+        .meanWind = this->_meanWind,
+        .blend = t * t * (3 - 2 * t),
+        .inverseTileSize = 1 / this->_tileSize,
+        .gustSpeed = std::max(this->_gustSpeeds[this->_current], this->_gustSpeeds[(this->_current + 1) % 3])
+    };
+}
+
+uint32_t WindField::getResolution() const {
+    return this->_resolution;
+}
+
+uint64_t WindField::getGeneration() const {
+    return this->_generation;
+}
+
+const simd::float4* WindField::getVolume(uint32_t keyframe) const {
+    return this->_volumes[(this->_current + keyframe) % 3].data();
+}
+
+//three potential components, each a sum of octaves, then their curl by central differences; the curl is scaled so its
+//root mean square speed matches the turbulence, whatever the resolution and tile size
+//returns false if the field was destroyed part way, checking between slices
+bool WindField::buildKeyframe(uint32_t keyframe, uint32_t volume) {
+    const uint32_t r = this->_resolution;
+    for (uint32_t z = 0; z < r; z++) {
+        if (this->_stopping) return false;
+        for (uint32_t y = 0; y < r; y++) {
+            for (uint32_t x = 0; x < r; x++) {
+                simd::float3 potential = simd::float3{};
+                float amplitude = 1;
+                for (uint32_t octave = 0, cells = WIND_BASE_CELLS; octave < WIND_OCTAVES && cells <= std::max(r / 4, 1u); octave++, cells *= 2) {
+                    simd::float3 position = (simd::float3{(float)x, (float)y, (float)z} + 0.5f) * cells / r;
+                    for (int c = 0; c < 3; c++) {
+                        potential[c] += amplitude * getGradientNoise(position, cells, (keyframe * 3 + c) * WIND_OCTAVES + octave);
+                    }
+                    amplitude /= 2;
+                }
+                this->_potential[(z * r + y) * r + x] = potential;
+            }
+        }
+    }
+
+    const float spacing = this->_tileSize / r;
+    std::vector<simd::float4> &samples = this->_volumes[volume];
+    double squaredSum = 0;
+    float largest = 0;
+    for (uint32_t z = 0; z < r; z++) {
+        if (this->_stopping) return false;
+        for (uint32_t y = 0; y < r; y++) {
+            for (uint32_t x = 0; x < r; x++) {
+                auto at = [&](uint32_t i, uint32_t j, uint32_t k) {
+                    return this->_potential[((k % r) * r + j % r) * r + i % r];
+                };
+                simd::float3 dx = (at(x + 1, y, z) - at(x + r - 1, y, z)) / (2 * spacing);
+                simd::float3 dy = (at(x, y + 1, z) - at(x, y + r - 1, z)) / (2 * spacing);
+                simd::float3 dz = (at(x, y, z + 1) - at(x, y, z + r - 1)) / (2 * spacing);
+                simd::float3 curl = simd::float3{dy.z - dz.y, dz.x - dx.z, dx.y - dy.x};
+                squaredSum += simd::length_squared(curl);
+                largest = std::max(largest, simd::length(curl));
+                samples[(z * r + y) * r + x] = simd_make_float4(curl);
+            }
+        }
+    }
+
+    float rms = sqrt(squaredSum / samples.size());
+    float scale = rms > 0 ? this->_turbulence / rms : 0;
+    for (simd::float4 &sample: samples) sample = simd_make_float4(this->_meanWind + scale * simd_make_float3(sample));
+    this->_gustSpeeds[volume] = scale * largest;
+    return true;
+}
+
+void WindField::build() {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    while (true) {
+        this->_condition.wait(lock, [&]() {return this->_building || this->_stopping;});
+        if (this->_stopping) return;
+        uint32_t keyframe = this->_nextKeyframe, volume = (this->_current + 2) % 3;
+        lock.unlock();
+        bool built = this->buildKeyframe(keyframe, volume);
+        lock.lock();
+        if (!built) return;
+        this->_building = false;
+        this->_condition.notify_all();
+    }
+}
@@ -0,0 +1,82 @@
+#include <utility>
+#include "WindTextures.hpp"
+
+WindTextures::WindTextures(MTL::Device *pDevice) {
+    this->_pDevice = pDevice;
+    this->setWindField(nullptr);
+}
+
+WindTextures::~WindTextures() {
+    this->_pTextures[0]->release();
+    this->_pTextures[1]->release();
+}
+
+void WindTextures::setWindField(const WindField *pWindField) {
+    this->_pWindField = pWindField;
+    this->createTextures(pWindField ? pWindField->getResolution() : 1);
+    if (pWindField) {
+        this->upload(0);
+        this->upload(1);
+        this->_generation = pWindField->getGeneration();
+        return;
+    }
+    simd::float4 breeze = simd::float4{0, 0, 2, 0};
+    for (MTL::Texture *pTexture: this->_pTextures) {
+        pTexture->replaceRegion(MTL::Region::Make3D(0, 0, 0, 1, 1, 1), 0, 0, &breeze, sizeof(simd::float4), sizeof(simd::float4));
+    }
+}
+
+//the renderer waits for every update's command buffer, so the last frame's drag passes are done with the textures
+//by the time they are written again
+void WindTextures::bind(MTL::ComputeCommandEncoder *pCEnc) {
+    WindParameters parameters = WindParameters{
+        .meanWind = simd::float3{0, 0, 2},
+        .blend = 0,
+        .inverseTileSize = 1,
+        .gustSpeed = 0
+    };
+    if (this->_pWindField) {
+        uint64_t generation = this->_pWindField->getGeneration();
+        if (generation == this->_generation + 1) {
+            //the keyframe blended towards becomes the one blended from, so only the new one has to be uploaded
+            std::swap(this->_pTextures[0], this->_pTextures[1]);
+            this->upload(1);
+        }
+        else if (generation != this->_generation) {
+            this->upload(0);
+            this->upload(1);
+        }
+        this->_generation = generation;
+        parameters = this->_pWindField->getParameters();
+    }
+    pCEnc->setTexture(this->_pTextures[0], 0);
+    pCEnc->setTexture(this->_pTextures[1], 1);
+    pCEnc->setBytes(&parameters, sizeof(WindParameters), 26);
+}
+
+void WindTextures::createTextures(uint32_t resolution) {
+    MTL::TextureDescriptor *pDescriptor = MTL::TextureDescriptor::alloc()->init();
+    pDescriptor->setTextureType(MTL::TextureType3D);
+    pDescriptor->setPixelFormat(MTL::PixelFormatRGBA32Float);
+    pDescriptor->setWidth(resolution);
+    pDescriptor->setHeight(resolution);
+    pDescriptor->setDepth(resolution);
+    pDescriptor->setUsage(MTL::TextureUsageShaderRead);
+    for (MTL::Texture *&pTexture: this->_pTextures) {
+        if (pTexture) pTexture->release();
+        pTexture = this->_pDevice->newTexture(pDescriptor);
+    }
+    pDescriptor->release();
+}
+
+void WindTextures::upload(uint32_t keyframe) {
+    uint32_t resolution = this->_pWindField->getResolution();
+    this->_pTextures[keyframe]->replaceRegion(
+        MTL::Region::Make3D(0, 0, 0, resolution, resolution, resolution),
+        0,
+        0,
+        this->_pWindField->getVolume(keyframe),
+        resolution * sizeof(simd::float4),
+        resolution * resolution * sizeof(simd::float4)
+    );
+}
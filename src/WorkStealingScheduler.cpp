@@ -0,0 +1,77 @@
+#include "WorkStealingScheduler.hpp"
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end) {
+    return (uint64_t)end << 32 | begin;
+}
+
+static inline uint32_t getBegin(uint64_t range) {
+    return (uint32_t)range;
+}
+
+static inline uint32_t getEnd(uint64_t range) {
+    return (uint32_t)(range >> 32);
+}
+
+WorkStealingScheduler::WorkStealingScheduler(ThreadPool *pThreadPool) : _ranges(pThreadPool->getThreadCount()) {
+    this->_pThreadPool = pThreadPool;
+    this->_stolen = 0;
+}
+
+unsigned int WorkStealingScheduler::getThreadCount() {
+    return this->_ranges.size();
+}
+
+void WorkStealingScheduler::run(uint32_t count, const std::function<void(uint32_t index, unsigned int thread)> &task) {
+    uint64_t threadCount = this->_ranges.size();
+    for (uint32_t i = 0; i < threadCount; i++) {
+        this->_ranges[i].range = packRange((uint64_t)count * i / threadCount, (uint64_t)count * (i + 1) / threadCount);
+    }
+    this->_stolen = 0;
+
+    //one index per thread, so every thread runs exactly one loop
+    this->_pThreadPool->parallelFor(threadCount, [&](uint32_t begin, uint32_t end) {
+        for (unsigned int thread = begin; thread < end; thread++) {
+            uint32_t index;
+            while (true) {
+                if (this->pop(thread, index)) task(index, thread);
+                else if (!this->steal(thread)) break;
+            }
+        }
+    });
+}
+
+uint32_t WorkStealingScheduler::getLastStolen() {
+    return this->_stolen;
+}
+
+bool WorkStealingScheduler::pop(unsigned int thread, uint32_t &index) {
+    std::atomic<uint64_t> &range = this->_ranges[thread].range;
+    uint64_t current = range.load();
+    while (getBegin(current) < getEnd(current)) {
+        if (range.compare_exchange_weak(current, packRange(getBegin(current) + 1, getEnd(current)))) {
+            index = getBegin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+//only called once the thread's own range is empty, which no thief touches, so the stolen half is stored plainly
+//a scan that finds every range empty ends the thread; work still held by a thief is finished by that thief
+bool WorkStealingScheduler::steal(unsigned int thread) {
+    unsigned int threadCount = this->_ranges.size();
+    for (unsigned int i = 1; i < threadCount; i++) {
+        std::atomic<uint64_t> &victim = this->_ranges[(thread + i) % threadCount].range;
+        uint64_t current = victim.load();
+        while (getBegin(current) < getEnd(current)) {
+            uint32_t taken = (getEnd(current) - getBegin(current) + 1) / 2;
+            uint32_t split = getEnd(current) - taken;
+            if (victim.compare_exchange_weak(current, packRange(getBegin(current), split))) {
+                this->_ranges[thread].range = packRange(split, getEnd(current));
+                this->_stolen += taken;
+                return true;
+            }
+        }
+    }
+    return false;
+}
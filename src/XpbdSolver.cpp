@@ -0,0 +1,84 @@
+#include <cmath>
+#include "simulation/ClothKernels.hpp"
+#include "simulation/XpbdSolver.hpp"
+
+XpbdSolver::XpbdSolver(const ClothParameters &params, const ClothTopology &topology) {
+    this->_parameters = params;
+    this->_pTopology = &topology;
+    this->_constraints = topology.springs;
+    this->_colorStarts = colorConstraints(this->_constraints, topology.particleCount);
+    this->_previousX.resize(topology.particleCount);
+    this->_previousY.resize(topology.particleCount);
+    this->_previousZ.resize(topology.particleCount);
+}
+
+uint32_t XpbdSolver::getColorCount() {
+    return this->_colorStarts.size() - 1;
+}
+
+void XpbdSolver::step(ThreadPool *pThreadPool, ClothState &state, const ClothAttachments &attachments, float dt, float fraction, bool enableWind, const WindField *pWindField) {
+    const ClothParameters &params = this->_parameters;
+    const ClothTopology &topology = *this->_pTopology;
+
+    //the force model's springs act on each end with half the constant, so a pair behaves like a spring of k / 2
+    const float compliance = 2 / params.springConstant;
+    const float damping = params.dampingConstant / 2;
+    const float scaledCompliance = compliance / (dt * dt);
+    const float gamma = compliance * damping / dt;
+    const float inverseMass = 1 / params.particleMass;
+
+    pThreadPool->parallelFor(topology.triangleCount, [&](uint32_t begin, uint32_t end) {
+        computeClothTriangleDrag(topology, state, begin, end, enableWind, pWindField);
+    });
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        accumulateClothExternalForces(params, topology, state, begin, end);
+    });
+
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            this->_previousX[i] = state.positionX[i];
+            this->_previousY[i] = state.positionY[i];
+            this->_previousZ[i] = state.positionZ[i];
+        }
+        simulateClothMotion(state, begin, end, dt);
+    });
+    pThreadPool->parallelFor(attachments.getAttachmentCount(), [&](uint32_t begin, uint32_t end) {
+        applyClothAttachments(params, attachments, state, begin, end, dt, fraction);
+    });
+
+    for (uint32_t color = 0; color < this->getColorCount(); color++) {
+        const uint32_t first = this->_colorStarts[color];
+        pThreadPool->parallelFor(this->_colorStarts[color + 1] - first, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = first + begin; i < first + end; i++) {
+                const DistanceConstraint &constraint = this->_constraints[i];
+                uint32_t a = constraint.particleA, b = constraint.particleB;
+                simd::float3 positionA = state.getPosition(a), positionB = state.getPosition(b);
+                simd::float3 displacement = positionA - positionB;
+                float distance = simd::length(displacement);
+                if (!(distance > 0)) continue;
+                simd::float3 direction = displacement / distance;
+
+                float weightA = attachments.isHard(a) ? 0 : inverseMass;
+                float weightB = attachments.isHard(b) ? 0 : inverseMass;
+                float weight = weightA + weightB;
+                if (weight == 0) continue;
+
+                simd::float3 motionA = positionA - simd::float3{this->_previousX[a], this->_previousY[a], this->_previousZ[a]};
+                simd::float3 motionB = positionB - simd::float3{this->_previousX[b], this->_previousY[b], this->_previousZ[b]};
+                float violation = distance - constraint.restLength;
+                float lambda = (-violation - gamma * simd::dot(direction, motionA - motionB)) / ((1 + gamma) * weight + scaledCompliance);
+
+                state.setPosition(a, positionA + weightA * lambda * direction);
+                state.setPosition(b, positionB - weightB * lambda * direction);
+            }
+        });
+    }
+
+    pThreadPool->parallelFor(topology.particleCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            state.velocityX[i] = (state.positionX[i] - this->_previousX[i]) / dt;
+            state.velocityY[i] = (state.positionY[i] - this->_previousY[i]) / dt;
+            state.velocityZ[i] = (state.positionZ[i] - this->_previousZ[i]) / dt;
+        }
+    });
+}